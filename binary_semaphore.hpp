@@ -2,6 +2,9 @@
  * @file binary_semaphore.hpp
  *
  * Class representing/implementing a binary_semaphore design pattern.
+ * The state lives in a single atomic word, waiters spin on it for a while
+ * and then sleep on it as on a futex; post() enters the kernel only
+ * when there is somebody sleeping.
  *
  * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
  *
@@ -21,14 +24,15 @@
 /*===========================================================================*\
  * system header files
 \*===========================================================================*/
-#include <type_traits>
-#include <mutex>
-#include <condition_variable>
+#include <atomic>
 #include <chrono>
 
+#include <cstdint>
+
 /*===========================================================================*\
  * project header files
 \*===========================================================================*/
+#include "futex.hpp"
 
 /*===========================================================================*\
  * preprocessor #define constants and macros
@@ -44,9 +48,8 @@ class binary_semaphore
 {
 public:
     explicit binary_semaphore(bool ready = false) :
-       m_mutex{},
-       m_condvar{},
-       m_ready{ready}
+       m_value{ready ? 1U : 0U},
+       m_waiters{0}
     {
     }
 
@@ -60,14 +63,7 @@ public:
 
     bool get_value() const
     {
-        bool ready;
-
-        do {
-            std::lock_guard<decltype(m_mutex)> lock(m_mutex);
-            ready = m_ready;
-        } while (0);
-
-        return ready;
+        return m_value.load(std::memory_order_acquire) != 0;
     }
 
     /**
@@ -80,13 +76,17 @@ public:
      */
     void post()
     {
-        do {
-            std::lock_guard<decltype(m_mutex)> lock(m_mutex);
-            m_ready = true;
-        } while (0);
-
-        /* the lock does not need to be held for notification */
-        m_condvar.notify_one();
+        /*
+         * Both the exchange and the load of m_waiters are sequentially consistent
+         * (as is the increment of m_waiters by the waiter), so either we see the waiter
+         * or the waiter sees the semaphore unlocked and does not go to sleep.
+         * Nobody sleeps while the semaphore is unlocked, thus only the post which
+         * unlocks it has to wake somebody up, posts to an unlocked semaphore
+         * (e.g. woken reader has not been scheduled yet) stay in user space.
+         */
+        if (m_value.exchange(1, std::memory_order_seq_cst) == 0)
+            if (m_waiters.load(std::memory_order_seq_cst) > 0)
+                futex_wake(m_value, 1);
     }
 
     /**
@@ -101,12 +101,15 @@ public:
      */
     void wait()
     {
-        std::unique_lock<decltype(m_mutex)> lock(m_mutex);
+        if (spin())
+            return;
 
-        while (!m_ready)
-            m_condvar.wait(lock);
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
 
-        m_ready = false;
+        while (!try_wait())
+            futex_wait(m_value, 0);
+
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
     }
 
     /**
@@ -125,31 +128,51 @@ public:
      */
     bool wait_timeout(unsigned int milliseconds)
     {
-        const std::chrono::steady_clock::time_point t1(std::chrono::steady_clock::now());
-        const std::chrono::milliseconds timeout(milliseconds);
-        std::chrono::milliseconds elapsed(0);
-
-        std::unique_lock<decltype(m_mutex)> lock(m_mutex);
+        const std::chrono::steady_clock::time_point deadline(
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds));
+        bool status = true;
 
-        while (!m_ready) {
-            if (elapsed >= timeout)
-                return false;
+        if (spin())
+            return true;
 
-            if (std::cv_status::timeout == m_condvar.wait_for(lock, timeout - elapsed))
-                return false;
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
 
-            const std::chrono::steady_clock::time_point t2(std::chrono::steady_clock::now());
-            elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+        while (!try_wait()) {
+            const std::chrono::nanoseconds remaining(deadline - std::chrono::steady_clock::now());
+            if ((remaining.count() <= 0) || !futex_wait(m_value, 0, &remaining)) {
+                status = try_wait();
+                break;
+            }
         }
 
-        m_ready = false;
-        return true;
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+
+        return status;
     }
 
 private:
-    mutable std::mutex m_mutex;
-    std::condition_variable m_condvar;
-    bool m_ready;
+    bool try_wait()
+    {
+        uint32_t expected = 1;
+
+        /* seq_cst so that it cannot be hoisted above the increment of m_waiters */
+        return (m_value.load(std::memory_order_seq_cst) == 1) &&
+            m_value.compare_exchange_strong(expected, 0, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    bool spin()
+    {
+        for (unsigned int n = futex_spin_count(); n > 0; --n) {
+            if (try_wait())
+                return true;
+            cpu_relax();
+        }
+
+        return try_wait();
+    }
+
+    futex_word m_value;
+    std::atomic<uint32_t> m_waiters;
 };
 
 } /* end of namespace ymn */
@@ -0,0 +1,279 @@
+/**
+ * @file buffer_pool.hpp
+ *
+ * Fixed capacity pool of preallocated buffers.
+ * Buffers are handed out as unique pointers whose deleter returns them
+ * back to the pool, so once the pool is created no heap allocations take place.
+ * Free buffers are kept on a lock-free (Treiber) stack of indices,
+ * its head carries a tag which is bumped on every update (ABA protection),
+ * thus any number of threads may acquire and release buffers concurrently.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _BUFFER_POOL_HPP_
+#define _BUFFER_POOL_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <memory>
+#include <atomic>
+#include <string>
+#include <sstream>
+#include <utility>
+
+#include <cassert>
+#include <cstdint>
+
+#if !defined(CACHELINE_SIZE)
+#define CACHELINE_SIZE 64
+#endif
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+class buffer_pool;
+
+/* All buffers which can be recycled by the buffer_pool must extend this type */
+struct pooled_buffer
+{
+    virtual ~pooled_buffer() = default;
+
+    buffer_pool* m_pool = nullptr;
+    uint32_t m_index = 0;
+};
+
+/* Returns pooled buffers back to their pool, deletes all others */
+struct pooled_buffer_deleter
+{
+    void operator()(pooled_buffer* p) const;
+};
+
+class buffer_pool
+{
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+public:
+    template<typename T>
+    using uptr = std::unique_ptr<T, pooled_buffer_deleter>;
+
+    /**
+     * Creates a pool of 'capacity' buffers, each constructed as T(args...).
+     */
+    template<typename T, typename... Args>
+    static std::unique_ptr<buffer_pool> create(std::size_t capacity, Args&&... args)
+    {
+        std::unique_ptr<buffer_pool> pool{new buffer_pool{capacity}};
+
+        for (std::size_t n = 0; n < capacity; ++n) {
+            pooled_buffer* p = new T(std::forward<Args>(args)...);
+            p->m_pool = pool.get();
+            p->m_index = static_cast<uint32_t>(n);
+            pool->m_buffers[n] = p;
+            pool->push(p->m_index);
+        }
+
+        return pool;
+    }
+
+    ~buffer_pool()
+    {
+        /* all buffers must be returned before the pool is destroyed */
+        assert(m_in_use.load(std::memory_order_relaxed) == 0);
+
+        for (std::size_t n = 0; n < m_capacity; ++n)
+            delete m_buffers[n];
+    }
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool(buffer_pool&&) = delete;
+    buffer_pool& operator = (const buffer_pool&) = delete;
+    buffer_pool& operator = (buffer_pool&&) = delete;
+
+    /**
+     * @return free buffer or nullptr if the pool is exhausted.
+     */
+    template<typename T>
+    uptr<T> acquire()
+    {
+        pooled_buffer* p = pop();
+        if (p == nullptr) {
+            m_exhausted.fetch_add(1, std::memory_order_relaxed);
+            return uptr<T>{nullptr};
+        }
+
+        std::size_t in_use = m_in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+        std::size_t high_watermark = m_high_watermark.load(std::memory_order_relaxed);
+        while ((in_use > high_watermark) &&
+               !m_high_watermark.compare_exchange_weak(high_watermark, in_use, std::memory_order_relaxed));
+
+        return uptr<T>{static_cast<T*>(p)};
+    }
+
+    void release(pooled_buffer* p)
+    {
+        assert(p->m_pool == this);
+
+        m_in_use.fetch_sub(1, std::memory_order_relaxed);
+        push(p->m_index);
+    }
+
+    std::size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+    std::size_t in_use() const
+    {
+        return m_in_use.load(std::memory_order_relaxed);
+    }
+
+    std::size_t high_watermark() const
+    {
+        return m_high_watermark.load(std::memory_order_relaxed);
+    }
+
+    std::size_t exhausted() const
+    {
+        return m_exhausted.load(std::memory_order_relaxed);
+    }
+
+    std::string to_string() const
+    {
+        std::ostringstream stream;
+
+        stream << "buffer_pool@";
+        stream << std::hex << this;
+        stream << " [capacity: ";
+        stream << std::dec << m_capacity;
+        stream << ", ";
+        stream << "in use: ";
+        stream << std::dec << in_use();
+        stream << ", ";
+        stream << "high watermark: ";
+        stream << std::dec << high_watermark();
+        stream << ", ";
+        stream << "exhausted: ";
+        stream << std::dec << exhausted();
+        stream << "]";
+
+        return stream.str();
+    }
+
+    operator std::string () const
+    {
+        return to_string();
+    }
+
+private:
+    explicit buffer_pool(std::size_t capacity) :
+        m_capacity{capacity},
+        m_buffers{std::make_unique<pooled_buffer*[]>(capacity)},
+        m_next{std::make_unique<std::atomic<uint32_t>[]>(capacity)},
+        m_head{NIL},
+        m_in_use{0},
+        m_high_watermark{0},
+        m_exhausted{0}
+    {
+        assert(capacity > 0);
+        assert(capacity < NIL);
+    }
+
+    /* head is (tag << 32) | index */
+    static uint64_t make_head(uint64_t old_head, uint32_t index)
+    {
+        return (((old_head >> 32) + 1) << 32) | index;
+    }
+
+    pooled_buffer* pop()
+    {
+        uint64_t head = m_head.load(std::memory_order_acquire);
+
+        for (;;) {
+            uint32_t index = static_cast<uint32_t>(head);
+            if (index == NIL)
+                return nullptr;
+
+            /* might be stale if someone else popped it meanwhile, but then the tag will not match */
+            uint32_t next = m_next[index].load(std::memory_order_relaxed);
+            if (m_head.compare_exchange_weak(head, make_head(head, next),
+                    std::memory_order_acquire, std::memory_order_acquire))
+                return m_buffers[index];
+        }
+    }
+
+    void push(uint32_t index)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+
+        do {
+            m_next[index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        } while (!m_head.compare_exchange_weak(head, make_head(head, index),
+                    std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    std::size_t m_capacity;
+    std::unique_ptr<pooled_buffer*[]> m_buffers;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_next;
+    alignas(CACHELINE_SIZE) std::atomic<uint64_t> m_head;
+    alignas(CACHELINE_SIZE) std::atomic<std::size_t> m_in_use;
+    std::atomic<std::size_t> m_high_watermark;
+    std::atomic<std::size_t> m_exhausted;
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+inline void pooled_buffer_deleter::operator()(pooled_buffer* p) const
+{
+    if (p->m_pool != nullptr)
+        p->m_pool->release(p);
+    else
+        delete p;
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _BUFFER_POOL_HPP_ */
@@ -0,0 +1,312 @@
+/**
+ * @file channelizer.hpp
+ *
+ * Polyphase filter bank channelizer.
+ * Splits the input band into M channels spaced fs/M apart and decimates each of them by D (given at runtime),
+ * all channels at the cost of one polyphase filter (M * P taps) and one M point FFT per output.
+ * D may be smaller than M (oversampled filter bank), so that a channel can be
+ * wider than the channel spacing. Each selected channel is then moved
+ * from the center of its bin to the requested frequency by a small nco.
+ * Arithmetic is done in single precision floating point.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _CHANNELIZER_HPP_
+#define _CHANNELIZER_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cassert>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "fixq15.hpp"
+#include "complex.hpp"
+#include "power_of_two.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/**
+ * @param M number of channels (fft size, power of two)
+ * @param P number of taps per polyphase branch
+ */
+template<std::size_t M, std::size_t P>
+class channelizer
+{
+    static_assert(is_power_of_two(M), "number of channels must be a power of two");
+    static_assert(P > 0, "polyphase branches must have at least 1 tap");
+
+    static constexpr std::size_t L = M * P;
+
+    using iq_type = complex<fixq15_16>;
+
+public:
+    static constexpr std::size_t channels = M;
+    static constexpr std::size_t taps = L;
+
+    /**
+     * Designs a windowed (Hamming) sinc prototype low pass filter with the unity DC gain.
+     *
+     * @param[in] decimation Decimation factor in range [1, M].
+     * @param[in] cutoff -6dB frequency normalized to the input sample rate (0, 0.5).
+     */
+    explicit channelizer(std::size_t decimation, double cutoff) :
+        m_decimation{decimation},
+        m_taps(L),
+        m_history(2 * L),
+        m_position{0},
+        m_skip{decimation - 1},
+        m_shift{decimation % M},
+        m_twiddles(M / 2),
+        m_bit_reversed(M),
+        m_bins(M),
+        m_selected{}
+    {
+        assert((decimation > 0) && (decimation <= M));
+
+        double h[L];
+        double sum = 0.0;
+
+        for (std::size_t k = 0; k < L; ++k) {
+            double t = static_cast<double>(k) - (L - 1) / 2.0;
+            double sinc = (t == 0.0) ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+            double window = 0.54 - 0.46 * cos(2.0 * M_PI * k / (L - 1));
+            h[k] = sinc * window;
+            sum += h[k];
+        }
+
+        /* reversed, so that it can be applied to the history kept in chronological order */
+        for (std::size_t k = 0; k < L; ++k)
+            m_taps[k] = static_cast<float>(h[L - 1 - k] / sum);
+
+        for (std::size_t k = 0; k < (M / 2); ++k)
+            m_twiddles[k] = complex<float>{
+                static_cast<float>(cos(2.0 * M_PI * k / M)), static_cast<float>(-sin(2.0 * M_PI * k / M))};
+
+        for (std::size_t k = 0; k < M; ++k) {
+            std::size_t r = 0;
+            for (std::size_t b = 1, v = k; b < M; b <<= 1, v >>= 1)
+                r = (r << 1) | (v & 1);
+            m_bit_reversed[k] = r;
+        }
+    }
+
+    /**
+     * @param[in] frequency Normalized to the input sample rate [-0.5, 0.5).
+     *
+     * @return fft bin (channel) the 'frequency' falls into.
+     */
+    static std::size_t bin(double frequency)
+    {
+        const long nearest = lround(frequency * M);
+
+        return static_cast<std::size_t>((nearest % static_cast<long>(M) + M) % M);
+    }
+
+    /**
+     * Selects a channel centered at 'frequency'.
+     * Each channel should be in a bin of its own (see bin()),
+     * channels sharing a bin are mixed out of the same (one) fft output.
+     *
+     * @param[in] frequency Normalized to the input sample rate [-0.5, 0.5).
+     *
+     * @return index of the selected channel (order of outputs passed to channelize()).
+     */
+    std::size_t add_channel(double frequency)
+    {
+        const long nearest = lround(frequency * M);
+        const double residual = (frequency - static_cast<double>(nearest) / M) * m_decimation; /* at the output rate */
+
+        selected channel;
+        channel.bin = bin(frequency);
+        channel.nco = complex<float>{1.0f, 0.0f};
+        channel.step = complex<float>{
+            static_cast<float>(cos(-2.0 * M_PI * residual)), static_cast<float>(sin(-2.0 * M_PI * residual))};
+
+        m_selected.push_back(channel);
+
+        return m_selected.size() - 1;
+    }
+
+    std::size_t size() const
+    {
+        return m_selected.size();
+    }
+
+    std::size_t decimation() const
+    {
+        return m_decimation;
+    }
+
+    /**
+     * @return upper bound of outputs (per channel) produced out of n inputs.
+     */
+    std::size_t max_output_size(std::size_t n) const
+    {
+        return (n / m_decimation) + 1;
+    }
+
+    /**
+     * Splits n input samples into the selected channels.
+     * out[c] must have room for max_output_size(n) samples of channel c.
+     *
+     * @return number of samples written to each of the channels.
+     */
+    std::size_t channelize(const iq_type* in, std::size_t n, iq_type* const* out)
+    {
+        std::size_t m = 0;
+
+        for (std::size_t j = 0; j < n; ++j) {
+            const complex<float> x{static_cast<float>(in[j].real().value()), static_cast<float>(in[j].imag().value())};
+
+            /* each sample is stored twice, so that last L samples are always contiguous */
+            m_history[m_position] = x;
+            m_history[m_position + L] = x;
+            m_position = (m_position + 1) % L;
+
+            if (m_skip > 0) {
+                --m_skip;
+                continue;
+            }
+
+            m_skip = m_decimation - 1;
+
+            transform(m_history.data() + m_position);
+
+            for (std::size_t c = 0; c < m_selected.size(); ++c) {
+                selected& channel = m_selected[c];
+                const complex<float> y = m_bins[channel.bin] * channel.nco;
+                channel.nco *= channel.step;
+
+                out[c][m] = iq_type{
+                    fixq15_16{static_cast<int32_t>(lrintf(y.real()))},
+                    fixq15_16{static_cast<int32_t>(lrintf(y.imag()))}};
+            }
+
+            ++m;
+        }
+
+        /* keep ncos on the unit circle */
+        for (selected& channel : m_selected) {
+            const float magnitude = sqrtf(channel.nco.norm());
+            channel.nco = complex<float>{channel.nco.real() / magnitude, channel.nco.imag() / magnitude};
+        }
+
+        return m;
+    }
+
+private:
+    struct selected
+    {
+        std::size_t bin;
+        complex<float> nco;
+        complex<float> step;
+    };
+
+    /* x points to the oldest of last L samples */
+    void transform(const complex<float>* x)
+    {
+        complex<float> u[M];
+
+        /* polyphase filter, folded into M branches */
+        for (std::size_t r = 0; r < M; ++r)
+            u[r] = complex<float>{};
+
+        for (std::size_t p = 0; p < P; ++p) {
+            const complex<float>* xp = x + p * M;
+            const float* hp = m_taps.data() + p * M;
+            for (std::size_t r = 0; r < M; ++r)
+                u[r] += xp[r] * hp[r];
+        }
+
+        /*
+         * Branch r of the fold holds samples n = t - L + 1 + r (mod M), where t is the index
+         * of the newest sample. Mixing bin k down by exp(-j * 2pi * k * n / M) is then the dft
+         * over those residues, so the branches are circularly shifted by (t + 1) mod M first.
+         */
+        for (std::size_t s = 0; s < M; ++s)
+            m_bins[m_bit_reversed[s]] = u[(s + M - m_shift) % M];
+
+        m_shift = (m_shift + m_decimation) % M;
+
+        fft();
+    }
+
+    /* in place, not normalized, radix-2 fft of bit reversed m_bins */
+    void fft()
+    {
+        for (std::size_t half = 1, stride = M / 2; half < M; half <<= 1, stride >>= 1) {
+            for (std::size_t k = 0; k < M; k += 2 * half) {
+                for (std::size_t j = 0; j < half; ++j) {
+                    const complex<float> t = m_bins[k + j + half] * m_twiddles[j * stride];
+                    m_bins[k + j + half] = m_bins[k + j] - t;
+                    m_bins[k + j] = m_bins[k + j] + t;
+                }
+            }
+        }
+    }
+
+    std::size_t m_decimation;
+    std::vector<float> m_taps; /* reversed */
+    std::vector<complex<float>> m_history;
+    std::size_t m_position; /* where the next sample goes, oldest of last L samples */
+    std::size_t m_skip;
+    std::size_t m_shift; /* (index of the newest sample of the next output + 1) mod M */
+    std::vector<complex<float>> m_twiddles;
+    std::vector<std::size_t> m_bit_reversed;
+    std::vector<complex<float>> m_bins;
+    std::vector<selected> m_selected;
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _CHANNELIZER_HPP_ */
@@ -0,0 +1,274 @@
+/**
+ * @file cic_decimator.hpp
+ *
+ * Cascaded integrator-comb (Hogenauer) decimator for complex fixed point samples.
+ * It is multiplier free (apart from the final rescaling), integrators run
+ * at the input rate while combs (differential delay 1) run at the output rate.
+ * Registers are 32 bits wide and rely on the modulo 2^32 arithmetic,
+ * thus the integrators may (and will) wrap around without affecting the result.
+ * Its passband droop shall be corrected by the compensating FIR
+ * (see design_compensator()) running at the CIC output rate.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _CIC_DECIMATOR_HPP_
+#define _CIC_DECIMATOR_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cassert>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "fixq15.hpp"
+#include "complex.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/**
+ * @param T complex sample type (e.g. complex<fixq15_16>)
+ * @param ORDER number of integrator/comb sections
+ */
+template<typename T, std::size_t ORDER>
+class cic_decimator
+{
+    static constexpr uint64_t power(uint64_t base, std::size_t exp)
+    {
+        return (exp == 0) ? 1 : base * power(base, exp - 1);
+    }
+
+public:
+    static constexpr std::size_t order = ORDER;
+
+    static_assert(ORDER > 0, "CIC order must be greater than 0");
+
+    /**
+     * @param[in] decimation Decimation factor R, see is_valid().
+     */
+    explicit cic_decimator(std::size_t decimation) :
+        m_decimation{decimation},
+        m_gain{power(decimation, ORDER)},
+        m_scale{static_cast<int64_t>(((uint64_t(1) << 32) + m_gain / 2) / m_gain)},
+        m_integrators{},
+        m_combs{},
+        m_phase{0}
+    {
+        assert(is_valid(decimation));
+    }
+
+    /* 16 bits input grown by log2(R^ORDER) bits must fit into 32 bits registers */
+    static bool is_valid(std::size_t decimation)
+    {
+        return (decimation > 1) && (decimation <= (1 << 16)) && (power(decimation, ORDER) <= (1 << 16));
+    }
+
+    std::size_t decimation() const
+    {
+        return m_decimation;
+    }
+
+    /* DC gain of the cascade is R^ORDER */
+    uint64_t gain() const
+    {
+        return m_gain;
+    }
+
+    /**
+     * @return upper bound of outputs produced out of n inputs.
+     */
+    std::size_t max_output_size(std::size_t n) const
+    {
+        return (n / m_decimation) + 1;
+    }
+
+    /**
+     * Decimates n input samples. 'out' may alias 'in' (in place decimation).
+     *
+     * @return number of samples written to 'out'.
+     */
+    std::size_t decimate(const T* in, std::size_t n, T* out)
+    {
+        /* factors of the usual rtl to if ratios get loops of their own, any other one takes the generic loop */
+        switch (m_decimation) {
+            case 4:  return decimate_by<4>(in, n, out);
+            case 5:  return decimate_by<5>(in, n, out);
+            case 8:  return decimate_by<8>(in, n, out);
+            default: return decimate_by<0>(in, n, out);
+        }
+    }
+
+    /**
+     * Designs the compensating (inverse sinc^ORDER) low pass FIR filter
+     * which is supposed to run at the CIC output rate.
+     * Frequency response is obtained by the frequency sampling of
+     * 1 / |H_cic(f)| within the passband, then it is Hamming windowed.
+     *
+     * @param[out] taps Q15 filter coefficients (unity DC gain).
+     * @param[in] cutoff cutoff frequency normalized to the CIC output rate (0, 0.5).
+     */
+    template<std::size_t N>
+    void design_compensator(int16_t (&taps)[N], double cutoff) const
+    {
+        constexpr std::size_t POINTS = 1024;
+
+        const double R = static_cast<double>(m_decimation);
+        double h[N];
+        double sum = 0.0;
+        long isum = 0;
+
+        for (std::size_t k = 0; k < N; ++k) {
+            double t = static_cast<double>(k) - (N - 1) / 2.0;
+            double v = 0.0;
+
+            /* midpoint rule of 2 * integral(0, cutoff) of cos(2 * pi * f * t) / |H_cic(f)| */
+            for (std::size_t p = 0; p < POINTS; ++p) {
+                double f = cutoff * (p + 0.5) / POINTS;
+                double hcic = sin(M_PI * f) / (R * sin(M_PI * f / R));
+                v += cos(2.0 * M_PI * f * t) / pow(hcic, ORDER);
+            }
+
+            double window = 0.54 - 0.46 * cos(2.0 * M_PI * k / (N - 1));
+            h[k] = 2.0 * v * cutoff / POINTS * window;
+            sum += h[k];
+        }
+
+        for (std::size_t k = 0; k < N; ++k) {
+            taps[k] = static_cast<int16_t>(lround(h[k] / sum * Q15));
+            isum += taps[k];
+        }
+
+        /* push the rounding error into the center tap to keep DC gain exactly 1.0 */
+        taps[N / 2] = static_cast<int16_t>(taps[N / 2] + (Q15 - isum));
+    }
+
+private:
+    /* K is the decimation factor if known at compile time, 0 otherwise */
+    template<std::size_t K>
+    std::size_t decimate_by(const T* in, std::size_t n, T* out)
+    {
+        const std::size_t R = (K > 0) ? K : m_decimation;
+        std::size_t m = 0;
+        std::size_t i = 0;
+
+        /*
+         * State is kept in locals (and the ORDER loops are unrolled),
+         * otherwise every integrator would make a round trip through memory for each input sample.
+         */
+        uint32_t ire[ORDER];
+        uint32_t iim[ORDER];
+        for (std::size_t k = 0; k < ORDER; ++k) {
+            ire[k] = m_integrators[k][0];
+            iim[k] = m_integrators[k][1];
+        }
+
+        while (i < n) {
+            std::size_t count = R - m_phase;
+            if (count > (n - i))
+                count = n - i;
+
+            for (std::size_t end = i + count; i < end; ++i) {
+                uint32_t re = static_cast<uint32_t>(static_cast<int32_t>(in[i].real().value()));
+                uint32_t im = static_cast<uint32_t>(static_cast<int32_t>(in[i].imag().value()));
+
+#pragma GCC unroll 16
+                for (std::size_t k = 0; k < ORDER; ++k) {
+                    re = ire[k] += re;
+                    im = iim[k] += im;
+                }
+            }
+
+            m_phase += count;
+            if (m_phase < R)
+                break;
+
+            m_phase = 0;
+
+            uint32_t re = ire[ORDER - 1];
+            uint32_t im = iim[ORDER - 1];
+
+#pragma GCC unroll 16
+            for (std::size_t k = 0; k < ORDER; ++k) {
+                uint32_t re_delayed = m_combs[k][0];
+                uint32_t im_delayed = m_combs[k][1];
+                m_combs[k][0] = re;
+                m_combs[k][1] = im;
+                re -= re_delayed;
+                im -= im_delayed;
+            }
+
+            out[m++] = T(rescale(re), rescale(im));
+        }
+
+        for (std::size_t k = 0; k < ORDER; ++k) {
+            m_integrators[k][0] = ire[k];
+            m_integrators[k][1] = iim[k];
+        }
+
+        return m;
+    }
+
+    /* divides by the cascade gain, |v| <= 2^15 * R^ORDER thus it fits into int32 */
+    int32_t rescale(uint32_t v) const
+    {
+        int64_t r = (static_cast<int64_t>(static_cast<int32_t>(v)) * m_scale + (int64_t(1) << 31)) >> 32;
+        return static_cast<int32_t>(r);
+    }
+
+    std::size_t m_decimation;
+    uint64_t m_gain;
+    int64_t m_scale; /* 2^32 / gain */
+    uint32_t m_integrators[ORDER][2];
+    uint32_t m_combs[ORDER][2];
+    std::size_t m_phase;
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _CIC_DECIMATOR_HPP_ */
@@ -150,8 +150,8 @@ public:
 
     constexpr complex& operator *= (const complex& other)
     {
-        m_re = m_re * other.m_re - m_im * other.m_im;
-        m_im = m_re * other.m_im + m_im * other.m_re;
+        /* goes through operator * so the overloads for a given T (e.g. fixed point rounding) apply here too */
+        *this = *this * other;
         return *this;
     }
 
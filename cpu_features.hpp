@@ -0,0 +1,160 @@
+/**
+ * @file cpu_features.hpp
+ *
+ * Runtime detection of the SIMD instruction sets our kernels are written for.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _CPU_FEATURES_HPP_
+#define _CPU_FEATURES_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <cstring>
+
+#if defined(__arm__) && defined(__ARM_NEON)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_FEATURES_X86
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2  __attribute__((target("avx2")))
+#endif
+
+#if defined(__ARM_NEON)
+#define CPU_FEATURES_NEON
+#endif
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+enum class simd_isa
+{
+    NONE,
+    SSE41,
+    AVX2,
+    NEON,
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+inline bool cpu_supports(simd_isa isa)
+{
+    switch (isa) {
+        case simd_isa::NONE:
+            return true;
+
+        case simd_isa::SSE41:
+#if defined(CPU_FEATURES_X86)
+            return __builtin_cpu_supports("sse4.1");
+#else
+            return false;
+#endif
+
+        case simd_isa::AVX2:
+#if defined(CPU_FEATURES_X86)
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+
+        case simd_isa::NEON:
+#if defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+            return true; /* mandatory on aarch64 */
+#elif defined(CPU_FEATURES_NEON)
+            return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+/**
+ * @return the best instruction set supported by both the compiler and the cpu.
+ */
+inline simd_isa detect_simd_isa()
+{
+    static const simd_isa isas[] = {simd_isa::AVX2, simd_isa::SSE41, simd_isa::NEON};
+
+    for (simd_isa isa : isas)
+        if (cpu_supports(isa))
+            return isa;
+
+    return simd_isa::NONE;
+}
+
+inline const char* simd_isa_to_string(simd_isa isa)
+{
+    switch (isa) {
+        case simd_isa::NONE:  return "none";
+        case simd_isa::SSE41: return "sse4.1";
+        case simd_isa::AVX2:  return "avx2";
+        case simd_isa::NEON:  return "neon";
+    }
+
+    return "unknown";
+}
+
+inline bool simd_isa_from_string(const char* s, simd_isa& isa)
+{
+    static const simd_isa isas[] = {simd_isa::NONE, simd_isa::SSE41, simd_isa::AVX2, simd_isa::NEON};
+
+    for (simd_isa i : isas)
+        if (strcmp(s, simd_isa_to_string(i)) == 0) {
+            isa = i;
+            return true;
+        }
+
+    return false;
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _CPU_FEATURES_HPP_ */
@@ -0,0 +1,194 @@
+/**
+ * @file discriminator.hpp
+ *
+ * FM (polar) discriminators.
+ * Each discriminator returns the phase difference between two consecutive
+ * complex samples, scaled so that +/-pi maps to +/-Q15.
+ *
+ * Available engines:
+ * - ATAN2      : reference implementation, double precision atan2(),
+ * - FAST_ATAN2 : integer only atan2 (octant reduction plus 3rd order polynomial),
+ *                max error against ATAN2 is 18 LSB (0.0017 rad),
+ * - DERIVATIVE : (I*dQ - Q*dI) / (I^2 + Q^2), no atan2 at all,
+ *                it returns Q15 * sin(dphi) / pi thus its error against ATAN2
+ *                is (dphi - sin(dphi)) / pi (~dphi^3 / 6), e.g. 0.7% of the full scale
+ *                for dphi = 0.5 rad, but 21% at dphi = 1.23 rad (37.5 kHz deviation @ 192 kHz).
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _DISCRIMINATOR_HPP_
+#define _DISCRIMINATOR_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "fixq15.hpp"
+#include "complex.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+ * polynomial coefficients of atan(r) / pi ~= r / 4 + r * (1 - r) * (C0 + C1 * r)
+\*===========================================================================*/
+#define FAST_ATAN2_C0  (2552) /* 0.077890 * Q15 */
+#define FAST_ATAN2_C1  (692)  /* 0.021104 * Q15 */
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+enum class discriminator_type
+{
+    ATAN2,
+    FAST_ATAN2,
+    DERIVATIVE,
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/**
+ * Integer only atan2.
+ *
+ * @return atan2(y, x) scaled so that +/-pi maps to +/-Q15
+ *         (pi itself wraps to -Q15, exactly as the double precision path does).
+ */
+inline int16_t atan2_q15(int64_t y, int64_t x)
+{
+    int64_t ax = (x < 0) ? -x : x;
+    int64_t ay = (y < 0) ? -y : y;
+    int32_t r;
+    int32_t a;
+
+    if ((ax == 0) && (ay == 0))
+        return 0;
+
+    /* reduce to the first octant, r = min / max in Q15 */
+    if (ay <= ax)
+        r = static_cast<int32_t>((ay << 15) / ax);
+    else
+        r = static_cast<int32_t>((ax << 15) / ay);
+
+    a = (r >> 2) + ((((r * (Q15 - r)) >> 15) * (FAST_ATAN2_C0 + ((FAST_ATAN2_C1 * r) >> 15))) >> 15);
+
+    if (ay > ax)
+        a = (Q15 / 2) - a;
+
+    if (x < 0)
+        a = Q15 - a;
+
+    if (y < 0)
+        a = -a;
+
+    return static_cast<int16_t>(a);
+}
+
+inline const char* discriminator_type_to_string(discriminator_type type)
+{
+    switch (type) {
+        case discriminator_type::ATAN2:      return "atan2";
+        case discriminator_type::FAST_ATAN2: return "fast-atan2";
+        case discriminator_type::DERIVATIVE: return "derivative";
+    }
+
+    return "unknown";
+}
+
+inline bool discriminator_type_from_string(const char* s, discriminator_type& type)
+{
+    static const discriminator_type types[] = {
+        discriminator_type::ATAN2,
+        discriminator_type::FAST_ATAN2,
+        discriminator_type::DERIVATIVE,
+    };
+
+    for (discriminator_type t : types)
+        if (strcmp(s, discriminator_type_to_string(t)) == 0) {
+            type = t;
+            return true;
+        }
+
+    return false;
+}
+
+/**
+ * Phase difference between sample 'a' and its predecessor 'b'.
+ * The conjugate product a * conj(b) is evaluated in 64 bits without rescaling,
+ * so it cannot saturate even for compact (16 bits) samples.
+ */
+template<discriminator_type D, typename T>
+inline int16_t polar_discriminator(const complex<T>& a, const complex<T>& b)
+{
+    int64_t ar = a.real().value();
+    int64_t ai = a.imag().value();
+    int64_t br = b.real().value();
+    int64_t bi = b.imag().value();
+
+    /* c = a * conj(b), imag(c) is also I*dQ - Q*dI */
+    int64_t cr = ar * br + ai * bi;
+    int64_t ci = ai * br - ar * bi;
+
+    if constexpr (D == discriminator_type::ATAN2) {
+        double angle = atan2(static_cast<double>(ci), static_cast<double>(cr));
+        return static_cast<int16_t>((angle / M_PI) * Q15);
+    }
+    else
+    if constexpr (D == discriminator_type::FAST_ATAN2) {
+        return atan2_q15(ci, cr);
+    }
+    else {
+        int64_t norm = ar * ar + ai * ai;
+
+        if (norm == 0)
+            return 0;
+
+        int64_t v = ci * static_cast<int64_t>(Q15 / M_PI) / norm;
+        if (v > INT16_MAX) v = INT16_MAX;
+        if (v < INT16_MIN) v = INT16_MIN;
+
+        return static_cast<int16_t>(v);
+    }
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _DISCRIMINATOR_HPP_ */
@@ -0,0 +1,310 @@
+/**
+ * @file fir_decimator.hpp
+ *
+ * Fixed point FIR decimator.
+ * Only every D-th output is computed, which is the polyphase decomposition
+ * of the filter evaluated at the output rate. Taps are Q15 and the filter
+ * history (and decimation phase) is carried between consecutive blocks,
+ * so blocks of any length can be processed.
+ * Decimation factor is given at runtime, the common ones have loops
+ * of their own, specialized at compile time.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _FIR_DECIMATOR_HPP_
+#define _FIR_DECIMATOR_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cassert>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "fixq15.hpp"
+#include "complex.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/**
+ * Per sample type multiply-accumulate.
+ * Accumulators are 32 bits wide, taps are normalized to the unity DC gain
+ * so the sum of their magnitudes stays well below 2.0 and 16 bits samples cannot overflow it.
+ */
+template<typename T>
+struct fir_traits;
+
+template<>
+struct fir_traits<int16_t>
+{
+    struct accumulator
+    {
+        int32_t v = 0;
+    };
+
+    static void mac(accumulator& acc, int16_t tap, int16_t x)
+    {
+        acc.v += static_cast<int32_t>(tap) * x;
+    }
+
+    static int16_t result(const accumulator& acc)
+    {
+        return fixq15_16::saturate((acc.v + (Q15 >> 1)) >> 15);
+    }
+};
+
+template<typename S, typename A>
+struct fir_traits<complex<basic_fixq15<S, A>>>
+{
+    struct accumulator
+    {
+        A re = 0;
+        A im = 0;
+    };
+
+    static void mac(accumulator& acc, int16_t tap, const complex<basic_fixq15<S, A>>& x)
+    {
+        acc.re += static_cast<A>(tap) * x.real().value();
+        acc.im += static_cast<A>(tap) * x.imag().value();
+    }
+
+    static complex<basic_fixq15<S, A>> result(const accumulator& acc)
+    {
+        return complex<basic_fixq15<S, A>>((acc.re + (Q15 >> 1)) >> 15, (acc.im + (Q15 >> 1)) >> 15);
+    }
+};
+
+/**
+ * @param T sample type
+ * @param N number of taps
+ */
+template<typename T, std::size_t N>
+class fir_decimator
+{
+    static_assert(N > 1, "filter must have at least 2 taps");
+
+    using traits = fir_traits<T>;
+
+public:
+    static constexpr std::size_t taps = N;
+
+    /**
+     * @param[in] decimation Decimation factor (greater than 0).
+     * @param[in] taps Q15 filter coefficients.
+     */
+    explicit fir_decimator(std::size_t decimation, const int16_t (&taps)[N]) :
+        m_decimation{decimation},
+        m_taps{},
+        m_history{},
+        m_work{},
+        m_skip{decimation - 1}
+    {
+        assert(decimation > 0);
+
+        for (std::size_t k = 0; k < N; ++k)
+            m_taps[k] = taps[N - 1 - k];
+    }
+
+    /**
+     * Designs a windowed sinc low pass filter.
+     *
+     * @param[in] decimation Decimation factor (greater than 0).
+     * @param[in] cutoff -6dB frequency normalized to the input sample rate (0, 0.5).
+     */
+    explicit fir_decimator(std::size_t decimation, double cutoff) :
+        m_decimation{decimation},
+        m_taps{},
+        m_history{},
+        m_work{},
+        m_skip{decimation - 1}
+    {
+        assert(decimation > 0);
+
+        int16_t taps[N];
+        design_lowpass(taps, cutoff);
+
+        for (std::size_t k = 0; k < N; ++k)
+            m_taps[k] = taps[N - 1 - k];
+    }
+
+    std::size_t decimation() const
+    {
+        return m_decimation;
+    }
+
+    /**
+     * @return upper bound of outputs produced out of n inputs.
+     */
+    std::size_t max_output_size(std::size_t n) const
+    {
+        return (n / m_decimation) + 1;
+    }
+
+    /**
+     * Sets the state as if all samples up to 'position' (exclusive) were already processed,
+     * so that consecutive blocks can be filtered independently (e.g. by different threads).
+     *
+     * @param[in] history Last N - 1 samples preceding the block.
+     * @param[in] position Index of the first sample of the block within the whole stream.
+     */
+    void resume(const T* history, uint64_t position)
+    {
+        for (std::size_t k = 0; k < (N - 1); ++k)
+            m_history[k] = history[k];
+
+        /* outputs are computed for samples with indices D - 1, 2 * D - 1, ... */
+        m_skip = (m_decimation - 1) - static_cast<std::size_t>(position % m_decimation);
+    }
+
+    /**
+     * Filters and decimates n input samples.
+     * 'out' must have room for max_output_size(n) samples and must not alias 'in'.
+     *
+     * @return number of samples written to 'out'.
+     */
+    std::size_t decimate(const T* in, std::size_t n, T* out)
+    {
+        /* factors of the default rate plan get loops of their own, any other one takes the generic loop */
+        switch (m_decimation) {
+            case 2:  return decimate_by<2>(in, n, out);
+            case 5:  return decimate_by<5>(in, n, out);
+            default: return decimate_by<0>(in, n, out);
+        }
+    }
+
+    /**
+     * Windowed (Hamming) sinc low pass filter with the unity DC gain.
+     */
+    static void design_lowpass(int16_t (&taps)[N], double cutoff)
+    {
+        double h[N];
+        double sum = 0.0;
+        long isum = 0;
+
+        for (std::size_t k = 0; k < N; ++k) {
+            double t = static_cast<double>(k) - (N - 1) / 2.0;
+            double sinc = (t == 0.0) ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+            double window = 0.54 - 0.46 * cos(2.0 * M_PI * k / (N - 1));
+            h[k] = sinc * window;
+            sum += h[k];
+        }
+
+        for (std::size_t k = 0; k < N; ++k) {
+            taps[k] = static_cast<int16_t>(lround(h[k] / sum * Q15));
+            isum += taps[k];
+        }
+
+        /* push the rounding error into the center tap to keep DC gain exactly 1.0 */
+        taps[N / 2] = static_cast<int16_t>(taps[N / 2] + (Q15 - isum));
+    }
+
+private:
+    /* K is the decimation factor if known at compile time, 0 otherwise */
+    template<std::size_t K>
+    std::size_t decimate_by(const T* in, std::size_t n, T* out)
+    {
+        const std::size_t D = (K > 0) ? K : m_decimation;
+        std::size_t m = 0;
+        std::size_t j = m_skip;
+
+        /* outputs which still need samples from the previous block(s) */
+        if (j < (N - 1)) {
+            const std::size_t head = (n < (N - 1)) ? n : (N - 1);
+
+            for (std::size_t k = 0; k < (N - 1); ++k)
+                m_work[k] = m_history[k];
+            for (std::size_t k = 0; k < head; ++k)
+                m_work[N - 1 + k] = in[k];
+
+            for (; (j < (N - 1)) && (j < n); j += D)
+                out[m++] = dot(m_work + j);
+        }
+
+        /* outputs computed directly out of this block */
+        for (; j < n; j += D)
+            out[m++] = dot(in + j - (N - 1));
+
+        m_skip = j - n;
+
+        /* keep last N - 1 samples for the next block */
+        if (n >= (N - 1)) {
+            for (std::size_t k = 0; k < (N - 1); ++k)
+                m_history[k] = in[n - (N - 1) + k];
+        }
+        else {
+            for (std::size_t k = 0; k < (N - 1 - n); ++k)
+                m_history[k] = m_history[k + n];
+            for (std::size_t k = 0; k < n; ++k)
+                m_history[N - 1 - n + k] = in[k];
+        }
+
+        return m;
+    }
+
+    /* x points to the oldest of N samples */
+    T dot(const T* x) const
+    {
+        typename traits::accumulator acc;
+
+        for (std::size_t k = 0; k < N; ++k)
+            traits::mac(acc, m_taps[k], x[k]);
+
+        return traits::result(acc);
+    }
+
+    std::size_t m_decimation;
+    int16_t m_taps[N]; /* reversed */
+    T m_history[N - 1];
+    T m_work[2 * (N - 1)];
+    std::size_t m_skip; /* index (within the next block) of the newest sample of the next output */
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _FIR_DECIMATOR_HPP_ */
@@ -21,10 +21,13 @@
 /*===========================================================================*\
  * system header files
 \*===========================================================================*/
+#include <cstdint>
+#include <limits>
 
 /*===========================================================================*\
  * project header files
 \*===========================================================================*/
+#include "complex.hpp"
 
 /*===========================================================================*\
  * preprocessor #define constants and macros
@@ -37,37 +40,70 @@
 namespace ymn
 {
 
-class fixq15 /* fixed point with 15 fractional bits */
+/**
+ * Fixed point with 15 fractional bits.
+ *
+ * S is the storage type, A is the type all intermediate results are calculated in.
+ * When A is wider than S results are saturated to the range of S.
+ */
+template<typename S, typename A = S>
+class basic_fixq15
 {
-    using T = int64_t;
+    static_assert(sizeof(A) >= sizeof(S), "accumulator cannot be narrower than storage");
+
 public:
-    constexpr fixq15() : m_value{} {}
-    constexpr fixq15(T v) : m_value{v} {}
-    constexpr operator T () const {return m_value;}
-    constexpr T value() const {return m_value;}
+    using storage_type = S;
+    using accumulator_type = A;
+
+    constexpr basic_fixq15() : m_value{} {}
+    constexpr basic_fixq15(A v) : m_value{saturate(v)} {}
+    constexpr operator S () const {return m_value;}
+    constexpr S value() const {return m_value;}
+
+    static constexpr S saturate(A v)
+    {
+        if constexpr (sizeof(A) > sizeof(S)) {
+            if (v > std::numeric_limits<S>::max())
+                return std::numeric_limits<S>::max();
+            if (v < std::numeric_limits<S>::min())
+                return std::numeric_limits<S>::min();
+        }
+
+        return static_cast<S>(v);
+    }
 
 private:
-    T m_value;
+    S m_value;
 };
 
-constexpr fixq15 operator + (fixq15 lhs, fixq15 rhs)
+/* wide, non saturating fixed point */
+using fixq15 = basic_fixq15<int64_t>;
+
+/* compact fixed point (e.g. for IQ samples), 16 bits storage, 32 bits arithmetic */
+using fixq15_16 = basic_fixq15<int16_t, int32_t>;
+
+template<typename S, typename A>
+constexpr basic_fixq15<S, A> operator + (basic_fixq15<S, A> lhs, basic_fixq15<S, A> rhs)
 {
-    return lhs.value() + rhs.value();
+    return static_cast<A>(lhs.value()) + rhs.value();
 }
 
-constexpr fixq15 operator - (fixq15 lhs, fixq15 rhs)
+template<typename S, typename A>
+constexpr basic_fixq15<S, A> operator - (basic_fixq15<S, A> lhs, basic_fixq15<S, A> rhs)
 {
-    return lhs.value() - rhs.value();
+    return static_cast<A>(lhs.value()) - rhs.value();
 }
 
-constexpr fixq15 operator * (fixq15 lhs, fixq15 rhs)
+template<typename S, typename A>
+constexpr basic_fixq15<S, A> operator * (basic_fixq15<S, A> lhs, basic_fixq15<S, A> rhs)
 {
-    return lhs.value() * rhs.value() / Q15;
+    return (static_cast<A>(lhs.value()) * rhs.value() + (Q15 >> 1)) >> 15;
 }
 
-constexpr fixq15 operator / (fixq15 lhs, fixq15 rhs)
+template<typename S, typename A>
+constexpr basic_fixq15<S, A> operator / (basic_fixq15<S, A> lhs, basic_fixq15<S, A> rhs)
 {
-    return lhs.value() * Q15 / rhs.value();
+    return static_cast<A>(lhs.value()) * Q15 / rhs.value();
 }
 
 } /* end of namespace ymn */
@@ -78,6 +114,47 @@ constexpr fixq15 operator / (fixq15 lhs, fixq15 rhs)
 namespace ymn
 {
 
+template<typename T>
+constexpr T clamp_to(int64_t v)
+{
+    if (v > std::numeric_limits<T>::max())
+        return std::numeric_limits<T>::max();
+    if (v < std::numeric_limits<T>::min())
+        return std::numeric_limits<T>::min();
+
+    return static_cast<T>(v);
+}
+
+/* Complex arithmetic evaluated in the accumulator type and saturated only once per component. */
+
+template<typename S, typename A>
+constexpr complex<basic_fixq15<S, A>> operator + (const complex<basic_fixq15<S, A>>& lhs, const complex<basic_fixq15<S, A>>& rhs)
+{
+    A re = static_cast<A>(lhs.real().value()) + rhs.real().value();
+    A im = static_cast<A>(lhs.imag().value()) + rhs.imag().value();
+
+    return complex<basic_fixq15<S, A>>(re, im);
+}
+
+template<typename S, typename A>
+constexpr complex<basic_fixq15<S, A>> operator - (const complex<basic_fixq15<S, A>>& lhs, const complex<basic_fixq15<S, A>>& rhs)
+{
+    A re = static_cast<A>(lhs.real().value()) - rhs.real().value();
+    A im = static_cast<A>(lhs.imag().value()) - rhs.imag().value();
+
+    return complex<basic_fixq15<S, A>>(re, im);
+}
+
+template<typename S, typename A>
+constexpr complex<basic_fixq15<S, A>> operator * (const complex<basic_fixq15<S, A>>& lhs, const complex<basic_fixq15<S, A>>& rhs)
+{
+    /* sum of two (-1 * -1) products does not fit in 32 bits, so products are summed in 64 bits and rounded once */
+    int64_t re = (static_cast<int64_t>(lhs.real().value()) * rhs.real().value() - static_cast<int64_t>(lhs.imag().value()) * rhs.imag().value() + (Q15 >> 1)) >> 15;
+    int64_t im = (static_cast<int64_t>(lhs.real().value()) * rhs.imag().value() + static_cast<int64_t>(lhs.imag().value()) * rhs.real().value() + (Q15 >> 1)) >> 15;
+
+    return complex<basic_fixq15<S, A>>(clamp_to<A>(re), clamp_to<A>(im));
+}
+
 } /* end of namespace ymn */
 
 /*===========================================================================*\
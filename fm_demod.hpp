@@ -0,0 +1,309 @@
+/**
+ * @file fm_demod.hpp
+ *
+ * Block FM demodulation kernels.
+ * Each kernel converts a contiguous block of IQ samples into Q15 scaled
+ * phase differences. The sample preceeding the block is passed in 'previous'
+ * and on return 'previous' holds the last sample of the block.
+ *
+ * The scalar kernels are the reference implementation. The SIMD kernels
+ * implement the FAST_ATAN2 discriminator with the very same polynomial,
+ * on compact (16 bits) samples. The conjugate products are exact 32 bits integer
+ * multiply-adds and only the polynomial is evaluated in single precision lanes
+ * (8 samples per iteration for AVX2, 4 for SSE4.1 and NEON). Single precision rounding makes them differ
+ * from the scalar FAST_ATAN2 by up to 2 LSB, well below its 18 LSB bound against ATAN2.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _FM_DEMOD_HPP_
+#define _FM_DEMOD_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "cpu_features.hpp"
+#include "fixq15.hpp"
+#include "complex.hpp"
+#include "discriminator.hpp"
+
+#if defined(CPU_FEATURES_X86)
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_NEON)
+#include <arm_neon.h>
+#endif
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define FAST_ATAN2_C0F  (static_cast<float>(FAST_ATAN2_C0) / Q15)
+#define FAST_ATAN2_C1F  (static_cast<float>(FAST_ATAN2_C1) / Q15)
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+using fm_demod_kernel = void (*)(int16_t* out, const complex<fixq15_16>* in, std::size_t n, complex<fixq15_16>& previous);
+
+static_assert(sizeof(complex<fixq15_16>) == (2 * sizeof(int16_t)), "SIMD kernels expect packed (re, im) int16 pairs");
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+template<discriminator_type D, typename T>
+inline void fm_demod_scalar(int16_t* out, const complex<T>* in, std::size_t n, complex<T>& previous)
+{
+    if (n > 0) {
+        out[0] = polar_discriminator<D>(in[0], previous);
+
+        for (std::size_t i = 1; i < n; ++i)
+            out[i] = polar_discriminator<D>(in[i], in[i - 1]);
+
+        previous = in[n - 1];
+    }
+}
+
+#if defined(CPU_FEATURES_X86)
+
+TARGET_SSE41
+inline void fm_demod_fast_atan2_sse41(int16_t* out, const complex<fixq15_16>* in, std::size_t n, complex<fixq15_16>& previous)
+{
+    const __m128i swap = _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m128i negate = _mm_set1_epi32(0x0001ffff);
+    const __m128i minimum = _mm_set1_epi16(-INT16_MAX);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    const __m128 c0 = _mm_set1_ps(FAST_ATAN2_C0F);
+    const __m128 c1 = _mm_set1_ps(FAST_ATAN2_C1F);
+    const __m128 tiny = _mm_set1_ps(FLT_MIN);
+    const __m128 scale = _mm_set1_ps(static_cast<float>(Q15));
+
+    if (n == 0)
+        return;
+
+    out[0] = polar_discriminator<discriminator_type::FAST_ATAN2>(in[0], previous);
+
+    std::size_t i = 1;
+    for (; (i + 4) <= n; i += 4) {
+        /* -Q15 is clamped, pmaddwd overflows for (-1 * -1) + (-1 * -1) and psignw cannot negate it */
+        __m128i a = _mm_max_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), minimum);
+        __m128i b = _mm_max_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i - 1)), minimum);
+
+        /* c = a * conj(b), (ar * br + ai * bi, ai * br - ar * bi) */
+        __m128 cr = _mm_cvtepi32_ps(_mm_madd_epi16(a, b));
+        __m128 ci = _mm_cvtepi32_ps(_mm_madd_epi16(a, _mm_sign_epi16(_mm_shuffle_epi8(b, swap), negate)));
+
+        __m128 ax = _mm_and_ps(cr, abs_mask);
+        __m128 ay = _mm_and_ps(ci, abs_mask);
+        __m128 r = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), tiny));
+
+        __m128 t = _mm_mul_ps(r, _mm_add_ps(quarter,
+            _mm_mul_ps(_mm_sub_ps(one, r), _mm_add_ps(c0, _mm_mul_ps(c1, r)))));
+        t = _mm_blendv_ps(t, _mm_sub_ps(half, t), _mm_cmpgt_ps(ay, ax));
+        t = _mm_blendv_ps(t, _mm_sub_ps(one, t), _mm_cmplt_ps(cr, zero));
+        t = _mm_or_ps(t, _mm_and_ps(ci, sign_mask));
+
+        /* pi is Q15, which wraps to -Q15 (as in atan2_q15), packs would saturate it to INT16_MAX */
+        __m128i v = _mm_cvtps_epi32(_mm_mul_ps(t, scale));
+        v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(v, v));
+    }
+
+    previous = in[i - 1];
+    fm_demod_scalar<discriminator_type::FAST_ATAN2>(out + i, in + i, n - i, previous);
+}
+
+TARGET_AVX2
+inline void fm_demod_fast_atan2_avx2(int16_t* out, const complex<fixq15_16>* in, std::size_t n, complex<fixq15_16>& previous)
+{
+    const __m256i swap = _mm256_setr_epi8(
+        2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+        2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i negate = _mm256_set1_epi32(0x0001ffff);
+    const __m256i minimum = _mm256_set1_epi16(-INT16_MAX);
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 sign_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    const __m256 c0 = _mm256_set1_ps(FAST_ATAN2_C0F);
+    const __m256 c1 = _mm256_set1_ps(FAST_ATAN2_C1F);
+    const __m256 tiny = _mm256_set1_ps(FLT_MIN);
+    const __m256 scale = _mm256_set1_ps(static_cast<float>(Q15));
+
+    if (n == 0)
+        return;
+
+    out[0] = polar_discriminator<discriminator_type::FAST_ATAN2>(in[0], previous);
+
+    std::size_t i = 1;
+    for (; (i + 8) <= n; i += 8) {
+        /* -Q15 is clamped, pmaddwd overflows for (-1 * -1) + (-1 * -1) and psignw cannot negate it */
+        __m256i a = _mm256_max_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)), minimum);
+        __m256i b = _mm256_max_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i - 1)), minimum);
+
+        /* c = a * conj(b), (ar * br + ai * bi, ai * br - ar * bi) */
+        __m256 cr = _mm256_cvtepi32_ps(_mm256_madd_epi16(a, b));
+        __m256 ci = _mm256_cvtepi32_ps(_mm256_madd_epi16(a, _mm256_sign_epi16(_mm256_shuffle_epi8(b, swap), negate)));
+
+        __m256 ax = _mm256_and_ps(cr, abs_mask);
+        __m256 ay = _mm256_and_ps(ci, abs_mask);
+        __m256 r = _mm256_div_ps(_mm256_min_ps(ax, ay), _mm256_max_ps(_mm256_max_ps(ax, ay), tiny));
+
+        __m256 t = _mm256_mul_ps(r, _mm256_add_ps(quarter,
+            _mm256_mul_ps(_mm256_sub_ps(one, r), _mm256_add_ps(c0, _mm256_mul_ps(c1, r)))));
+        t = _mm256_blendv_ps(t, _mm256_sub_ps(half, t), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+        t = _mm256_blendv_ps(t, _mm256_sub_ps(one, t), _mm256_cmp_ps(cr, zero, _CMP_LT_OQ));
+        t = _mm256_or_ps(t, _mm256_and_ps(ci, sign_mask));
+
+        /* pi is Q15, which wraps to -Q15 (as in atan2_q15), packs would saturate it to INT16_MAX */
+        __m256i v = _mm256_cvtps_epi32(_mm256_mul_ps(t, scale));
+        v = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+        v = _mm256_permute4x64_epi64(_mm256_packs_epi32(v, v), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_castsi256_si128(v));
+    }
+
+    previous = in[i - 1];
+    fm_demod_scalar<discriminator_type::FAST_ATAN2>(out + i, in + i, n - i, previous);
+}
+
+#endif /* CPU_FEATURES_X86 */
+
+#if defined(CPU_FEATURES_NEON)
+
+inline void fm_demod_fast_atan2_neon(int16_t* out, const complex<fixq15_16>* in, std::size_t n, complex<fixq15_16>& previous)
+{
+    const uint32x4_t sign_mask = vdupq_n_u32(0x80000000);
+    const int16x4_t minimum = vdup_n_s16(-INT16_MAX);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const float32x4_t quarter = vdupq_n_f32(0.25f);
+    const float32x4_t c0 = vdupq_n_f32(FAST_ATAN2_C0F);
+    const float32x4_t c1 = vdupq_n_f32(FAST_ATAN2_C1F);
+    const float32x4_t tiny = vdupq_n_f32(FLT_MIN);
+    const float32x4_t scale = vdupq_n_f32(static_cast<float>(Q15));
+
+    if (n == 0)
+        return;
+
+    out[0] = polar_discriminator<discriminator_type::FAST_ATAN2>(in[0], previous);
+
+    std::size_t i = 1;
+    for (; (i + 4) <= n; i += 4) {
+        int16x4x2_t a = vld2_s16(reinterpret_cast<const int16_t*>(in + i));
+        int16x4x2_t b = vld2_s16(reinterpret_cast<const int16_t*>(in + i - 1));
+
+        /* -Q15 is clamped, (-1 * -1) + (-1 * -1) does not fit in 32 bits */
+        a.val[0] = vmax_s16(a.val[0], minimum);
+        a.val[1] = vmax_s16(a.val[1], minimum);
+        b.val[0] = vmax_s16(b.val[0], minimum);
+        b.val[1] = vmax_s16(b.val[1], minimum);
+
+        /* c = a * conj(b), (ar * br + ai * bi, ai * br - ar * bi) */
+        float32x4_t cr = vcvtq_f32_s32(vmlal_s16(vmull_s16(a.val[0], b.val[0]), a.val[1], b.val[1]));
+        float32x4_t ci = vcvtq_f32_s32(vmlsl_s16(vmull_s16(a.val[1], b.val[0]), a.val[0], b.val[1]));
+
+        float32x4_t ax = vabsq_f32(cr);
+        float32x4_t ay = vabsq_f32(ci);
+        float32x4_t mx = vmaxq_f32(vmaxq_f32(ax, ay), tiny);
+        float32x4_t rcp = vrecpeq_f32(mx);
+        rcp = vmulq_f32(vrecpsq_f32(mx, rcp), rcp);
+        rcp = vmulq_f32(vrecpsq_f32(mx, rcp), rcp);
+        float32x4_t r = vmulq_f32(vminq_f32(ax, ay), rcp);
+
+        float32x4_t t = vmulq_f32(r, vaddq_f32(quarter,
+            vmulq_f32(vsubq_f32(one, r), vaddq_f32(c0, vmulq_f32(c1, r)))));
+        t = vbslq_f32(vcgtq_f32(ay, ax), vsubq_f32(half, t), t);
+        t = vbslq_f32(vcltq_f32(cr, zero), vsubq_f32(one, t), t);
+        t = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(t),
+            vandq_u32(vreinterpretq_u32_f32(ci), sign_mask)));
+
+        /* non saturating narrowing, so that pi wraps to -Q15 */
+        vst1_s16(out + i, vmovn_s32(vcvtq_s32_f32(vmulq_f32(t, scale))));
+    }
+
+    previous = in[i - 1];
+    fm_demod_scalar<discriminator_type::FAST_ATAN2>(out + i, in + i, n - i, previous);
+}
+
+#endif /* CPU_FEATURES_NEON */
+
+/**
+ * @return the kernel implementing given discriminator with given instruction set,
+ *         falls back to the scalar kernel if there is no such SIMD variant.
+ */
+inline fm_demod_kernel get_fm_demod_kernel(discriminator_type type, simd_isa isa)
+{
+    if (type == discriminator_type::FAST_ATAN2) {
+        switch (isa) {
+#if defined(CPU_FEATURES_X86)
+            case simd_isa::AVX2:  return fm_demod_fast_atan2_avx2;
+            case simd_isa::SSE41: return fm_demod_fast_atan2_sse41;
+#endif
+#if defined(CPU_FEATURES_NEON)
+            case simd_isa::NEON:  return fm_demod_fast_atan2_neon;
+#endif
+            default:
+                break;
+        }
+    }
+
+    switch (type) {
+        case discriminator_type::ATAN2:      return fm_demod_scalar<discriminator_type::ATAN2, fixq15_16>;
+        case discriminator_type::FAST_ATAN2: return fm_demod_scalar<discriminator_type::FAST_ATAN2, fixq15_16>;
+        case discriminator_type::DERIVATIVE: return fm_demod_scalar<discriminator_type::DERIVATIVE, fixq15_16>;
+    }
+
+    return fm_demod_scalar<discriminator_type::FAST_ATAN2, fixq15_16>;
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _FM_DEMOD_HPP_ */
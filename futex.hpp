@@ -0,0 +1,173 @@
+/**
+ * @file futex.hpp
+ *
+ * Thin wrappers around futex(2) wait/wake on a 32-bit atomic word,
+ * plus a cpu_relax() hint used when spinning on such a word.
+ * On systems without futexes futex_wait() degrades to a short sleep,
+ * which is allowed since the callers treat every wake up as a spurious one.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _FUTEX_HPP_
+#define _FUTEX_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <cstdint>
+#include <cerrno>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#if !defined(FUTEX_SPIN_COUNT)
+#define FUTEX_SPIN_COUNT 256
+#endif
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+using futex_word = std::atomic<uint32_t>;
+
+static_assert(sizeof(futex_word) == sizeof(uint32_t), "futex word must be a plain 32-bit integer");
+static_assert(futex_word::is_always_lock_free, "futex word must be lock free");
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+/**
+ * Number of times a waiter polls the word before it goes to sleep.
+ * Spinning only pays off when the peer runs on another cpu,
+ * so on a single cpu system waiters go to sleep straight away.
+ */
+inline unsigned int futex_spin_count()
+{
+    static const unsigned int spin_count =
+        (std::thread::hardware_concurrency() > 1) ? FUTEX_SPIN_COUNT : 0;
+
+    return spin_count;
+}
+
+/**
+ * Blocks the calling thread as long as 'word' contains 'expected'
+ * (the check and going to sleep is atomic with respect to futex_wake()).
+ *
+ * @param[in] word Word to sleep on.
+ * @param[in] expected Value the word has to have for the thread to sleep.
+ * @param[in] timeout Maximum time to sleep or nullptr to sleep without limit.
+ *
+ * @return false if the timeout has expired, true otherwise
+ *         (woken up, value did not match, interrupted or spurious wake up).
+ */
+inline bool futex_wait(futex_word& word, uint32_t expected, const std::chrono::nanoseconds* timeout = nullptr)
+{
+#if defined(__linux__)
+    struct timespec ts;
+    struct timespec* pts = nullptr;
+
+    if (timeout != nullptr) {
+        ts.tv_sec = static_cast<time_t>(timeout->count() / 1000000000);
+        ts.tv_nsec = static_cast<long>(timeout->count() % 1000000000);
+        pts = &ts;
+    }
+
+    long status = syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word),
+        FUTEX_WAIT_PRIVATE, expected, pts, nullptr, 0);
+
+    return !((status == -1) && (errno == ETIMEDOUT));
+#else
+    const std::chrono::nanoseconds nap = std::chrono::microseconds(100);
+
+    if (word.load(std::memory_order_relaxed) != expected)
+        return true;
+
+    if ((timeout != nullptr) && (*timeout < nap)) {
+        std::this_thread::sleep_for(*timeout);
+        return false;
+    }
+
+    std::this_thread::sleep_for(nap);
+    return true;
+#endif
+}
+
+/**
+ * Wakes up at most 'count' threads sleeping in futex_wait() on 'word'.
+ */
+inline void futex_wake(futex_word& word, int count)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word),
+        FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+    (void)word;
+    (void)count;
+#endif
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _FUTEX_HPP_ */
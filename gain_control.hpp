@@ -0,0 +1,237 @@
+/**
+ * @file gain_control.hpp
+ *
+ * Software assisted automatic gain control of the tuner.
+ * The capture thread only counts (per block, without any locking) raw u8 samples
+ * at the rails of the adc and keeps their peak, a control thread of its own
+ * periodically takes these counts and decides whether the manual tuner gain
+ * shall be changed, so that no (blocking) usb control transfer is ever made
+ * by the capture thread. The gain is lowered once too many samples clip
+ * and raised only if the peak, raised by the next gain step, still keeps the headroom,
+ * so the gap between the two makes the hysteresis of the loop.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _GAIN_CONTROL_HPP_
+#define _GAIN_CONTROL_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <atomic>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cmath>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+class gain_control
+{
+public:
+    /* distance of a sample from the middle of the u8 range (0 or 255 is 127) it is counted as clipped at */
+    static constexpr uint8_t clip_deviation = 126;
+
+    /* heavy clipping (that many times the allowed fraction) lowers the gain by that much at once (tenths of dB) */
+    static constexpr double heavy_clipping = 10.0;
+    static constexpr int heavy_step = 60;
+
+    /**
+     * @param[in] gains Gains supported by the tuner (tenths of dB, ascending, see rtlsdr_get_tuner_gains()).
+     * @param[in] initial Gain (tenths of dB) the tuner is set to, the nearest supported one is taken.
+     * @param[in] clipped Fraction of clipped samples the gain is lowered at.
+     * @param[in] headroom dB below the full scale the peak shall stay after the gain is raised.
+     */
+    explicit gain_control(const std::vector<int>& gains, int initial, double clipped, double headroom) :
+        m_gains{gains},
+        m_index{0},
+        m_clipped_max{clipped},
+        m_headroom{headroom},
+        m_settling{true},
+        m_samples{0},
+        m_clipped{0},
+        m_peak{0},
+        m_samples_total{0},
+        m_clipped_total{0},
+        m_lowered{0},
+        m_raised{0}
+    {
+        std::sort(m_gains.begin(), m_gains.end());
+
+        for (std::size_t i = 1; i < m_gains.size(); ++i)
+            if (std::abs(m_gains[i] - initial) < std::abs(m_gains[m_index] - initial))
+                m_index = i;
+    }
+
+    gain_control(const gain_control&) = delete;
+    gain_control& operator = (const gain_control&) = delete;
+
+    /* tenths of dB */
+    int gain() const
+    {
+        return m_gains.empty() ? 0 : m_gains[m_index];
+    }
+
+    /**
+     * Counts clipped samples of a block (and its peak), called by the capture thread.
+     * It is cheap (one pass without branches over the block) and never waits.
+     */
+    void count(const uint8_t* data, std::size_t len)
+    {
+        uint32_t clipped = 0;
+        uint8_t peak = 0;
+
+        for (std::size_t i = 0; i < len; ++i) {
+            /* [128, 255] -> [0, 127], [0, 127] -> [127, 0] */
+            const uint8_t x = data[i];
+            const uint8_t deviation = (x ^ static_cast<uint8_t>((x >> 7) - 1)) & 0x7f;
+
+            clipped += (deviation >= clip_deviation);
+            peak = std::max(peak, deviation);
+        }
+
+        m_samples.fetch_add(len, std::memory_order_relaxed);
+        m_clipped.fetch_add(clipped, std::memory_order_relaxed);
+
+        uint8_t current = m_peak.load(std::memory_order_relaxed);
+        while ((peak > current) && !m_peak.compare_exchange_weak(current, peak, std::memory_order_relaxed));
+    }
+
+    /**
+     * Takes the counts gathered since the previous call, called periodically by the control thread.
+     * Samples counted right after a change of the gain may still come from the previous one,
+     * so the call following a change only discards them.
+     *
+     * @param[out] gain New gain (tenths of dB) to be set.
+     *
+     * @return true if the gain of the tuner shall be changed to 'gain', false otherwise.
+     */
+    bool update(int& gain)
+    {
+        const uint64_t samples = m_samples.exchange(0, std::memory_order_relaxed);
+        const uint64_t clipped = m_clipped.exchange(0, std::memory_order_relaxed);
+        const uint8_t peak = m_peak.exchange(0, std::memory_order_relaxed);
+
+        m_samples_total += samples;
+        m_clipped_total += clipped;
+
+        if (m_settling || (samples == 0) || m_gains.empty()) {
+            m_settling = false;
+            return false;
+        }
+
+        const double fraction = static_cast<double>(clipped) / samples;
+        std::size_t index = m_index;
+
+        if (fraction > m_clipped_max) {
+            const int target = m_gains[m_index] - ((fraction > heavy_clipping * m_clipped_max) ? heavy_step : 1);
+            while ((index > 0) && (m_gains[index] > target))
+                index--;
+        }
+        else
+        if ((clipped == 0) && (m_index + 1 < m_gains.size())) {
+            const double step = (m_gains[m_index + 1] - m_gains[m_index]) / 10.0;
+            const double level = 20.0 * log10((peak + 0.5) / 128.0);
+            if (level + step <= -m_headroom)
+                index = m_index + 1;
+        }
+
+        if (index == m_index)
+            return false;
+
+        if (index < m_index)
+            m_lowered++;
+        else
+            m_raised++;
+
+        m_index = index;
+        m_settling = true;
+        gain = m_gains[m_index];
+
+        return true;
+    }
+
+    std::string to_string() const
+    {
+        std::ostringstream stream;
+
+        stream << std::fixed << std::setprecision(1);
+        stream << "agc [gain: " << gain() / 10.0 << " dB";
+        stream << ", clipped: " << m_clipped_total << " of " << m_samples_total << " samples";
+        stream << ", lowered: " << m_lowered;
+        stream << ", raised: " << m_raised;
+        stream << "]";
+
+        return stream.str();
+    }
+
+private:
+    std::vector<int> m_gains;
+    std::size_t m_index;  /* of the current gain */
+    double m_clipped_max;
+    double m_headroom;
+    bool m_settling;      /* the gain has just been changed */
+    std::atomic<uint64_t> m_samples;
+    std::atomic<uint64_t> m_clipped;
+    std::atomic<uint8_t> m_peak;
+    uint64_t m_samples_total;
+    uint64_t m_clipped_total;
+    uint64_t m_lowered;
+    uint64_t m_raised;
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _GAIN_CONTROL_HPP_ */
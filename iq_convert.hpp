@@ -0,0 +1,288 @@
+/**
+ * @file iq_convert.hpp
+ *
+ * Conversion of raw (u8) rtlsdr IQ samples into complex<fixq15_16>.
+ * Each kernel does in one pass what polar_rotate_90() followed by
+ * the (u8 - 127) * 256 scaling used to do in two:
+ * it multiplies consecutive samples by 1, j, -1, -j (a -fs/4 frequency shift),
+ * removes the DC offset and scales them to Q15. Results are saturated to [-32512, 32767].
+ * Rotation phase (index of the next sample within the 4 samples cycle)
+ * is passed in/out in 'phase', thus blocks of any length can be converted.
+ *
+ * All kernels are bit exact. The fallback kernel uses 256 entries lookup tables,
+ * the SIMD ones swap/negate bytes with a shuffle (or select) and then widen them
+ * (16 samples per iteration for AVX2, 8 for SSE4.1 and NEON).
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _IQ_CONVERT_HPP_
+#define _IQ_CONVERT_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <cstdint>
+#include <cstddef>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "cpu_features.hpp"
+#include "fixq15.hpp"
+#include "complex.hpp"
+
+#if defined(CPU_FEATURES_X86)
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_NEON)
+#include <arm_neon.h>
+#endif
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/* 'n' is the number of complex samples, thus 'in' holds 2 * n bytes */
+using iq_convert_kernel = void (*)(complex<fixq15_16>* out, const uint8_t* in, std::size_t n, std::size_t& phase);
+
+static_assert(sizeof(complex<fixq15_16>) == (2 * sizeof(int16_t)), "SIMD kernels expect packed (re, im) int16 pairs");
+
+/**
+ * Rotation by j^k maps (I, Q) to:
+ * k = 0: ( I,  Q)
+ * k = 1: (~Q,  I)
+ * k = 2: (~I, ~Q)
+ * k = 3: ( Q, ~I)
+ * where ~x = 255 - x is the negation of the offset binary u8 sample.
+ */
+struct iq_convert_tables
+{
+    constexpr iq_convert_tables() :
+        positive{},
+        negative{},
+        swap{},
+        swapped{},
+        invert{}
+    {
+        for (int x = 0; x < 256; ++x) {
+            int p = (x - 127) * 256;
+            int m = (128 - x) * 256;
+            positive[x] = static_cast<int16_t>((p > INT16_MAX) ? INT16_MAX : p);
+            negative[x] = static_cast<int16_t>((m > INT16_MAX) ? INT16_MAX : m);
+        }
+
+        /* 16 bytes (8 samples) shuffle/invert masks for each rotation phase */
+        for (int phase = 0; phase < 4; ++phase)
+            for (int s = 0; s < 8; ++s) {
+                int k = (phase + s) % 4;
+                bool exchange = (k == 1) || (k == 3);
+                swap[phase][2 * s + 0] = static_cast<uint8_t>(2 * s + (exchange ? 1 : 0));
+                swap[phase][2 * s + 1] = static_cast<uint8_t>(2 * s + (exchange ? 0 : 1));
+                swapped[phase][2 * s + 0] = exchange ? 0xff : 0x00;
+                swapped[phase][2 * s + 1] = exchange ? 0xff : 0x00;
+                invert[phase][2 * s + 0] = ((k == 1) || (k == 2)) ? 0xff : 0x00;
+                invert[phase][2 * s + 1] = ((k == 2) || (k == 3)) ? 0xff : 0x00;
+            }
+    }
+
+    int16_t positive[256]; /* (x - 127) * 256 */
+    int16_t negative[256]; /* (~x - 127) * 256 */
+    alignas(16) uint8_t swap[4][16];    /* pshufb indices */
+    alignas(16) uint8_t swapped[4][16]; /* select mask of swapped pairs */
+    alignas(16) uint8_t invert[4][16];
+};
+
+inline constexpr iq_convert_tables IQ_CONVERT_TABLES{};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+inline void iq_convert_lut(complex<fixq15_16>* out, const uint8_t* in, std::size_t n, std::size_t& phase)
+{
+    const int16_t* p = IQ_CONVERT_TABLES.positive;
+    const int16_t* m = IQ_CONVERT_TABLES.negative;
+    std::size_t k = phase;
+    std::size_t i = 0;
+
+    /* up to the beginning of the next rotation cycle */
+    for (; (k != 0) && (i < n); ++i, k = (k + 1) % 4) {
+        uint8_t re = in[2 * i + 0];
+        uint8_t im = in[2 * i + 1];
+        switch (k) {
+            case 1: out[i] = complex<fixq15_16>(m[im], p[re]); break;
+            case 2: out[i] = complex<fixq15_16>(m[re], m[im]); break;
+            case 3: out[i] = complex<fixq15_16>(p[im], m[re]); break;
+        }
+    }
+
+    for (; (i + 4) <= n; i += 4) {
+        const uint8_t* x = in + 2 * i;
+        out[i + 0] = complex<fixq15_16>(p[x[0]], p[x[1]]);
+        out[i + 1] = complex<fixq15_16>(m[x[3]], p[x[2]]);
+        out[i + 2] = complex<fixq15_16>(m[x[4]], m[x[5]]);
+        out[i + 3] = complex<fixq15_16>(p[x[7]], m[x[6]]);
+    }
+
+    for (; i < n; ++i, k = (k + 1) % 4) {
+        uint8_t re = in[2 * i + 0];
+        uint8_t im = in[2 * i + 1];
+        switch (k) {
+            case 0: out[i] = complex<fixq15_16>(p[re], p[im]); break;
+            case 1: out[i] = complex<fixq15_16>(m[im], p[re]); break;
+            case 2: out[i] = complex<fixq15_16>(m[re], m[im]); break;
+        }
+    }
+
+    phase = (phase + n) % 4;
+}
+
+#if defined(CPU_FEATURES_X86)
+
+/* only SSSE3 instructions are used, but our dispatcher knows SSE4.1 */
+TARGET_SSE41
+inline void iq_convert_sse41(complex<fixq15_16>* out, const uint8_t* in, std::size_t n, std::size_t& phase)
+{
+    /* 8 samples per iteration is a multiple of the rotation cycle, so its phase stays put */
+    const __m128i swap = _mm_load_si128(reinterpret_cast<const __m128i*>(IQ_CONVERT_TABLES.swap[phase]));
+    const __m128i invert = _mm_load_si128(reinterpret_cast<const __m128i*>(IQ_CONVERT_TABLES.invert[phase]));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i sign = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+    const __m128i one = _mm_set1_epi16(256);
+    std::size_t i = 0;
+
+    for (; (i + 8) <= n; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+        x = _mm_xor_si128(_mm_shuffle_epi8(x, swap), invert);
+
+        /* x << 8 with the sign bit flipped is (x - 128) * 256, then saturated + 256 */
+        __m128i lo = _mm_adds_epi16(_mm_xor_si128(_mm_unpacklo_epi8(zero, x), sign), one);
+        __m128i hi = _mm_adds_epi16(_mm_xor_si128(_mm_unpackhi_epi8(zero, x), sign), one);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 0), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), hi);
+    }
+
+    iq_convert_lut(out + i, in + 2 * i, n - i, phase);
+}
+
+TARGET_AVX2
+inline void iq_convert_avx2(complex<fixq15_16>* out, const uint8_t* in, std::size_t n, std::size_t& phase)
+{
+    /* both 128 bits lanes share the same (8 bytes periodic) masks */
+    const __m256i swap = _mm256_broadcastsi128_si256(
+        _mm_load_si128(reinterpret_cast<const __m128i*>(IQ_CONVERT_TABLES.swap[phase])));
+    const __m256i invert = _mm256_broadcastsi128_si256(
+        _mm_load_si128(reinterpret_cast<const __m128i*>(IQ_CONVERT_TABLES.invert[phase])));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i sign = _mm256_set1_epi16(static_cast<int16_t>(0x8000));
+    const __m256i one = _mm256_set1_epi16(256);
+    std::size_t i = 0;
+
+    for (; (i + 16) <= n; i += 16) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * i));
+
+        /* [q0, q1, q2, q3] -> [q0, q2, q1, q3] so that in-lane unpacks keep samples in order */
+        x = _mm256_permute4x64_epi64(x, 0xd8);
+        x = _mm256_xor_si256(_mm256_shuffle_epi8(x, swap), invert);
+
+        __m256i lo = _mm256_adds_epi16(_mm256_xor_si256(_mm256_unpacklo_epi8(zero, x), sign), one);
+        __m256i hi = _mm256_adds_epi16(_mm256_xor_si256(_mm256_unpackhi_epi8(zero, x), sign), one);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 0), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 8), hi);
+    }
+
+    iq_convert_lut(out + i, in + 2 * i, n - i, phase);
+}
+
+#endif /* CPU_FEATURES_X86 */
+
+#if defined(CPU_FEATURES_NEON)
+
+inline void iq_convert_neon(complex<fixq15_16>* out, const uint8_t* in, std::size_t n, std::size_t& phase)
+{
+    /* swapping is always within (re, im) pair, so a byte reverse within halfwords plus select does (no vtbl needed) */
+    const uint8x16_t swapped = vld1q_u8(IQ_CONVERT_TABLES.swapped[phase]);
+    const uint8x16_t invert = vld1q_u8(IQ_CONVERT_TABLES.invert[phase]);
+    const uint16x8_t sign = vdupq_n_u16(0x8000);
+    const int16x8_t one = vdupq_n_s16(256);
+    std::size_t i = 0;
+
+    for (; (i + 8) <= n; i += 8) {
+        uint8x16_t x = vld1q_u8(in + 2 * i);
+        x = veorq_u8(vbslq_u8(swapped, vrev16q_u8(x), x), invert);
+
+        int16x8_t lo = vqaddq_s16(vreinterpretq_s16_u16(veorq_u16(vshll_n_u8(vget_low_u8(x), 8), sign)), one);
+        int16x8_t hi = vqaddq_s16(vreinterpretq_s16_u16(veorq_u16(vshll_n_u8(vget_high_u8(x), 8), sign)), one);
+
+        vst1q_s16(reinterpret_cast<int16_t*>(out + i + 0), lo);
+        vst1q_s16(reinterpret_cast<int16_t*>(out + i + 4), hi);
+    }
+
+    iq_convert_lut(out + i, in + 2 * i, n - i, phase);
+}
+
+#endif /* CPU_FEATURES_NEON */
+
+/**
+ * @return the conversion kernel for given instruction set,
+ *         falls back to the lookup table kernel if there is no such SIMD variant.
+ */
+inline iq_convert_kernel get_iq_convert_kernel(simd_isa isa)
+{
+    switch (isa) {
+#if defined(CPU_FEATURES_X86)
+        case simd_isa::AVX2:  return iq_convert_avx2;
+        case simd_isa::SSE41: return iq_convert_sse41;
+#endif
+#if defined(CPU_FEATURES_NEON)
+        case simd_isa::NEON:  return iq_convert_neon;
+#endif
+        default:
+            break;
+    }
+
+    return iq_convert_lut;
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _IQ_CONVERT_HPP_ */
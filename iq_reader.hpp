@@ -0,0 +1,192 @@
+/**
+ * @file iq_reader.hpp
+ *
+ * Reads raw (u8 interleaved I/Q, as written by rtl_sdr) recordings.
+ * Regular files are memory mapped and handed out in place,
+ * anything else (stdin, pipes) is read into an internal block.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _IQ_READER_HPP_
+#define _IQ_READER_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <vector>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+class iq_reader
+{
+public:
+    explicit iq_reader() :
+        m_fd{-1},
+        m_map{nullptr},
+        m_map_size{0},
+        m_offset{0},
+        m_block{}
+    {
+    }
+
+    iq_reader(const iq_reader&) = delete;
+    iq_reader& operator = (const iq_reader&) = delete;
+
+    ~iq_reader()
+    {
+        close();
+    }
+
+    /**
+     * @param[in] path Recording to be read, "-" stands for stdin.
+     *
+     * @return true on success, false otherwise (errno is set).
+     */
+    bool open(const char* path)
+    {
+        close();
+
+        m_fd = (strcmp(path, "-") == 0) ? STDIN_FILENO : ::open(path, O_RDONLY);
+        if (m_fd < 0)
+            return false;
+
+        struct stat st;
+        if ((fstat(m_fd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+            void* map = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+            if (map != MAP_FAILED) {
+                madvise(map, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+                m_map = static_cast<const uint8_t*>(map);
+                m_map_size = static_cast<std::size_t>(st.st_size);
+            }
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        if (m_map != nullptr)
+            munmap(const_cast<uint8_t*>(m_map), m_map_size);
+
+        if ((m_fd >= 0) && (m_fd != STDIN_FILENO))
+            ::close(m_fd);
+
+        m_fd = -1;
+        m_map = nullptr;
+        m_map_size = 0;
+        m_offset = 0;
+    }
+
+    bool is_mapped() const
+    {
+        return m_map != nullptr;
+    }
+
+    /**
+     * Hands out next block of the recording, it stays valid until the next call.
+     * Only the very last block may be shorter than requested (it is always a whole number of I/Q pairs).
+     *
+     * @param[in] size Requested number of bytes.
+     * @param[out] data Points to the block.
+     *
+     * @return number of bytes in the block, 0 at the end of the recording or on error.
+     */
+    std::size_t next(std::size_t size, const uint8_t*& data)
+    {
+        std::size_t count;
+
+        if (m_map != nullptr) {
+            count = std::min(size, m_map_size - m_offset);
+            data = m_map + m_offset;
+        }
+        else {
+            m_block.resize(size);
+            for (count = 0; count < size; ) {
+                ssize_t status = ::read(m_fd, m_block.data() + count, size - count);
+                if (status <= 0)
+                    break; /* end of file, error or interrupted by a signal */
+                count += static_cast<std::size_t>(status);
+            }
+            data = m_block.data();
+        }
+
+        count &= ~static_cast<std::size_t>(1);
+        m_offset += count;
+
+        return count;
+    }
+
+    /* number of bytes handed out so far */
+    uint64_t offset() const
+    {
+        return m_offset;
+    }
+
+private:
+    int m_fd;
+    const uint8_t* m_map;
+    std::size_t m_map_size;
+    uint64_t m_offset;
+    std::vector<uint8_t> m_block;
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _IQ_READER_HPP_ */
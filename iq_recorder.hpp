@@ -0,0 +1,363 @@
+/**
+ * @file iq_recorder.hpp
+ *
+ * Records raw (u8 interleaved I/Q, as written by rtl_sdr) samples while they are captured.
+ * Blocks are copied out of the capture thread into a small pool and handed off
+ * through a ringbuffer to a writer thread of their own, which appends them to
+ * a preallocated, memory mapped file. If the writer falls behind (e.g. the disk stalls)
+ * blocks are dropped, the capture thread never waits for it.
+ * Optionally the writer keeps only the last bytes in memory (pre-trigger ring)
+ * and appends them to the file once trigger() is called.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _IQ_RECORDER_HPP_
+#define _IQ_RECORDER_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <vector>
+#include <string>
+#include <sstream>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ringbuffer.hpp"
+#include "buffer_pool.hpp"
+#include "power_of_two.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+class iq_recorder
+{
+public:
+    explicit iq_recorder() :
+        m_fd{-1},
+        m_map{nullptr},
+        m_map_size{0},
+        m_written{0},
+        m_pool{},
+        m_queue{},
+        m_thread{},
+        m_ring{},
+        m_ring_end{0},
+        m_triggered{false},
+        m_blocks{0},
+        m_dropped{0},
+        m_lost{0},
+        m_triggers{0}
+    {
+    }
+
+    iq_recorder(const iq_recorder&) = delete;
+    iq_recorder& operator = (const iq_recorder&) = delete;
+
+    ~iq_recorder()
+    {
+        close();
+    }
+
+    /**
+     * Creates (truncates) the recording, allocates its disk space and starts the writer.
+     *
+     * @param[in] path Recording to be written.
+     * @param[in] size Max number of bytes recorded, all of them are allocated upfront
+     *                 (so that a full disk cannot fault the mapping), the file is truncated on close().
+     * @param[in] pretrigger Bytes kept in memory until trigger(), 0 records everything as it comes.
+     * @param[in] block_size Max number of bytes of one push().
+     * @param[in] blocks Number of blocks the writer may fall behind by.
+     *
+     * @return true on success, false otherwise (errno is set).
+     */
+    bool open(const char* path, std::size_t size, std::size_t pretrigger, std::size_t block_size, std::size_t blocks)
+    {
+        close();
+
+        /* whole I/Q pairs only */
+        size &= ~static_cast<std::size_t>(1);
+        pretrigger &= ~static_cast<std::size_t>(1);
+
+        m_fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (m_fd < 0)
+            return false;
+
+        int status = posix_fallocate(m_fd, 0, static_cast<off_t>(size));
+        if (status != 0) {
+            close();
+            errno = status;
+            return false;
+        }
+
+        /*
+         * With the memory locked (mlockall(MCL_FUTURE)) a new mapping would be faulted in and pinned
+         * as a whole, an inaccessible one is not, so it is unlocked before it is made writable:
+         * pages of the recording are written once and the kernel may write them back and reclaim them.
+         */
+        void* map = mmap(nullptr, size, PROT_NONE, MAP_SHARED, m_fd, 0);
+        if (map == MAP_FAILED) {
+            status = errno;
+            close();
+            errno = status;
+            return false;
+        }
+
+        munlock(map, size);
+
+        if (mprotect(map, size, PROT_WRITE) != 0) {
+            status = errno;
+            munmap(map, size);
+            close();
+            errno = status;
+            return false;
+        }
+
+        madvise(map, size, MADV_SEQUENTIAL);
+        m_map = static_cast<uint8_t*>(map);
+        m_map_size = size;
+        m_written = 0;
+        m_lost = 0;
+        m_triggers = 0;
+        m_blocks.store(0, std::memory_order_relaxed);
+        m_dropped.store(0, std::memory_order_relaxed);
+
+        m_pool = buffer_pool::create<block>(blocks, block_size);
+        m_queue = std::make_unique<ringbuffer<block_uptr, ringbuffer_index_mask>>(
+            round_up_to_power_of_two(blocks), RINGBUFFER_RD_BLOCKING_WR_NONBLOCKING);
+        m_ring.resize(pretrigger);
+
+        m_thread = std::thread{&iq_recorder::run, this};
+
+        return true;
+    }
+
+    /* writes out whatever has been pushed so far (the pre-trigger ring is discarded) */
+    void close()
+    {
+        if (m_thread.joinable()) {
+            m_queue->cancel(ringbuffer_role::CONSUMER);
+            m_thread.join();
+        }
+
+        m_queue.reset();
+        m_pool.reset();
+
+        if (m_map != nullptr)
+            munmap(m_map, m_map_size);
+
+        if (m_fd >= 0) {
+            if (ftruncate(m_fd, static_cast<off_t>(m_written)) != 0)
+                fprintf(stderr, "%s: ftruncate() failed (%s)\n", __PRETTY_FUNCTION__, strerror(errno));
+            ::close(m_fd);
+        }
+
+        m_fd = -1;
+        m_map = nullptr;
+        m_map_size = 0;
+        m_ring.clear();
+        m_ring_end = 0;
+    }
+
+    bool is_open() const
+    {
+        return m_fd >= 0;
+    }
+
+    /**
+     * Hands a copy of the block to the writer, never waits for it.
+     * Shall be called by one thread at a time.
+     *
+     * @return false if the block was dropped (the writer is behind or the block is too large).
+     */
+    bool push(const uint8_t* data, std::size_t len)
+    {
+        m_blocks.fetch_add(1, std::memory_order_relaxed);
+
+        block_uptr b = m_pool->acquire<block>();
+        if (!b || (len > b->vector.capacity())) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        b->vector.assign(data, data + len);
+
+        if (m_queue->write(std::move(b)) != 1) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    /* the pre-trigger ring is appended to the recording (along with the next block), may be called from any thread */
+    void trigger()
+    {
+        m_triggered.store(true, std::memory_order_relaxed);
+    }
+
+    /* the writer thread keeps counting bytes until close() has returned, so it is complete only then */
+    std::string to_string() const
+    {
+        std::ostringstream stream;
+
+        stream << "recorder [blocks: " << m_blocks.load(std::memory_order_relaxed);
+        stream << ", dropped: " << m_dropped.load(std::memory_order_relaxed);
+        stream << ", bytes: " << m_written;
+        stream << ", lost (file full): " << m_lost;
+        stream << ", triggers: " << m_triggers;
+        stream << "]";
+
+        return stream.str();
+    }
+
+private:
+    struct block : public pooled_buffer
+    {
+        explicit block(std::size_t size) :
+            pooled_buffer{},
+            vector{}
+        {
+            vector.reserve(size);
+        }
+
+        std::vector<uint8_t> vector;
+    };
+
+    using block_uptr = buffer_pool::uptr<block>;
+
+    /* the writer, until the queue is cancelled (blocks pushed before are still written) */
+    void run()
+    {
+        block_uptr b;
+
+        while (m_queue->read(std::move(b)) == 1) {
+            if (m_ring.empty())
+                append(b->vector.data(), b->vector.size());
+            else
+                keep(b->vector.data(), b->vector.size());
+
+            b.reset();
+
+            if (m_triggered.exchange(false, std::memory_order_relaxed) && !m_ring.empty()) {
+                flush_ring();
+                m_triggers++;
+            }
+        }
+    }
+
+    void append(const uint8_t* data, std::size_t len)
+    {
+        const std::size_t count = std::min(len, m_map_size - m_written);
+
+        memcpy(m_map + m_written, data, count);
+        m_written += count;
+        m_lost += len - count;
+    }
+
+    /* the ring keeps the last m_ring.size() bytes */
+    void keep(const uint8_t* data, std::size_t len)
+    {
+        const std::size_t capacity = m_ring.size();
+
+        if (len > capacity) {
+            data += len - capacity;
+            len = capacity;
+        }
+
+        const std::size_t position = m_ring_end % capacity;
+        const std::size_t chunk = std::min(len, capacity - position);
+
+        memcpy(m_ring.data() + position, data, chunk);
+        memcpy(m_ring.data(), data + chunk, len - chunk);
+        m_ring_end += len;
+    }
+
+    /* oldest first, the ring is empty afterwards (so that the next trigger does not write it again) */
+    void flush_ring()
+    {
+        const std::size_t capacity = m_ring.size();
+        const std::size_t kept = static_cast<std::size_t>(std::min<uint64_t>(m_ring_end, capacity));
+        const std::size_t start = static_cast<std::size_t>((m_ring_end - kept) % capacity);
+        const std::size_t chunk = std::min(kept, capacity - start);
+
+        append(m_ring.data() + start, chunk);
+        append(m_ring.data(), kept - chunk);
+        m_ring_end = 0;
+    }
+
+    int m_fd;
+    uint8_t* m_map;
+    std::size_t m_map_size;
+    std::size_t m_written; /* bytes of the mapping filled so far */
+    std::unique_ptr<buffer_pool> m_pool; /* destroyed after the queue (which may still hold its blocks) */
+    std::unique_ptr<ringbuffer<block_uptr, ringbuffer_index_mask>> m_queue;
+    std::thread m_thread;
+    std::vector<uint8_t> m_ring; /* pre-trigger ring, empty if there is none */
+    uint64_t m_ring_end;         /* bytes ever kept in the ring (since the last trigger) */
+    std::atomic<bool> m_triggered;
+    std::atomic<uint64_t> m_blocks;
+    std::atomic<uint64_t> m_dropped;
+    uint64_t m_lost;     /* bytes which did not fit into the file */
+    uint64_t m_triggers;
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _IQ_RECORDER_HPP_ */
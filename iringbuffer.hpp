@@ -40,16 +40,16 @@
 namespace ymn
 {
 
-template<typename T>
-class iringbuffer : public virtual ringbuffer_base<T>
+template<typename T, typename I = ringbuffer_index_modulo>
+class iringbuffer : public virtual ringbuffer_base<T, I>
 {
 public:
     explicit iringbuffer() :
-        ringbuffer_base<T>::ringbuffer_base{}
+        ringbuffer_base<T, I>::ringbuffer_base{}
     {
 #if defined(DEBUG_RINGBUFFER)
         std::cout << __PRETTY_FUNCTION__ << std::endl;
-        std::cout << ringbuffer_base<T>::to_string() << std::endl;
+        std::cout << ringbuffer_base<T, I>::to_string() << std::endl;
 #endif
     }
 
@@ -62,24 +62,38 @@ public:
 
     long read(T& data)
     {
-        return read(&data, 1, ringbuffer_base<T>::template copy<T>);
+        return read(&data, 1, ringbuffer_base<T, I>::template copy<T>);
     }
 
     long read(T&& data)
     {
-        return read(&data, 1, ringbuffer_base<T>::template move<T>);
+        return read(&data, 1, ringbuffer_base<T, I>::template move<T>);
     }
 
     template<std::size_t N>
     long read(T (&data)[N])
     {
-        return read(data, N, ringbuffer_base<T>::template copy<T>);
+        return read(data, N, ringbuffer_base<T, I>::template copy<T>);
     }
 
     template<std::size_t N>
     long read(T (&&data)[N])
     {
-        return read(data, N, ringbuffer_base<T>::template move<T>);
+        return read(data, N, ringbuffer_base<T, I>::template move<T>);
+    }
+
+    /**
+     * Reads up to 'count' elements into 'data' (copied or moved out of the buffer).
+     *
+     * @return number of elements read or one of ringbuffer_status codes.
+     */
+    template<ringbuffer_xfer_semantic S>
+    long read(T* data, std::size_t count)
+    {
+        if constexpr (S == ringbuffer_xfer_semantic::MOVE)
+            return read(data, count, ringbuffer_base<T, I>::template move<T>);
+        else
+            return read(data, count, ringbuffer_base<T, I>::template copy<T>);
     }
 
     long read(std::function<bool(T*)> consumer, std::size_t count)
@@ -103,54 +117,65 @@ private:
     template<typename DST, typename SRC>
     long read(DST data, std::size_t count, bool (*xfer)(DST, SRC, std::size_t))
     {
-        std::size_t produced;
         std::size_t consumed;
         std::size_t available_elements;
         std::size_t read_idx;
         std::size_t split;
         std::size_t remaining;
         ringbuffer_status rbs;
+        typename ringbuffer_base<T, I>::consumer_guard guard{*this};
 
         if (0 == count)
             return 0;
 
-        if (ringbuffer_base<T>::m_flags.test(RINGBUFFER_NONBLOCKING_READ_SHIFT)) {
-            rbs = ringbuffer_base<T>::get_counters(&produced, &consumed, nullptr);
+        if (ringbuffer_base<T, I>::m_flags.test(RINGBUFFER_NONBLOCKING_READ_SHIFT)) {
+            guard.lock();
+            rbs = ringbuffer_base<T, I>::available_elements(count, &consumed, &available_elements);
             if (rbs != ringbuffer_status::OK)
                 return static_cast<long>(rbs);
 
-            available_elements = produced - consumed;
             if (0 == available_elements) {
                return static_cast<long>(ringbuffer_status::WOULD_BLOCK);
             }
         } else {
             for (;;) {
-                rbs = ringbuffer_base<T>::get_counters(&produced, &consumed, nullptr);
+                guard.lock();
+                rbs = ringbuffer_base<T, I>::available_elements(count, &consumed, &available_elements);
                 if (rbs != ringbuffer_status::OK)
                     return static_cast<long>(rbs);
 
-                available_elements = produced - consumed;
                 if (available_elements > 0)
                     break; /* leave the loop if we have elements to be read */
 
-                ringbuffer_base<T>::m_reading_semaphore.wait(); /* let's wait until producer will write some data */
-                if (ringbuffer_base<T>::m_is_reading_cancelled) {
-                    ringbuffer_base<T>::m_is_reading_cancelled = false;
+                guard.unlock();
+
+                /* elements written before the cancellation are still handed out,
+                   the producer may have written its last ones since they were counted above */
+                if (ringbuffer_base<T, I>::m_is_reading_cancelled) {
+                    if (ringbuffer_base<T, I>::m_counters.m_produced.load(std::memory_order_acquire) != consumed)
+                        continue;
+
+                    ringbuffer_base<T, I>::m_is_reading_cancelled = false;
                     return static_cast<long>(ringbuffer_status::OPERATION_CANCELLED);
                 }
+
+                ringbuffer_base<T, I>::m_reading_semaphore.wait(); /* let's wait until producer will write some data */
             }
         }
 
+        if (available_elements > ringbuffer_base<T, I>::m_counters.m_high_watermark.load(std::memory_order_relaxed))
+            ringbuffer_base<T, I>::m_counters.m_high_watermark.store(available_elements, std::memory_order_relaxed);
+
         if (count > available_elements)
             count = available_elements;
 
-        read_idx = consumed % ringbuffer_base<T>::m_capacity;
+        read_idx = ringbuffer_base<T, I>::index(consumed);
 
-        split = ((read_idx + count) > ringbuffer_base<T>::m_capacity) ? (ringbuffer_base<T>::m_capacity - read_idx) : 0;
+        split = ((read_idx + count) > ringbuffer_base<T, I>::m_capacity) ? (ringbuffer_base<T, I>::m_capacity - read_idx) : 0;
         remaining = count;
 
         if (split > 0) {
-            if (false == xfer(data, ringbuffer_base<T>::m_buffer + read_idx, split))
+            if (false == xfer(data, ringbuffer_base<T, I>::m_buffer + read_idx, split))
                 return static_cast<long>(ringbuffer_status::INTERNAL_ERROR);
 
             data += split;
@@ -158,13 +183,15 @@ private:
             read_idx = 0;
         }
 
-        if (false == xfer(data, ringbuffer_base<T>::m_buffer + read_idx, remaining))
+        if (false == xfer(data, ringbuffer_base<T, I>::m_buffer + read_idx, remaining))
             return static_cast<long>(ringbuffer_status::INTERNAL_ERROR);
 
-        ringbuffer_base<T>::m_counters.m_consumed.store(consumed + count, std::memory_order_relaxed);
+        /* release elements read above back to the producer */
+        ringbuffer_base<T, I>::m_counters.m_consumed.store(consumed + count, std::memory_order_release);
+        guard.unlock();
 
-        if (!ringbuffer_base<T>::m_flags.test(RINGBUFFER_NONBLOCKING_WRITE_SHIFT))
-            ringbuffer_base<T>::m_writing_semaphore.post(); /* wake up one thread waiting for some space in the buffer (if any) */
+        if (!ringbuffer_base<T, I>::m_flags.test(RINGBUFFER_NONBLOCKING_WRITE_SHIFT))
+            ringbuffer_base<T, I>::m_writing_semaphore.post(); /* wake up one thread waiting for some space in the buffer (if any) */
 
         return count;
     }
@@ -0,0 +1,182 @@
+/**
+ * @file net_output.hpp
+ *
+ * Connects sockets the output is sent to, given as udp://<host>:<port> or tcp://<host>:<port>
+ * (numeric ipv6 hosts in brackets). Udp ones may be multicast groups, so that many
+ * listeners can receive the very same datagrams.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _NET_OUTPUT_HPP_
+#define _NET_OUTPUT_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <string>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "strtointeger.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+struct net_address
+{
+    bool datagram; /* udp, tcp otherwise */
+    std::string host;
+    uint16_t port;
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/**
+ * @return true if 'url' is udp://<host>:<port> or tcp://<host>:<port>, false otherwise.
+ */
+inline bool net_address_from_string(const char* url, net_address& address)
+{
+    std::string s{url};
+
+    if (s.compare(0, 6, "udp://") == 0)
+        address.datagram = true;
+    else
+    if (s.compare(0, 6, "tcp://") == 0)
+        address.datagram = false;
+    else
+        return false;
+
+    s = s.substr(6);
+
+    std::size_t colon = s.rfind(':');
+    if ((colon == std::string::npos) || (colon == 0))
+        return false;
+
+    if (strtointeger(s.substr(colon + 1).c_str(), address.port) != strtointeger_conversion_status_e::success)
+        return false;
+
+    address.host = s.substr(0, colon);
+    if ((address.host.size() > 2) && (address.host.front() == '[') && (address.host.back() == ']'))
+        address.host = address.host.substr(1, address.host.size() - 2);
+
+    return true;
+}
+
+/**
+ * Creates a socket connected to 'address' (port_offset added to its port, so that several
+ * outputs may get consecutive ports). Tcp ones send without delay (frames are already coalesced
+ * by the sink), multicast groups get 'ttl' (hops) and loop back to local listeners.
+ *
+ * @return the socket or -1 on error (errno is set, EHOSTUNREACH if the host cannot be resolved).
+ */
+inline int connect_net_output(const net_address& address, uint16_t port_offset, int ttl)
+{
+    struct addrinfo hints;
+    struct addrinfo* result = nullptr;
+    const std::string port = std::to_string(address.port + port_offset);
+    int fd = -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = address.datagram ? SOCK_DGRAM : SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+
+    int status = getaddrinfo(address.host.c_str(), port.c_str(), &hints, &result);
+    if (status != 0) {
+        errno = (status == EAI_SYSTEM) ? errno : EHOSTUNREACH;
+        return -1;
+    }
+
+    for (struct addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+
+        if (address.datagram) {
+            const int loop = 1;
+
+            if ((ai->ai_family == AF_INET) &&
+                IN_MULTICAST(ntohl(reinterpret_cast<const struct sockaddr_in*>(ai->ai_addr)->sin_addr.s_addr))) {
+                setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+                setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+            }
+
+            if ((ai->ai_family == AF_INET6) &&
+                IN6_IS_ADDR_MULTICAST(&reinterpret_cast<const struct sockaddr_in6*>(ai->ai_addr)->sin6_addr)) {
+                setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &ttl, sizeof(ttl));
+                setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &loop, sizeof(loop));
+            }
+        }
+        else {
+            const int nodelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        }
+
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+
+        status = errno;
+        close(fd);
+        errno = status;
+        fd = -1;
+    }
+
+    freeaddrinfo(result);
+
+    return fd;
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _NET_OUTPUT_HPP_ */
@@ -40,16 +40,16 @@
 namespace ymn
 {
 
-template<typename T>
-class oringbuffer : public virtual ringbuffer_base<T>
+template<typename T, typename I = ringbuffer_index_modulo>
+class oringbuffer : public virtual ringbuffer_base<T, I>
 {
 public:
     explicit oringbuffer() :
-        ringbuffer_base<T>::ringbuffer_base{}
+        ringbuffer_base<T, I>::ringbuffer_base{}
     {
 #if defined(DEBUG_RINGBUFFER)
         std::cout << __PRETTY_FUNCTION__ << std::endl;
-        std::cout << ringbuffer_base<T>::to_string() << std::endl;
+        std::cout << ringbuffer_base<T, I>::to_string() << std::endl;
 #endif
     }
 
@@ -62,24 +62,38 @@ public:
 
     long write(const T& data)
     {
-        return write(&data, 1, ringbuffer_base<T>::template copy<T>);
+        return write(&data, 1, ringbuffer_base<T, I>::template copy<T>);
     }
 
     long write(T&& data)
     {
-        return write(&data, 1, ringbuffer_base<T>::template move<T>);
+        return write(&data, 1, ringbuffer_base<T, I>::template move<T>);
     }
 
     template<std::size_t N>
     long write(const T (&data)[N])
     {
-        return write(data, N, ringbuffer_base<T>::template copy<T>);
+        return write(data, N, ringbuffer_base<T, I>::template copy<T>);
     }
 
     template<std::size_t N>
     long write(T (&&data)[N])
     {
-        return write(data, N, ringbuffer_base<T>::template move<T>);
+        return write(data, N, ringbuffer_base<T, I>::template move<T>);
+    }
+
+    /**
+     * Writes up to 'count' elements from 'data' (copied or moved into the buffer).
+     *
+     * @return number of elements written or one of ringbuffer_status codes.
+     */
+    template<ringbuffer_xfer_semantic S>
+    long write(T* data, std::size_t count)
+    {
+        if constexpr (S == ringbuffer_xfer_semantic::MOVE)
+            return write(data, count, ringbuffer_base<T, I>::template move<T>);
+        else
+            return write(const_cast<const T*>(data), count, ringbuffer_base<T, I>::template copy<T>);
     }
 
     long write(std::function<bool(T*)> producer, std::size_t count)
@@ -104,7 +118,6 @@ private:
     long write(SRC data, std::size_t count, bool (*xfer)(DST, SRC, std::size_t))
     {
         std::size_t produced;
-        std::size_t consumed;
         std::size_t free_elements;
         std::size_t write_idx;
         std::size_t split;
@@ -114,44 +127,51 @@ private:
         if (0 == count)
             return 0;
 
-        if (ringbuffer_base<T>::m_flags.test(RINGBUFFER_NONBLOCKING_WRITE_SHIFT)) {
-            rbs = ringbuffer_base<T>::get_counters(&produced, &consumed, nullptr);
+        if (ringbuffer_base<T, I>::m_flags.test(RINGBUFFER_NONBLOCKING_WRITE_SHIFT)) {
+            rbs = ringbuffer_base<T, I>::free_elements(count, &produced, &free_elements);
             if (rbs != ringbuffer_status::OK)
                 return static_cast<long>(rbs);
 
-            free_elements = ringbuffer_base<T>::m_capacity - (produced - consumed);
+            if ((free_elements < count) && ringbuffer_base<T, I>::m_flags.test(RINGBUFFER_OVERWRITE_SHIFT))
+                free_elements = ringbuffer_base<T, I>::drop_oldest(count, produced);
+
             if (0 == free_elements) {
-                ringbuffer_base<T>::m_counters.m_dropped++;
+                ringbuffer_base<T, I>::m_counters.m_dropped.fetch_add(1, std::memory_order_relaxed);
                 return static_cast<long>(ringbuffer_status::WOULD_BLOCK);
             }
         } else {
             for (;;) {
-                rbs = ringbuffer_base<T>::get_counters(&produced, &consumed, nullptr);
+                rbs = ringbuffer_base<T, I>::free_elements(count, &produced, &free_elements);
                 if (rbs != ringbuffer_status::OK)
                     return static_cast<long>(rbs);
 
-                free_elements = ringbuffer_base<T>::m_capacity - (produced - consumed);
                 if (free_elements > 0)
                     break; /* leave the loop if we have room for new data */
 
-                ringbuffer_base<T>::m_writing_semaphore.wait(); /* let's wait until consumer will read some data */
-                if (ringbuffer_base<T>::m_is_writing_cancelled) {
-                    ringbuffer_base<T>::m_is_writing_cancelled = false;
+                /* room made before the cancellation is still taken,
+                   the consumer may have released it since it was counted above */
+                if (ringbuffer_base<T, I>::m_is_writing_cancelled) {
+                    if ((produced - ringbuffer_base<T, I>::m_counters.m_consumed.load(std::memory_order_acquire)) < ringbuffer_base<T, I>::m_capacity)
+                        continue;
+
+                    ringbuffer_base<T, I>::m_is_writing_cancelled = false;
                     return static_cast<long>(ringbuffer_status::OPERATION_CANCELLED);
                 }
+
+                ringbuffer_base<T, I>::m_writing_semaphore.wait(); /* let's wait until consumer will read some data */
             }
         }
 
         if (count > free_elements)
             count = free_elements;
 
-        write_idx = produced % ringbuffer_base<T>::m_capacity;
+        write_idx = ringbuffer_base<T, I>::index(produced);
 
-        split = ((write_idx + count) > ringbuffer_base<T>::m_capacity) ? (ringbuffer_base<T>::m_capacity - write_idx) : 0;
+        split = ((write_idx + count) > ringbuffer_base<T, I>::m_capacity) ? (ringbuffer_base<T, I>::m_capacity - write_idx) : 0;
         remaining = count;
 
         if (split > 0) {
-            if (false == xfer(ringbuffer_base<T>::m_buffer + write_idx, data, split))
+            if (false == xfer(ringbuffer_base<T, I>::m_buffer + write_idx, data, split))
                 return static_cast<long>(ringbuffer_status::INTERNAL_ERROR);
 
             data += split;
@@ -159,13 +179,14 @@ private:
             write_idx = 0;
         }
 
-        if (false == xfer(ringbuffer_base<T>::m_buffer + write_idx, data, remaining))
+        if (false == xfer(ringbuffer_base<T, I>::m_buffer + write_idx, data, remaining))
             return static_cast<long>(ringbuffer_status::INTERNAL_ERROR);
 
-        ringbuffer_base<T>::m_counters.m_produced.store(produced + count, std::memory_order_relaxed);
+        /* publish elements transferred above */
+        ringbuffer_base<T, I>::m_counters.m_produced.store(produced + count, std::memory_order_release);
 
-        if (!ringbuffer_base<T>::m_flags.test(RINGBUFFER_NONBLOCKING_READ_SHIFT))
-            ringbuffer_base<T>::m_reading_semaphore.post(); /* wake up one thread waiting for new data (if any) */
+        if (!ringbuffer_base<T, I>::m_flags.test(RINGBUFFER_NONBLOCKING_READ_SHIFT))
+            ringbuffer_base<T, I>::m_reading_semaphore.post(); /* wake up one thread waiting for new data (if any) */
 
         return count;
     }
@@ -0,0 +1,511 @@
+/**
+ * @file pcm_sink.hpp
+ *
+ * Writes blocks of pcm samples to one or more file descriptors,
+ * trading latency against the number of system calls explicitly:
+ * blocks are queued (not copied) and written out, each output with one writev()
+ * (or vmsplice() for pipes), once enough bytes are queued or the oldest of them
+ * waits long enough.
+ * Sockets get the samples in frames, each preceded by a pcm_frame_header:
+ * datagram ones (e.g. udp, multicast) one frame per datagram, all of them sent
+ * with one sendmmsg(), stream ones (e.g. tcp) with one writev() as well.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _PCM_SINK_HPP_
+#define _PCM_SINK_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <vector>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <sstream>
+#include <utility>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+#include <climits>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <endian.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "pipeline_metrics.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define PCM_FRAME_MAGIC          (0x50434d46) /* "PCMF" */
+#define PCM_FRAME_DATAGRAM_BYTES (1408)       /* max samples bytes of a datagram (fits an ethernet mtu) */
+#define PCM_FRAME_STREAM_BYTES   (32768)      /* max samples bytes of a frame on a stream socket */
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/* precedes samples of every frame sent to a socket, all fields are big endian */
+struct pcm_frame_header
+{
+    uint32_t magic;       /* PCM_FRAME_MAGIC */
+    uint32_t sequence;    /* of the frame within its output, a gap means frames were lost */
+    uint64_t timestamp;   /* capture time (ns since the epoch) of the block the samples come from */
+    uint32_t sample_rate; /* Hz */
+    uint16_t channels;    /* interleaved 16 bits (LE) samples */
+    uint16_t length;      /* bytes of samples following the header */
+};
+
+static_assert(sizeof(pcm_frame_header) == 24, "pcm_frame_header must not be padded");
+
+enum class pcm_sink_method
+{
+    WRITEV,
+    VMSPLICE, /* for pipes, other outputs are still written by writev() */
+};
+
+struct pcm_sink_config
+{
+    std::size_t flush_bytes;            /* write out once that many bytes (of any output) are queued */
+    metrics_clock::duration flush_time; /* or once the oldest queued block waits that long (checked on commit()) */
+    bool flush_each_block;              /* ignore both, write every block as soon as it is pushed */
+    pcm_sink_method method;
+    uint32_t sample_rate;               /* of the samples, carried in frame headers (sockets only) */
+    uint16_t channels;
+};
+
+/**
+ * @param H Type of (owning) handles of the blocks, e.g. std::unique_ptr.
+ *
+ * With both flush_bytes and flush_time being 0 whatever is queued is written on every commit().
+ */
+template<typename H>
+class pcm_sink
+{
+public:
+    /**
+     * @param[in] fds Outputs, i-th span of each block goes to i-th of them (they are not closed).
+     * @param[in] config See pcm_sink_config.
+     * @param[in] latency If not null, records time from capture to write of each block.
+     */
+    explicit pcm_sink(const std::vector<int>& fds, const pcm_sink_config& config, latency_histogram* latency = nullptr) :
+        m_config{config},
+        m_latency{latency},
+        m_outputs{},
+        m_entries{},
+        m_free{},
+        m_written{0},
+        m_oldest{},
+        m_blocks{0},
+        m_syscalls{0},
+        m_bytes{0},
+        m_frames{0},
+        m_lost_frames{0}
+    {
+        for (int fd : fds) {
+            output o{fd, false, 0, 0, 0, 0, {}, output_framing::NONE, 0, {}, {}};
+            struct stat st;
+
+            if ((m_config.method == pcm_sink_method::VMSPLICE) && (fstat(fd, &st) == 0) && S_ISFIFO(st.st_mode)) {
+                int pipe_size = fcntl(fd, F_GETPIPE_SZ);
+                if (pipe_size > 0) {
+                    o.splice = true;
+                    o.pipe_size = static_cast<std::size_t>(pipe_size);
+                }
+            }
+
+            if ((fstat(fd, &st) == 0) && S_ISSOCK(st.st_mode)) {
+                int type = 0;
+                socklen_t length = sizeof(type);
+                if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) == 0)
+                    o.framing = (type == SOCK_DGRAM) ? output_framing::DATAGRAM : output_framing::STREAM;
+            }
+
+            m_outputs.push_back(o);
+        }
+    }
+
+    pcm_sink(const pcm_sink&) = delete;
+    pcm_sink& operator = (const pcm_sink&) = delete;
+
+    /**
+     * Queues a block, spans[i] (one for each output, may be empty) goes to i-th output.
+     * The block is kept (so that its spans stay valid) until it is written out,
+     * for vmsplice()d outputs until the pipe could not hold it any longer
+     * (i.e. the reader must have read it), as the pipe refers to its pages rather than a copy.
+     *
+     * @return false if an output could not be written (flush_each_block only), true otherwise.
+     */
+    bool push(H&& block, const struct iovec* spans, metrics_clock::time_point captured)
+    {
+        entry e;
+
+        if (!m_free.empty()) {
+            e = std::move(m_free.back());
+            m_free.pop_back();
+        }
+
+        e.block = std::move(block);
+        e.captured = captured;
+        e.spans.assign(spans, spans + m_outputs.size());
+        e.ends.resize(m_outputs.size());
+
+        for (std::size_t i = 0; i < m_outputs.size(); ++i) {
+            m_outputs[i].queued += spans[i].iov_len;
+            m_outputs[i].pending += spans[i].iov_len;
+            e.ends[i] = m_outputs[i].queued;
+        }
+
+        if (m_written == m_entries.size())
+            m_oldest = metrics_clock::now();
+
+        m_entries.push_back(std::move(e));
+        m_blocks++;
+
+        return m_config.flush_each_block ? flush() : true;
+    }
+
+    /**
+     * Writes out queued blocks if either of the thresholds is reached.
+     *
+     * @return false if an output could not be written, true otherwise.
+     */
+    bool commit(metrics_clock::time_point now)
+    {
+        if (m_written == m_entries.size())
+            return true;
+
+        bool due = (m_config.flush_bytes == 0) && (m_config.flush_time == metrics_clock::duration::zero());
+
+        if (m_config.flush_bytes > 0)
+            for (const output& o : m_outputs)
+                due = due || (o.pending >= m_config.flush_bytes);
+
+        if (m_config.flush_time > metrics_clock::duration::zero())
+            due = due || ((now - m_oldest) >= m_config.flush_time);
+
+        return due ? flush() : true;
+    }
+
+    /**
+     * Writes out all queued blocks.
+     *
+     * @return false if an output could not be written, true otherwise.
+     */
+    bool flush()
+    {
+        bool status = true;
+
+        if (m_written < m_entries.size()) {
+            for (std::size_t i = 0; i < m_outputs.size(); ++i) {
+                output& o = m_outputs[i];
+
+                /* blocks need not carry samples of every output (e.g. those of other devices) */
+                if (o.pending == 0)
+                    continue;
+
+                o.iov.clear();
+                if (o.framing == output_framing::NONE) {
+                    for (std::size_t k = m_written; k < m_entries.size(); ++k)
+                        if (m_entries[k].spans[i].iov_len > 0)
+                            o.iov.push_back(m_entries[k].spans[i]);
+                }
+                else
+                    frame(o, i);
+
+                status = ((o.framing == output_framing::DATAGRAM) ? send_out(o) : write_out(o)) && status;
+                o.pending = 0;
+            }
+
+            if (m_latency != nullptr) {
+                const metrics_clock::time_point now = metrics_clock::now();
+                for (std::size_t k = m_written; k < m_entries.size(); ++k)
+                    m_latency->record(now - m_entries[k].captured);
+            }
+
+            m_written = m_entries.size();
+        }
+
+        release();
+
+        return status;
+    }
+
+    /* drops all the blocks still kept (nothing is written) */
+    void clear()
+    {
+        m_entries.clear();
+        m_free.clear();
+        m_written = 0;
+        for (output& o : m_outputs)
+            o.pending = 0;
+    }
+
+    /* bytes the pipes of vmsplice()d outputs may hold (as many are kept by the sink), 0 if there are none */
+    std::size_t pipe_bytes() const
+    {
+        std::size_t bytes = 0;
+
+        for (const output& o : m_outputs)
+            if (o.splice)
+                bytes = std::max(bytes, o.pipe_size);
+
+        return bytes;
+    }
+
+    std::string to_string() const
+    {
+        std::ostringstream stream;
+        std::size_t spliced = 0;
+        std::size_t datagram = 0;
+        std::size_t stream_sockets = 0;
+
+        for (const output& o : m_outputs) {
+            spliced += o.splice ? 1 : 0;
+            datagram += (o.framing == output_framing::DATAGRAM) ? 1 : 0;
+            stream_sockets += (o.framing == output_framing::STREAM) ? 1 : 0;
+        }
+
+        stream << "sink [outputs: " << m_outputs.size() << " (" << spliced << " vmsplice";
+        stream << ", " << datagram << " datagram, " << stream_sockets << " stream)";
+        stream << ", blocks: " << m_blocks;
+        stream << ", system calls: " << m_syscalls;
+        stream << ", bytes: " << m_bytes;
+        if ((datagram + stream_sockets) > 0) {
+            stream << ", frames: " << m_frames;
+            stream << ", lost frames: " << m_lost_frames;
+        }
+        stream << "]";
+
+        return stream.str();
+    }
+
+private:
+    enum class output_framing
+    {
+        NONE,     /* plain samples */
+        DATAGRAM, /* a frame per datagram */
+        STREAM,   /* frames one after another */
+    };
+
+    struct output
+    {
+        int fd;
+        bool splice;
+        std::size_t pipe_size;
+        uint64_t queued;     /* bytes ever queued */
+        uint64_t written;    /* bytes ever written */
+        std::size_t pending; /* bytes queued, but not written yet */
+        std::vector<struct iovec> iov;
+        output_framing framing;
+        uint32_t sequence;   /* of the next frame */
+        std::vector<pcm_frame_header> headers; /* of the frames being written */
+        std::vector<struct mmsghdr> messages;
+    };
+
+    struct entry
+    {
+        H block;
+        metrics_clock::time_point captured;
+        std::vector<struct iovec> spans;
+        std::vector<uint64_t> ends; /* offsets (past the last byte) of the spans within the outputs */
+    };
+
+    bool write_out(output& o)
+    {
+        struct iovec* iov = o.iov.data();
+        std::size_t count = o.iov.size();
+        std::size_t i = 0;
+
+        while (i < count) {
+            const int chunk = static_cast<int>(std::min<std::size_t>(count - i, IOV_MAX));
+            ssize_t status = o.splice ? vmsplice(o.fd, iov + i, chunk, 0) : writev(o.fd, iov + i, chunk);
+
+            if (status < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+
+            m_syscalls++;
+            m_bytes += static_cast<uint64_t>(status);
+            o.written += static_cast<uint64_t>(status);
+
+            /* skip what has been written, partially written span is trimmed */
+            std::size_t n = static_cast<std::size_t>(status);
+            while ((i < count) && (n >= iov[i].iov_len)) {
+                n -= iov[i].iov_len;
+                ++i;
+            }
+
+            if (n > 0) {
+                iov[i].iov_base = static_cast<uint8_t*>(iov[i].iov_base) + n;
+                iov[i].iov_len -= n;
+            }
+        }
+
+        return true;
+    }
+
+    /* splits spans of the queued blocks into frames, iov gets [header, samples] of each of them */
+    void frame(output& o, std::size_t i)
+    {
+        const std::size_t max = (o.framing == output_framing::DATAGRAM) ? PCM_FRAME_DATAGRAM_BYTES : PCM_FRAME_STREAM_BYTES;
+        const metrics_clock::time_point now = metrics_clock::now();
+        const int64_t epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::size_t frames = 0;
+
+        for (std::size_t k = m_written; k < m_entries.size(); ++k)
+            frames += (m_entries[k].spans[i].iov_len + max - 1) / max;
+
+        /* headers are not moved once iov points to them */
+        o.headers.resize(frames);
+        frames = 0;
+
+        for (std::size_t k = m_written; k < m_entries.size(); ++k) {
+            const struct iovec& span = m_entries[k].spans[i];
+            const int64_t timestamp = epoch - std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_entries[k].captured).count();
+
+            for (std::size_t offset = 0; offset < span.iov_len; offset += max) {
+                const std::size_t length = std::min(max, span.iov_len - offset);
+                pcm_frame_header& header = o.headers[frames++];
+
+                header.magic = htobe32(PCM_FRAME_MAGIC);
+                header.sequence = htobe32(o.sequence++);
+                header.timestamp = htobe64(static_cast<uint64_t>(timestamp));
+                header.sample_rate = htobe32(m_config.sample_rate);
+                header.channels = htobe16(m_config.channels);
+                header.length = htobe16(static_cast<uint16_t>(length));
+
+                o.iov.push_back({&header, sizeof(header)});
+                o.iov.push_back({static_cast<uint8_t*>(span.iov_base) + offset, length});
+            }
+        }
+
+        m_frames += frames;
+    }
+
+    /* one datagram per frame (two iov entries each), as many as possible per sendmmsg() */
+    bool send_out(output& o)
+    {
+        const std::size_t count = o.iov.size() / 2;
+        std::size_t i = 0;
+
+        o.messages.resize(count);
+        for (std::size_t m = 0; m < count; ++m) {
+            o.messages[m] = mmsghdr{};
+            o.messages[m].msg_hdr.msg_iov = &o.iov[2 * m];
+            o.messages[m].msg_hdr.msg_iovlen = 2;
+        }
+
+        while (i < count) {
+            const unsigned int chunk = static_cast<unsigned int>(std::min<std::size_t>(count - i, IOV_MAX));
+            int status = sendmmsg(o.fd, o.messages.data() + i, chunk, 0);
+
+            if (status < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                /* nobody listens (yet) or the socket buffer is full: the frame is lost, the stream goes on */
+                if ((errno == ECONNREFUSED) || (errno == ENOBUFS) || (errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                    m_lost_frames++;
+                    ++i;
+                    continue;
+                }
+
+                return false;
+            }
+
+            m_syscalls++;
+            for (int m = 0; m < status; ++m)
+                m_bytes += o.messages[i + m].msg_len;
+            i += static_cast<std::size_t>(status);
+        }
+
+        return true;
+    }
+
+    /* a pipe holds at most pipe_size bytes, so anything written before the last pipe_size bytes has been read */
+    bool in_pipe(const entry& e) const
+    {
+        for (std::size_t i = 0; i < m_outputs.size(); ++i)
+            if (m_outputs[i].splice && ((m_outputs[i].written - e.ends[i]) < m_outputs[i].pipe_size))
+                return true;
+
+        return false;
+    }
+
+    void release()
+    {
+        while ((m_written > 0) && !in_pipe(m_entries.front())) {
+            entry& e = m_entries.front();
+            e.block = H{};
+            m_free.push_back(std::move(e));
+            m_entries.pop_front();
+            m_written--;
+        }
+    }
+
+    const pcm_sink_config m_config;
+    latency_histogram* m_latency;
+    std::vector<output> m_outputs;
+    std::deque<entry> m_entries; /* [0, m_written) written (but maybe still in a pipe), the rest queued */
+    std::vector<entry> m_free;   /* recycled, so that their vectors are not allocated again */
+    std::size_t m_written;
+    metrics_clock::time_point m_oldest; /* when the oldest of queued blocks was pushed */
+    uint64_t m_blocks;
+    uint64_t m_syscalls;
+    uint64_t m_bytes;
+    uint64_t m_frames;      /* sent to sockets */
+    uint64_t m_lost_frames; /* datagrams which could not be sent */
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _PCM_SINK_HPP_ */
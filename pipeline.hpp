@@ -28,12 +28,17 @@
 #include <functional>
 #include <thread>
 #include <atomic>
+#include <vector>
+#include <type_traits>
 
 /*===========================================================================*\
  * project header files
 \*===========================================================================*/
 #include "semaphore.hpp"
+#include "power_of_two.hpp"
 #include "ringbuffer.hpp"
+#include "buffer_pool.hpp"
+#include "pipeline_batch.hpp"
 
 /*===========================================================================*\
  * preprocessor #define constants and macros
@@ -57,27 +62,50 @@ class pipeline
 {
 public:
     /* All pipeline buffers must extend this tagging type */
-    struct buffer
+    struct buffer : public pooled_buffer
     {
-        virtual ~buffer() = default;
     };
 
-    using buffer_uptr = std::unique_ptr<buffer>;
+    /* Pooled buffers go back to their pool once released */
+    using buffer_uptr = std::unique_ptr<buffer, pooled_buffer_deleter>;
 
-    using stage_function = std::function<bool(iringbuffer<buffer_uptr>* irb, oringbuffer<buffer_uptr>* orb)>;
+    /* queues use power of two capacities and masked indexing */
+    using ringbuffer_type = ringbuffer<buffer_uptr, ringbuffer_index_mask>;
+    using iringbuffer_type = iringbuffer<buffer_uptr, ringbuffer_index_mask>;
+    using oringbuffer_type = oringbuffer<buffer_uptr, ringbuffer_index_mask>;
+
+    using stage_function = std::function<bool(iringbuffer_type* irb, oringbuffer_type* orb)>;
+
+    /* up to N buffers moved through a queue at once (see pipeline_batch.hpp) */
+    template<std::size_t N>
+    using batch = pipeline_batch<buffer_uptr, N>;
+
+    template<std::size_t N>
+    static long read(iringbuffer_type* irb, batch<N>& b)
+    {
+        return pipeline_read(irb, b);
+    }
+
+    template<std::size_t N>
+    static long write(oringbuffer_type* orb, batch<N>& b)
+    {
+        return pipeline_write(orb, b);
+    }
 
     template<std::size_t N>
     explicit pipeline(stage_function (&f)[N], std::size_t queue_capacity) :
        m_size{N},
+       m_queue_capacity{round_up_to_power_of_two(queue_capacity)},
+       m_pools{},
        m_stages{std::make_unique<std::unique_ptr<stage_exec_env>[]>(N)},
        m_ringbuffers{},
        m_running{false}
     {
         if (N > 1) {
-            m_ringbuffers = std::make_unique<std::unique_ptr<ringbuffer<buffer_uptr>>[]>(N - 1);
+            m_ringbuffers = std::make_unique<std::unique_ptr<ringbuffer_type>[]>(N - 1);
             for (std::size_t n = 0; n < (N - 1); ++n)
-                m_ringbuffers[n] = std::make_unique<ringbuffer<buffer_uptr>>(
-                    queue_capacity, RINGBUFFER_RD_BLOCKING_WR_NONBLOCKING);
+                m_ringbuffers[n] = std::make_unique<ringbuffer_type>(
+                    m_queue_capacity, RINGBUFFER_RD_BLOCKING_WR_NONBLOCKING);
         }
 
         for (std::size_t n = 0; n < N; ++n) {
@@ -85,21 +113,46 @@ public:
             if (N > 1) {
                 if (n == 0)
                     m_stages[n]->set_ringbuffers(
-                        static_cast<iringbuffer<buffer_uptr>*>(nullptr),
-                        static_cast<oringbuffer<buffer_uptr>*>(m_ringbuffers[n].get()));
+                        static_cast<iringbuffer_type*>(nullptr),
+                        static_cast<oringbuffer_type*>(m_ringbuffers[n].get()));
                 else
                 if (n == (N - 1))
                     m_stages[n]->set_ringbuffers(
-                        static_cast<iringbuffer<buffer_uptr>*>(m_ringbuffers[n - 1].get()),
-                        static_cast<oringbuffer<buffer_uptr>*>(nullptr));
+                        static_cast<iringbuffer_type*>(m_ringbuffers[n - 1].get()),
+                        static_cast<oringbuffer_type*>(nullptr));
                 else
                     m_stages[n]->set_ringbuffers(
-                        static_cast<iringbuffer<buffer_uptr>*>(m_ringbuffers[n - 1].get()),
-                        static_cast<oringbuffer<buffer_uptr>*>(m_ringbuffers[n].get()));
+                        static_cast<iringbuffer_type*>(m_ringbuffers[n - 1].get()),
+                        static_cast<oringbuffer_type*>(m_ringbuffers[n].get()));
             }
         }
     }
 
+    /* requested queue capacity rounded up to the power of two */
+    std::size_t queue_capacity() const
+    {
+        return m_queue_capacity;
+    }
+
+    /**
+     * Creates a pool of 'capacity' preallocated buffers (each constructed as T(args...)) owned by the pipeline.
+     * Pools outlive the queues, so buffers still sitting in the queues can be returned safely.
+     * Shall be called before start().
+     */
+    template<typename T, typename... Args>
+    buffer_pool* create_pool(std::size_t capacity, Args&&... args)
+    {
+        static_assert(std::is_base_of<buffer, T>::value, "T must extend pipeline::buffer");
+
+        m_pools.push_back(buffer_pool::create<T>(capacity, std::forward<Args>(args)...));
+        return m_pools.back().get();
+    }
+
+    const std::vector<std::unique_ptr<buffer_pool>>& pools() const
+    {
+        return m_pools;
+    }
+
     void start()
     {
         m_running = true;
@@ -136,7 +189,7 @@ private:
         {
         }
 
-        void set_ringbuffers(iringbuffer<buffer_uptr>* irb, oringbuffer<buffer_uptr>* orb)
+        void set_ringbuffers(iringbuffer_type* irb, oringbuffer_type* orb)
         {
             m_irb = irb;
             m_orb = orb;
@@ -162,15 +215,17 @@ private:
 
         const pipeline& m_pipeline;
         stage_function m_function;
-        iringbuffer<buffer_uptr>* m_irb;
-        oringbuffer<buffer_uptr>* m_orb;
+        iringbuffer_type* m_irb;
+        oringbuffer_type* m_orb;
         mutable semaphore m_semaphore;
         std::thread m_thread;
     };
 
     std::size_t m_size;
+    std::size_t m_queue_capacity;
+    std::vector<std::unique_ptr<buffer_pool>> m_pools; /* must be destroyed after m_ringbuffers */
     std::unique_ptr<std::unique_ptr<stage_exec_env>[]> m_stages;
-    std::unique_ptr<std::unique_ptr<ringbuffer<buffer_uptr>>[]> m_ringbuffers;
+    std::unique_ptr<std::unique_ptr<ringbuffer_type>[]> m_ringbuffers;
     std::atomic<bool> m_running;
 };
 
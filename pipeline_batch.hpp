@@ -0,0 +1,169 @@
+/**
+ * @file pipeline_batch.hpp
+ *
+ * Up to N queue elements moved through a ringbuffer at once,
+ * so that the counters are updated and the peer is woken up
+ * once per batch instead of once per element.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _PIPELINE_BATCH_HPP_
+#define _PIPELINE_BATCH_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <utility>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "iringbuffer.hpp"
+#include "oringbuffer.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+template<typename T, std::size_t N>
+struct pipeline_batch
+{
+    static constexpr std::size_t capacity = N;
+
+    T& operator[](std::size_t n)
+    {
+        return m_elements[n];
+    }
+
+    T* begin()
+    {
+        return m_elements;
+    }
+
+    T* end()
+    {
+        return m_elements + m_size;
+    }
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    bool full() const
+    {
+        return m_size == N;
+    }
+
+    template<typename U>
+    void push_back(U&& element)
+    {
+        m_elements[m_size++] = std::forward<U>(element);
+    }
+
+    /* releases elements still held by the batch */
+    void clear()
+    {
+        for (std::size_t n = 0; n < m_size; ++n)
+            m_elements[n] = T{};
+        m_size = 0;
+    }
+
+    T m_elements[N];
+    std::size_t m_size = 0;
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/**
+ * Replaces contents of 'b' with up to N elements available in the queue
+ * (blocks until there is at least one when the queue is read in blocking mode).
+ *
+ * @return number of elements read or one of ringbuffer_status codes.
+ */
+template<typename T, typename I, std::size_t N>
+inline long pipeline_read(iringbuffer<T, I>* irb, pipeline_batch<T, N>& b)
+{
+    b.clear();
+
+    long status = irb->template read<ringbuffer_xfer_semantic::MOVE>(b.m_elements, N);
+    if (status > 0)
+        b.m_size = static_cast<std::size_t>(status);
+
+    return status;
+}
+
+/**
+ * Publishes all elements of 'b' at once. A blocking queue is waited on until
+ * all of them fit, elements which did not fit into a non blocking one
+ * are dropped (released), 'b' is left empty.
+ *
+ * @return number of elements written or one of ringbuffer_status codes.
+ */
+template<typename T, typename I, std::size_t N>
+inline long pipeline_write(oringbuffer<T, I>* orb, pipeline_batch<T, N>& b)
+{
+    long written = 0;
+
+    while (written < static_cast<long>(b.m_size)) {
+        long status = orb->template write<ringbuffer_xfer_semantic::MOVE>(
+            b.m_elements + written, b.m_size - written);
+        if (status <= 0) {
+            if (written == 0)
+                written = status;
+            break;
+        }
+        written += status;
+    }
+
+    b.clear();
+
+    return written;
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _PIPELINE_BATCH_HPP_ */
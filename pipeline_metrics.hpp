@@ -0,0 +1,382 @@
+/**
+ * @file pipeline_metrics.hpp
+ *
+ * Counters and latency histograms of pipeline stages.
+ * Recording is a few relaxed atomic increments (no locks, no allocations),
+ * so the metrics can always stay enabled, reading them (e.g. to print a snapshot)
+ * may happen at any time from any thread.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _PIPELINE_METRICS_HPP_
+#define _PIPELINE_METRICS_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <utility>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+using metrics_clock = std::chrono::steady_clock;
+
+/**
+ * Histogram of durations with power of two buckets,
+ * bucket k counts durations within [2^k, 2^(k+1)) nanoseconds.
+ */
+class latency_histogram
+{
+public:
+    static constexpr std::size_t buckets = 40; /* last one collects everything above ~9 minutes */
+
+    explicit latency_histogram() :
+        m_buckets{},
+        m_count{0},
+        m_sum{0},
+        m_max{0},
+        m_budget{0},
+        m_over_budget{0}
+    {
+    }
+
+    /* durations above the budget are counted on their own, 0 (default) disables it, shall be set before any record() */
+    void set_budget(metrics_clock::duration budget)
+    {
+        m_budget = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(budget).count());
+    }
+
+    void record(metrics_clock::duration duration)
+    {
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        const uint64_t value = (ns > 0) ? static_cast<uint64_t>(ns) : 0;
+
+        m_buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+
+        if ((m_budget > 0) && (value > m_budget))
+            m_over_budget.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while ((value > max) && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+    }
+
+    uint64_t count() const
+    {
+        return m_count.load(std::memory_order_relaxed);
+    }
+
+    /* in nanoseconds */
+    uint64_t sum() const
+    {
+        return m_sum.load(std::memory_order_relaxed);
+    }
+
+    /* in nanoseconds */
+    uint64_t max() const
+    {
+        return m_max.load(std::memory_order_relaxed);
+    }
+
+    /* in nanoseconds, 0 if there is none */
+    uint64_t budget() const
+    {
+        return m_budget;
+    }
+
+    uint64_t over_budget() const
+    {
+        return m_over_budget.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @param[in] p Fraction of recorded durations, (0, 1].
+     *
+     * @return upper bound (in nanoseconds) of the bucket holding the p-th quantile
+     * (but not more than the longest duration recorded).
+     */
+    uint64_t quantile(double p) const
+    {
+        const uint64_t total = count();
+        uint64_t cumulative = 0;
+
+        if (total == 0)
+            return 0;
+
+        for (std::size_t k = 0; k < buckets; ++k) {
+            cumulative += m_buckets[k].load(std::memory_order_relaxed);
+            if (cumulative >= p * total)
+                return (k < (buckets - 1)) ? std::min(UINT64_C(2) << k, max()) : max();
+        }
+
+        return max();
+    }
+
+    /* {"count": .., "mean_ns": .., "p50_ns": .., "p99_ns": .., "max_ns": .., ["budget_ns": .., "over_budget": ..,] "buckets": [..]} */
+    std::string to_json() const
+    {
+        std::ostringstream stream;
+        const uint64_t n = count();
+
+        stream << "{\"count\": " << n;
+        stream << ", \"mean_ns\": " << ((n > 0) ? (sum() / n) : 0);
+        stream << ", \"p50_ns\": " << quantile(0.5);
+        stream << ", \"p99_ns\": " << quantile(0.99);
+        stream << ", \"max_ns\": " << max();
+        if (m_budget > 0) {
+            stream << ", \"budget_ns\": " << m_budget;
+            stream << ", \"over_budget\": " << over_budget();
+        }
+        stream << ", \"buckets\": [";
+        for (std::size_t k = 0; k < buckets; ++k)
+            stream << ((k > 0) ? ", " : "") << m_buckets[k].load(std::memory_order_relaxed);
+        stream << "]}";
+
+        return stream.str();
+    }
+
+    std::string to_string() const
+    {
+        std::ostringstream stream;
+        const uint64_t n = count();
+
+        stream << "[count: " << n;
+        stream << ", mean: " << ((n > 0) ? (sum() / n / 1000) : 0) << " us";
+        stream << ", p50: " << quantile(0.5) / 1000 << " us";
+        stream << ", p99: " << quantile(0.99) / 1000 << " us";
+        stream << ", max: " << max() / 1000 << " us";
+        if (m_budget > 0)
+            stream << ", over " << m_budget / 1000 << " us budget: " << over_budget();
+        stream << "]";
+
+        return stream.str();
+    }
+
+private:
+    static std::size_t bucket_of(uint64_t value)
+    {
+        std::size_t k = (value > 0) ? static_cast<std::size_t>(63 - __builtin_clzll(value)) : 0;
+        return (k < buckets) ? k : (buckets - 1);
+    }
+
+    std::atomic<uint64_t> m_buckets[buckets];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_max;
+    uint64_t m_budget; /* in nanoseconds */
+    std::atomic<uint64_t> m_over_budget;
+};
+
+/*
+ * Metrics of one stage. Processing time covers the work done on one buffer
+ * (waiting on the queues is not included), dropped counts buffers the stage
+ * has lost (e.g. no free buffer in a pool or no room in a queue).
+ */
+struct stage_metrics
+{
+    /* records its own lifetime as the processing time of one buffer */
+    class scope
+    {
+    public:
+        explicit scope(stage_metrics& metrics) :
+            m_metrics{metrics},
+            m_start{metrics_clock::now()}
+        {
+        }
+
+        ~scope()
+        {
+            m_metrics.processing.record(metrics_clock::now() - m_start);
+        }
+
+        scope(const scope&) = delete;
+        scope& operator = (const scope&) = delete;
+
+    private:
+        stage_metrics& m_metrics;
+        metrics_clock::time_point m_start;
+    };
+
+    explicit stage_metrics(std::string stage_name) :
+        name{std::move(stage_name)},
+        processing{},
+        samples{0},
+        dropped{0}
+    {
+    }
+
+    void add_samples(std::size_t count)
+    {
+        samples.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void add_dropped(std::size_t count = 1)
+    {
+        dropped.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    std::string to_json() const
+    {
+        std::ostringstream stream;
+
+        stream << "{\"name\": \"" << name << "\"";
+        stream << ", \"samples\": " << samples.load(std::memory_order_relaxed);
+        stream << ", \"dropped\": " << dropped.load(std::memory_order_relaxed);
+        stream << ", \"processing\": " << processing.to_json();
+        stream << "}";
+
+        return stream.str();
+    }
+
+    std::string to_string() const
+    {
+        std::ostringstream stream;
+
+        stream << name << " [samples: " << samples.load(std::memory_order_relaxed);
+        stream << ", dropped: " << dropped.load(std::memory_order_relaxed);
+        stream << ", busy: " << processing.sum() / 1000000 << " ms";
+        stream << ", per buffer: " << processing.to_string();
+        stream << "]";
+
+        return stream.str();
+    }
+
+    const std::string name;
+    latency_histogram processing;
+    std::atomic<uint64_t> samples; /* input samples processed */
+    std::atomic<uint64_t> dropped; /* buffers lost */
+};
+
+/*
+ * Signal quality of one station: power (rssi, in dB relative to the full scale) of its last block
+ * at the intermediate rate, the highest one so far, and the numbers of blocks the squelch
+ * let through (open) and held back (squelched).
+ */
+struct signal_metrics
+{
+    explicit signal_metrics(std::string signal_name) :
+        name{std::move(signal_name)},
+        rssi{-HUGE_VAL},
+        peak{-HUGE_VAL},
+        open{0},
+        squelched{0}
+    {
+    }
+
+    /* written by one thread at a time (the one processing the station) */
+    void record(double level, bool passed)
+    {
+        rssi.store(level, std::memory_order_relaxed);
+        if (level > peak.load(std::memory_order_relaxed))
+            peak.store(level, std::memory_order_relaxed);
+        (passed ? open : squelched).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::string to_json() const
+    {
+        std::ostringstream stream;
+
+        stream << "{\"name\": \"" << name << "\"";
+        stream << ", \"rssi_db\": " << json_number(rssi.load(std::memory_order_relaxed));
+        stream << ", \"peak_db\": " << json_number(peak.load(std::memory_order_relaxed));
+        stream << ", \"open\": " << open.load(std::memory_order_relaxed);
+        stream << ", \"squelched\": " << squelched.load(std::memory_order_relaxed);
+        stream << "}";
+
+        return stream.str();
+    }
+
+    std::string to_string() const
+    {
+        std::ostringstream stream;
+
+        stream << std::fixed << std::setprecision(1);
+        stream << name << " [rssi: " << rssi.load(std::memory_order_relaxed) << " dBFS";
+        stream << ", peak: " << peak.load(std::memory_order_relaxed) << " dBFS";
+        stream << ", open: " << open.load(std::memory_order_relaxed);
+        stream << ", squelched: " << squelched.load(std::memory_order_relaxed);
+        stream << "]";
+
+        return stream.str();
+    }
+
+    const std::string name;
+    std::atomic<double> rssi; /* of the last block */
+    std::atomic<double> peak;
+    std::atomic<uint64_t> open;      /* blocks passed on */
+    std::atomic<uint64_t> squelched; /* blocks held back */
+
+private:
+    /* json has no infinities (no block recorded yet) */
+    static std::string json_number(double value)
+    {
+        std::ostringstream stream;
+
+        if (std::isfinite(value))
+            stream << std::fixed << std::setprecision(1) << value;
+        else
+            stream << "null";
+
+        return stream.str();
+    }
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _PIPELINE_METRICS_HPP_ */
@@ -21,6 +21,7 @@
 /*===========================================================================*\
  * system header files
 \*===========================================================================*/
+#include <cstddef>
 
 /*===========================================================================*\
  * project header files
@@ -49,6 +50,17 @@ constexpr bool is_power_of_two(std::size_t x)
     return (0 == (x & (x - 1)));
 }
 
+/* smallest power of two not less than x (1 for x == 0) */
+constexpr std::size_t round_up_to_power_of_two(std::size_t x)
+{
+    std::size_t p = 1;
+
+    while (p < x)
+        p <<= 1;
+
+    return p;
+}
+
 } /* end of namespace ymn */
 
 /*===========================================================================*\
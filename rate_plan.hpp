@@ -0,0 +1,178 @@
+/**
+ * @file rate_plan.hpp
+ *
+ * Sampling rates of the rtl-sdr-fm chain (and the filters between them).
+ * rtl rate -> cic (or channelizer) -> if filter (by CIC_FIR_DECIMATION) -> if rate -> audio filter -> audio rate.
+ * It is shared by rtl-sdr-fm and rtl-sdr-fm-bench, so that the latter measures what the former runs.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _RATE_PLAN_HPP_
+#define _RATE_PLAN_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <numeric>
+#include <algorithm>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "fixq15.hpp"
+#include "complex.hpp"
+#include "cic_decimator.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define kHz                 *1000
+
+/* default rate plan (see --rtl-rate, --if-rate and --audio-rate) */
+#define RTL_SDR_SAMPLE_RATE  (2400 kHz)
+#define IF_SAMPLE_RATE       (240 kHz)
+#define AUDIO_SAMPLE_RATE    (48 kHz)
+
+#if !defined(CIC_ORDER)
+#define CIC_ORDER            (4)
+#endif
+
+/* cic (or channelizer) decimates by rtl rate / (if rate * CIC_FIR_DECIMATION) */
+#define CIC_FIR_DECIMATION   (2)
+#define CIC_FIR_TAPS         (32)
+
+#define IF_FILTER_CUTOFF     (90 kHz)  /* passband up to ~65 kHz, stopband from ~115 kHz */
+#define IF_FILTER_STOPBAND   (115 kHz)
+#define AUDIO_FILTER_TAPS    (160)
+#define AUDIO_FILTER_CUTOFF  (17 kHz)  /* passband up to ~14.5 kHz, pilot (19 kHz) is in the stopband */
+
+/* audio rates the if rate is not a multiple of are reached by the rational resampler */
+#define RESAMPLER_TAPS       (24)       /* per phase */
+#define RESAMPLER_PHASES_MAX (1024)     /* max interpolation factor, L * RESAMPLER_TAPS taps are kept */
+
+/* used instead of the cic when more than one station is received */
+#define CHANNELIZER_CHANNELS (16)       /* bins are rtl rate / 16 (150 kHz by default) apart */
+#define CHANNELIZER_TAPS     (16)       /* per polyphase branch */
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/* sampling rates (Hz) of the chain and factors of the decimators between them */
+struct rate_plan
+{
+    uint32_t rtl_rate;
+    uint32_t if_rate;
+    uint32_t audio_rate;
+    std::size_t cic_decimation;   /* rtl rate to 2 * if rate, of the cic or the channelizer */
+    std::size_t audio_decimation; /* if rate to (about) audio rate */
+    std::size_t resampler_interpolation; /* L and M of the resampler to exactly audio rate, both 1 if there is none */
+    std::size_t resampler_decimation;
+    uint32_t audio_cutoff;        /* of the audio filter, scaled down for audio rates below the default one */
+    uint32_t channelizer_cutoff;  /* covers IF filter passband of a station up to half a bin off center */
+    uint32_t channels_bandwidth;  /* max distance between stations */
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/*
+ * Validates the rates (telling why on stderr) and works out the decimators between them.
+ */
+inline bool make_rate_plan(uint32_t rtl_rate, uint32_t if_rate, uint32_t audio_rate, rate_plan& plan)
+{
+    /* ranges librtlsdr accepts */
+    if (!(((rtl_rate > 225000) && (rtl_rate <= 300000)) || ((rtl_rate > 900000) && (rtl_rate <= 3200000)))) {
+        fprintf(stderr, "RTL rate %u Hz is out of range (225001 - 300000 or 900001 - 3200000)\n", rtl_rate);
+        return false;
+    }
+
+    if (if_rate < 2 * IF_FILTER_CUTOFF) {
+        fprintf(stderr, "IF rate %u Hz is below %d Hz (the if filter passband)\n", if_rate, 2 * IF_FILTER_CUTOFF);
+        return false;
+    }
+
+    if ((rtl_rate % (if_rate * CIC_FIR_DECIMATION)) != 0) {
+        fprintf(stderr, "RTL rate %u Hz must be a multiple of %u Hz (%d times the if rate)\n",
+            rtl_rate, if_rate * CIC_FIR_DECIMATION, CIC_FIR_DECIMATION);
+        return false;
+    }
+
+    const std::size_t cic_decimation = rtl_rate / (if_rate * CIC_FIR_DECIMATION);
+
+    if (!cic_decimator<complex<fixq15_16>, CIC_ORDER>::is_valid(cic_decimation)) {
+        fprintf(stderr, "CIC (order %d) cannot decimate by %zu\n", CIC_ORDER, cic_decimation);
+        return false;
+    }
+
+    if (audio_rate > if_rate) {
+        fprintf(stderr, "Audio rate %u Hz is above the if rate %u Hz\n", audio_rate, if_rate);
+        return false;
+    }
+
+    /* audio filter decimates down to the lowest rate not below the audio rate, the resampler does the rest */
+    const std::size_t audio_decimation = if_rate / audio_rate;
+    const uint64_t divisor = std::gcd(static_cast<uint64_t>(audio_rate) * audio_decimation, static_cast<uint64_t>(if_rate));
+    const std::size_t interpolation = static_cast<std::size_t>(static_cast<uint64_t>(audio_rate) * audio_decimation / divisor);
+    const std::size_t decimation = static_cast<std::size_t>(if_rate / divisor);
+
+    if (interpolation > RESAMPLER_PHASES_MAX) {
+        fprintf(stderr, "Audio rate %u Hz needs %zu/%zu resampling, more than %d phases\n",
+            audio_rate, interpolation, decimation, RESAMPLER_PHASES_MAX);
+        return false;
+    }
+
+    plan.rtl_rate = rtl_rate;
+    plan.if_rate = if_rate;
+    plan.audio_rate = audio_rate;
+    plan.cic_decimation = cic_decimation;
+    plan.audio_decimation = audio_decimation;
+    plan.resampler_interpolation = interpolation;
+    plan.resampler_decimation = decimation;
+    plan.audio_cutoff = std::min<uint32_t>(AUDIO_FILTER_CUTOFF,
+        static_cast<uint32_t>(static_cast<uint64_t>(audio_rate) * AUDIO_FILTER_CUTOFF / AUDIO_SAMPLE_RATE));
+    plan.channelizer_cutoff = IF_FILTER_STOPBAND + rtl_rate / (2 * CHANNELIZER_CHANNELS);
+    plan.channels_bandwidth = (rtl_rate > 2 * plan.channelizer_cutoff) ? (rtl_rate - 2 * plan.channelizer_cutoff) : 0;
+
+    return true;
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _RATE_PLAN_HPP_ */
@@ -0,0 +1,252 @@
+/**
+ * @file rational_resampler.hpp
+ *
+ * Fixed point rational (L/M) polyphase resampler.
+ * Conceptually the input is upsampled by L (zeros inserted), low pass filtered
+ * at L times the input rate and then decimated by M. Only the outputs which
+ * are kept are computed, each out of N input samples with one of the L
+ * phases of the prototype filter (L * N Q15 taps, every phase with the unity DC gain).
+ * Samples of C channels may be interleaved, the history and the phase
+ * are carried between consecutive blocks, so blocks of any length can be processed.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _RATIONAL_RESAMPLER_HPP_
+#define _RATIONAL_RESAMPLER_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <vector>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cmath>
+#include <cassert>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "fixq15.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/**
+ * @param N number of taps per phase
+ */
+template<std::size_t N>
+class rational_resampler
+{
+    static_assert(N > 1, "phases must have at least 2 taps");
+
+public:
+    static constexpr std::size_t taps = N;
+
+    /**
+     * Designs a windowed (Hamming) sinc prototype low pass filter.
+     *
+     * @param[in] interpolation L (greater than 0).
+     * @param[in] decimation M (greater than 0), L/M shall be reduced (otherwise more phases are designed than needed).
+     * @param[in] channels C, number of interleaved channels.
+     * @param[in] cutoff -6dB frequency normalized to the input sample rate (0, 0.5),
+     *                   e.g. half of the lower of both rates.
+     */
+    explicit rational_resampler(std::size_t interpolation, std::size_t decimation, std::size_t channels, double cutoff) :
+        m_interpolation{interpolation},
+        m_decimation{decimation},
+        m_channels{channels},
+        m_taps(interpolation * N),
+        m_work((N - 1) * channels),
+        m_index{0},
+        m_phase{0}
+    {
+        assert((interpolation > 0) && (decimation > 0) && (channels > 0));
+
+        const std::size_t L = interpolation * N;
+        std::vector<double> h(L);
+
+        /* at L times the input rate */
+        cutoff /= interpolation;
+
+        for (std::size_t k = 0; k < L; ++k) {
+            double t = static_cast<double>(k) - (L - 1) / 2.0;
+            double sinc = (t == 0.0) ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+            double window = 0.54 - 0.46 * cos(2.0 * M_PI * k / (L - 1));
+            h[k] = sinc * window;
+        }
+
+        /* phase p is made of taps p, p + L, p + 2L, ..., kept reversed (oldest sample first) */
+        for (std::size_t p = 0; p < interpolation; ++p) {
+            int16_t* phase = m_taps.data() + p * N;
+            double sum = 0.0;
+            long isum = 0;
+            std::size_t center = 0;
+
+            for (std::size_t t = 0; t < N; ++t)
+                sum += h[p + t * interpolation];
+
+            for (std::size_t s = 0; s < N; ++s) {
+                phase[s] = static_cast<int16_t>(lround(h[p + (N - 1 - s) * interpolation] / sum * Q15));
+                isum += phase[s];
+                if (std::abs(phase[s]) > std::abs(phase[center]))
+                    center = s;
+            }
+
+            /* push the rounding error into the largest tap to keep DC gain of each phase exactly 1.0 */
+            phase[center] = static_cast<int16_t>(phase[center] + (Q15 - isum));
+        }
+    }
+
+    std::size_t interpolation() const
+    {
+        return m_interpolation;
+    }
+
+    std::size_t decimation() const
+    {
+        return m_decimation;
+    }
+
+    /**
+     * @return upper bound of samples (of all channels) produced out of n input ones.
+     */
+    std::size_t max_output_size(std::size_t n) const
+    {
+        return ((n / m_channels) * m_interpolation / m_decimation + 2) * m_channels;
+    }
+
+    /**
+     * Sets the state as if all samples up to 'position' (exclusive) were already processed,
+     * so that consecutive blocks can be resampled independently (e.g. by different threads).
+     *
+     * @param[in] history Last N - 1 samples (of each channel) preceding the block.
+     * @param[in] position Index of the first sample (of each channel) of the block within the whole stream.
+     */
+    void resume(const int16_t* history, uint64_t position)
+    {
+        std::copy(history, history + (N - 1) * m_channels, m_work.begin());
+
+        /* first output k, which needs input floor(k * M / L) not older than 'position' */
+        const uint64_t k = (position * m_interpolation + m_decimation - 1) / m_decimation;
+        const uint64_t t = k * m_decimation;
+
+        m_index = static_cast<std::size_t>(t / m_interpolation - position);
+        m_phase = static_cast<std::size_t>(t % m_interpolation);
+    }
+
+    /**
+     * Resamples n input samples (n / C of each channel).
+     * 'out' must have room for max_output_size(n) samples and must not alias 'in'.
+     *
+     * @return number of samples written to 'out'.
+     */
+    std::size_t resample(const int16_t* in, std::size_t n, int16_t* out)
+    {
+        /* mono and stereo get loops of their own */
+        switch (m_channels) {
+            case 1:  return resample_by<1>(in, n, out);
+            case 2:  return resample_by<2>(in, n, out);
+            default: return resample_by<0>(in, n, out);
+        }
+    }
+
+private:
+    /* K is the number of channels if known at compile time, 0 otherwise */
+    template<std::size_t K>
+    std::size_t resample_by(const int16_t* in, std::size_t n, int16_t* out)
+    {
+        const std::size_t C = (K > 0) ? K : m_channels;
+        const std::size_t frames = n / C;
+        std::size_t m = 0;
+
+        /* [last N - 1 input samples | this block] */
+        m_work.resize((N - 1) * C);
+        m_work.insert(m_work.end(), in, in + frames * C);
+
+        while (m_index < frames) {
+            const int16_t* x = m_work.data() + m_index * C; /* oldest of N samples of the output */
+            const int16_t* h = m_taps.data() + m_phase * N;
+
+            for (std::size_t c = 0; c < C; ++c)
+                out[m++] = dot(h, x + c, C);
+
+            m_phase += m_decimation;
+            m_index += m_phase / m_interpolation;
+            m_phase %= m_interpolation;
+        }
+
+        m_index -= frames;
+
+        /* keep last N - 1 samples for the next block */
+        std::copy(m_work.end() - (N - 1) * C, m_work.end(), m_work.begin());
+        m_work.resize((N - 1) * C);
+
+        return m;
+    }
+
+    static int16_t dot(const int16_t* h, const int16_t* x, std::size_t stride)
+    {
+        int32_t acc = 0;
+
+        for (std::size_t s = 0; s < N; ++s)
+            acc += static_cast<int32_t>(h[s]) * x[s * stride];
+
+        return fixq15_16::saturate((acc + (Q15 >> 1)) >> 15);
+    }
+
+    std::size_t m_interpolation; /* L */
+    std::size_t m_decimation;    /* M */
+    std::size_t m_channels;      /* C */
+    std::vector<int16_t> m_taps; /* L phases of N (reversed) taps */
+    std::vector<int16_t> m_work;
+    std::size_t m_index; /* of the newest input sample (within the next block) of the next output */
+    std::size_t m_phase; /* of the next output */
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _RATIONAL_RESAMPLER_HPP_ */
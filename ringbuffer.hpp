@@ -42,18 +42,18 @@
 namespace ymn
 {
 
-template<typename T>
-class ringbuffer : public iringbuffer<T>, public oringbuffer<T>
+template<typename T, typename I = ringbuffer_index_modulo>
+class ringbuffer : public iringbuffer<T, I>, public oringbuffer<T, I>
 {
 public:
     typedef T value_type;
 
     explicit ringbuffer(std::size_t capacity, std::bitset<RINGBUFFER_NONBLOCKING_FLAGS_MAX> flags) :
-        ringbuffer_base<T>::ringbuffer_base{capacity, flags}
+        ringbuffer_base<T, I>::ringbuffer_base{capacity, flags}
     {
 #if defined(DEBUG_RINGBUFFER)
         std::cout << __PRETTY_FUNCTION__ << std::endl;
-        std::cout << ringbuffer_base<T>::to_string() << std::endl;
+        std::cout << ringbuffer_base<T, I>::to_string() << std::endl;
 #endif
     }
 
@@ -63,6 +63,22 @@ public:
         std::cout << __PRETTY_FUNCTION__ << std::endl;
 #endif
     }
+
+    /**
+     * Releases all elements still in the buffer and clears cancellation of both sides
+     * (counters are kept), so that it can be used again after it has been cancelled.
+     * Shall be called while neither side uses the buffer.
+     */
+    void clear()
+    {
+        T element;
+
+        ringbuffer_base<T, I>::cancel(ringbuffer_role::CONSUMER);
+        while (iringbuffer<T, I>::read(std::move(element)) == 1)
+            element = T{};
+
+        ringbuffer_base<T, I>::resume(ringbuffer_role::NONE);
+    }
 };
 
 } /* end of namespace ymn */
@@ -27,6 +27,7 @@
 #include <sstream>
 #include <functional>
 #include <bitset>
+#include <algorithm>
 
 #include <cassert>
 #include <cstring>
@@ -44,6 +45,7 @@
  * project header files
 \*===========================================================================*/
 #include "utilities.hpp"
+#include "power_of_two.hpp"
 #include "binary_semaphore.hpp"
 
 /*===========================================================================*\
@@ -51,7 +53,8 @@
 \*===========================================================================*/
 #define RINGBUFFER_NONBLOCKING_WRITE_SHIFT  0
 #define RINGBUFFER_NONBLOCKING_READ_SHIFT   1
-#define RINGBUFFER_NONBLOCKING_FLAGS_MAX    2
+#define RINGBUFFER_OVERWRITE_SHIFT          2 /* non blocking writer drops the oldest elements to make room */
+#define RINGBUFFER_NONBLOCKING_FLAGS_MAX    3
 
 #define RINGBUFFER_RD_BLOCKING_WR_BLOCKING \
     std::bitset<RINGBUFFER_NONBLOCKING_FLAGS_MAX>{ \
@@ -73,6 +76,11 @@
         1U << RINGBUFFER_NONBLOCKING_READ_SHIFT | 1U << RINGBUFFER_NONBLOCKING_WRITE_SHIFT \
     }
 
+#define RINGBUFFER_RD_BLOCKING_WR_OVERWRITE \
+    std::bitset<RINGBUFFER_NONBLOCKING_FLAGS_MAX>{ \
+        0U << RINGBUFFER_NONBLOCKING_READ_SHIFT | 1U << RINGBUFFER_NONBLOCKING_WRITE_SHIFT | 1U << RINGBUFFER_OVERWRITE_SHIFT \
+    }
+
 /*===========================================================================*\
  * global type definitions
 \*===========================================================================*/
@@ -123,7 +131,32 @@ struct ringbuffer_functor
     std::function<bool(T*)> m_function;
 };
 
-template<typename T>
+/**
+ * Index policies map monotonic produced/consumed counters onto buffer slots.
+ * ringbuffer_index_mask requires a power of two capacity,
+ * but avoids division on every read and write.
+ */
+struct ringbuffer_index_modulo
+{
+    static constexpr bool requires_power_of_two = false;
+
+    static std::size_t index(std::size_t counter, std::size_t capacity)
+    {
+        return counter % capacity;
+    }
+};
+
+struct ringbuffer_index_mask
+{
+    static constexpr bool requires_power_of_two = true;
+
+    static std::size_t index(std::size_t counter, std::size_t capacity)
+    {
+        return counter & (capacity - 1);
+    }
+};
+
+template<typename T, typename I = ringbuffer_index_modulo>
 class ringbuffer_base
 {
 protected:
@@ -136,10 +169,13 @@ protected:
         m_writing_semaphore{true},
         m_reading_semaphore{false},
         m_is_writing_cancelled{false},
-        m_is_reading_cancelled{false}
+        m_is_reading_cancelled{false},
+        m_consumer_lock{false}
     {
         assert(capacity > 0);
         assert(capacity < LONG_MAX);
+        assert(!I::requires_power_of_two || is_power_of_two(capacity));
+        assert(!flags.test(RINGBUFFER_OVERWRITE_SHIFT) || flags.test(RINGBUFFER_NONBLOCKING_WRITE_SHIFT));
 
         m_buffer = new T[capacity];
 
@@ -174,10 +210,13 @@ public:
         return m_flags;
     }
 
-    ringbuffer_status get_counters(std::size_t* produced, std::size_t* consumed, std::size_t* dropped) const
+    /* high watermark is the largest number of elements the consumer has found waiting in the buffer */
+    ringbuffer_status get_counters(std::size_t* produced, std::size_t* consumed, std::size_t* dropped,
+                                   std::size_t* high_watermark = nullptr) const
     {
-        std::size_t l_produced = m_counters.m_produced.load(std::memory_order_relaxed);
-        std::size_t l_consumed = m_counters.m_consumed.load(std::memory_order_relaxed);
+        /* consumed first, so that (produced - consumed) can never appear negative */
+        std::size_t l_consumed = m_counters.m_consumed.load(std::memory_order_acquire);
+        std::size_t l_produced = m_counters.m_produced.load(std::memory_order_acquire);
 
         if (l_produced < l_consumed)
             return ringbuffer_status::INTERNAL_ERROR;
@@ -191,20 +230,26 @@ public:
         if (dropped)
             *dropped = m_counters.m_dropped.load(std::memory_order_relaxed);
 
+        if (high_watermark)
+            *high_watermark = m_counters.m_high_watermark.load(std::memory_order_relaxed);
+
         return ringbuffer_status::OK;
     }
 
     void reset(ringbuffer_role role)
     {
         if (role == ringbuffer_role::PRODUCER) {
-            std::size_t consumed = m_counters.m_consumed.load(std::memory_order_relaxed);
-            m_counters.m_produced.store(consumed, std::memory_order_relaxed);
+            std::size_t consumed = m_counters.m_consumed.load(std::memory_order_acquire);
+            m_counters.m_consumed_cache = consumed;
+            m_counters.m_produced.store(consumed, std::memory_order_release);
             m_counters.m_dropped.store(0U, std::memory_order_relaxed);
         }
         else
         if (role == ringbuffer_role::CONSUMER) {
-            std::size_t produced = m_counters.m_produced.load(std::memory_order_relaxed);
-            m_counters.m_consumed.store(produced, std::memory_order_relaxed);
+            std::size_t produced = m_counters.m_produced.load(std::memory_order_acquire);
+            m_counters.m_produced_cache = produced;
+            m_counters.m_consumed.store(produced, std::memory_order_release);
+            m_counters.m_high_watermark.store(0U, std::memory_order_relaxed);
         }
         else {
             m_counters.reset();
@@ -231,6 +276,20 @@ public:
         }
     }
 
+    /* clears a cancellation nobody has observed (yet), so that the buffer may be used again */
+    void resume(ringbuffer_role role)
+    {
+        if (role == ringbuffer_role::PRODUCER)
+            m_is_writing_cancelled = false;
+        else
+        if (role == ringbuffer_role::CONSUMER)
+            m_is_reading_cancelled = false;
+        else {
+            m_is_writing_cancelled = false;
+            m_is_reading_cancelled = false;
+        }
+    }
+
     std::string to_string() const
     {
         std::ostringstream stream;
@@ -241,7 +300,8 @@ public:
         stream << std::dec << m_capacity;
         stream << ", ";
         stream << "write policy: ";
-        stream << (m_flags.test(RINGBUFFER_NONBLOCKING_WRITE_SHIFT) ? "non_blocking" : "blocking");
+        stream << (m_flags.test(RINGBUFFER_OVERWRITE_SHIFT) ? "overwrite" :
+                   m_flags.test(RINGBUFFER_NONBLOCKING_WRITE_SHIFT) ? "non_blocking" : "blocking");
         stream << ", ";
         stream << "read policy: ";
         stream << (m_flags.test(RINGBUFFER_NONBLOCKING_READ_SHIFT) ? "non_blocking" : "blocking");
@@ -258,6 +318,11 @@ public:
     }
 
 protected:
+    std::size_t index(std::size_t counter) const
+    {
+        return I::index(counter, m_capacity);
+    }
+
     template<typename U>
     static bool copy(U* dst, const U* src, std::size_t count)
     {
@@ -276,7 +341,16 @@ protected:
         return true;
     }
 
-    struct alignas(CACHELINE_SIZE) counters
+    /**
+     * Producer may only write to elements up to (consumed + capacity) and the consumer
+     * may only read elements up to produced. Each side publishes its own counter with release
+     * (after the elements were transferred) and observes the other side's counter with acquire
+     * (before the elements are transferred), thus the transfer is ordered against the publish
+     * also on weakly ordered cores. Producer's and consumer's data live on separate cache lines
+     * and each side keeps its last observation of the other side's counter, so the other side's
+     * cache line is touched only when the cached value does not allow to proceed.
+     */
+    struct counters
     {
         explicit counters()
         {
@@ -286,8 +360,11 @@ protected:
         void reset()
         {
             m_produced.store(0U, std::memory_order_relaxed);
-            m_consumed.store(0U, std::memory_order_relaxed);
             m_dropped.store(0U, std::memory_order_relaxed);
+            m_consumed_cache = 0U;
+            m_consumed.store(0U, std::memory_order_relaxed);
+            m_produced_cache = 0U;
+            m_high_watermark.store(0U, std::memory_order_relaxed);
         }
 
         std::string to_string() const
@@ -303,6 +380,9 @@ protected:
             stream << ", ";
             stream << "dropped: ";
             stream << std::dec << m_dropped.load(std::memory_order_relaxed);
+            stream << ", ";
+            stream << "high watermark: ";
+            stream << std::dec << m_high_watermark.load(std::memory_order_relaxed);
             stream << "]";
 
             return stream.str();
@@ -313,11 +393,133 @@ protected:
             return to_string();
         }
 
-        std::atomic<std::size_t> m_produced;
-        std::atomic<std::size_t> m_consumed;
+        /* producer's cache line */
+        alignas(CACHELINE_SIZE) std::atomic<std::size_t> m_produced;
         std::atomic<std::size_t> m_dropped;
+        std::size_t m_consumed_cache;
+
+        /* consumer's cache line */
+        alignas(CACHELINE_SIZE) std::atomic<std::size_t> m_consumed;
+        std::size_t m_produced_cache;
+        std::atomic<std::size_t> m_high_watermark; /* written by the consumer only */
     };
 
+    /**
+     * Producer side: number of free elements, it observes consumer's counter
+     * only if the cached one does not give room for 'count' elements.
+     */
+    ringbuffer_status free_elements(std::size_t count, std::size_t* produced, std::size_t* free)
+    {
+        std::size_t l_produced = m_counters.m_produced.load(std::memory_order_relaxed);
+        std::size_t l_free = m_capacity - (l_produced - m_counters.m_consumed_cache);
+
+        if (l_free < count) {
+            m_counters.m_consumed_cache = m_counters.m_consumed.load(std::memory_order_acquire);
+            if ((l_produced - m_counters.m_consumed_cache) > m_capacity) /* LONG_MAX is the max capacity */
+                return ringbuffer_status::INTERNAL_ERROR;
+            l_free = m_capacity - (l_produced - m_counters.m_consumed_cache);
+        }
+
+        *produced = l_produced;
+        *free = l_free;
+
+        return ringbuffer_status::OK;
+    }
+
+    /**
+     * Consumer side: number of available elements, it observes producer's counter
+     * only if the cached one does not give 'count' elements.
+     */
+    ringbuffer_status available_elements(std::size_t count, std::size_t* consumed, std::size_t* available)
+    {
+        std::size_t l_consumed = m_counters.m_consumed.load(std::memory_order_relaxed);
+        std::size_t l_available = m_counters.m_produced_cache - l_consumed;
+
+        /* a producer dropping the oldest elements may have moved the counter past the cached one */
+        if ((l_available < count) || (l_available > m_capacity)) {
+            m_counters.m_produced_cache = m_counters.m_produced.load(std::memory_order_acquire);
+            if ((m_counters.m_produced_cache - l_consumed) > m_capacity) /* LONG_MAX is the max capacity */
+                return ringbuffer_status::INTERNAL_ERROR;
+            l_available = m_counters.m_produced_cache - l_consumed;
+        }
+
+        *consumed = l_consumed;
+        *available = l_available;
+
+        return ringbuffer_status::OK;
+    }
+
+    /**
+     * With RINGBUFFER_OVERWRITE_SHIFT the producer releases the oldest elements itself,
+     * so it becomes a second consumer: both take this (spin) lock for as long as they
+     * move the consumer's counter (only a few elements are transferred meanwhile).
+     * It is never held while waiting and it is not taken at all by other buffers.
+     */
+    class consumer_guard
+    {
+    public:
+        explicit consumer_guard(ringbuffer_base& rb) :
+            m_rb{rb},
+            m_locked{false}
+        {
+        }
+
+        ~consumer_guard()
+        {
+            unlock();
+        }
+
+        consumer_guard(const consumer_guard&) = delete;
+        consumer_guard& operator = (const consumer_guard&) = delete;
+
+        void lock()
+        {
+            if (m_rb.m_flags.test(RINGBUFFER_OVERWRITE_SHIFT)) {
+                while (m_rb.m_consumer_lock.exchange(true, std::memory_order_acquire));
+                m_locked = true;
+            }
+        }
+
+        void unlock()
+        {
+            if (m_locked) {
+                m_rb.m_consumer_lock.store(false, std::memory_order_release);
+                m_locked = false;
+            }
+        }
+
+    private:
+        ringbuffer_base& m_rb;
+        bool m_locked;
+    };
+
+    /**
+     * Producer side (RINGBUFFER_OVERWRITE_SHIFT only): releases as many of the oldest elements
+     * as needed for 'count' elements to fit (they are counted as dropped).
+     *
+     * @return number of free elements afterwards.
+     */
+    std::size_t drop_oldest(std::size_t count, std::size_t produced)
+    {
+        consumer_guard guard{*this};
+
+        guard.lock();
+
+        const std::size_t consumed = m_counters.m_consumed.load(std::memory_order_acquire);
+        const std::size_t used = produced - consumed;
+        const std::size_t needed = std::min(count, m_capacity);
+        const std::size_t drop = (m_capacity - used < needed) ? (needed - (m_capacity - used)) : 0;
+
+        for (std::size_t n = 0; n < drop; ++n)
+            m_buffer[index(consumed + n)] = T{};
+
+        m_counters.m_consumed.store(consumed + drop, std::memory_order_release);
+        m_counters.m_consumed_cache = consumed + drop;
+        m_counters.m_dropped.fetch_add(drop, std::memory_order_relaxed);
+
+        return m_capacity - (used - drop);
+    }
+
     std::size_t m_capacity;
     std::bitset<RINGBUFFER_NONBLOCKING_FLAGS_MAX> m_flags;
     counters m_counters;
@@ -326,6 +528,7 @@ protected:
     binary_semaphore m_reading_semaphore;
     std::atomic<bool> m_is_writing_cancelled;
     std::atomic<bool> m_is_reading_cancelled;
+    std::atomic<bool> m_consumer_lock;
 };
 
 } /* end of namespace ymn */
@@ -0,0 +1,933 @@
+/**
+ * @file rtl-sdr-fm-bench.cpp
+ *
+ * Micro benchmarks (and stress tests) of rtl-sdr-fm building blocks.
+ * It does not need any rtlsdr device (nor the library).
+ * I use
+ *    rtl-sdr-fm-bench [-n <iterations>] [<benchmark> ...]
+ * to check that a change does not make things slower (or broken),
+ * exit status tells whether all of them passed their checks (ctest runs pipeline-drain, pipeline-overflow and fm-demod).
+ * DSP kernels process 'iterations' samples (in blocks of a usb transfer)
+ * and are reported in samples per second and, where there is a time stamp counter,
+ * in (reference, i.e. not scaled with the actual core clock) cycles per sample.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "strtointeger.hpp"
+#include "ringbuffer.hpp"
+#include "static_pipeline.hpp"
+#include "cpu_features.hpp"
+#include "fixq15.hpp"
+#include "complex.hpp"
+#include "discriminator.hpp"
+#include "fm_demod.hpp"
+#include "iq_convert.hpp"
+#include "cic_decimator.hpp"
+#include "fir_decimator.hpp"
+#include "channelizer.hpp"
+#include "stereo_decoder.hpp"
+#include "rational_resampler.hpp"
+#include "rate_plan.hpp"
+
+#if defined(CPU_FEATURES_X86)
+#include <x86intrin.h>
+#endif
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define DEFAULT_ITERATIONS    (10 * 1000 * 1000)
+#define RINGBUFFER_CAPACITY   (1024)
+#define RINGBUFFER_BATCH      (16)
+#define KERNEL_BLOCK          (16 * 1024)  /* iq samples of a default usb transfer */
+#define PIPELINE_QUEUE_CAPACITY (4)          /* small, so that the queues are full when a run ends */
+#define PIPELINE_WORKERS      (3)
+#define PIPELINE_RUN_ELEMENTS (256)          /* at most (about) that many per run */
+#define PIPELINE_RUN_ITERATIONS (10000)      /* each element passes several threads, so a run takes that many iterations */
+
+#define CHANNELIZER_SELECTED  (4)
+#define RESAMPLED_AUDIO_RATE  (44100)      /* 48 kHz to 44.1 kHz, 147/160 */
+#define FRONT_END_FIR_TAPS    (160)        /* single stage fir with the transition band of cic + fir at 2.4 MS/s */
+
+/* decimation factors without loops of their own */
+#define CIC_DECIMATION_GENERIC (6)
+#define FIR_DECIMATION_GENERIC (3)
+
+/*===========================================================================*\
+ * local type definitions
+\*===========================================================================*/
+using iq_t = ymn::complex<ymn::fixq15_16>;
+
+struct benchmark
+{
+    const char* name;
+    const char* description;
+    bool (*function)(std::size_t iterations);
+};
+
+/*===========================================================================*\
+ * global object definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local function declarations
+\*===========================================================================*/
+static void print_usage(const char* progname);
+static bool bench_ringbuffer_spsc_nonblocking(std::size_t iterations);
+static bool bench_ringbuffer_spsc_blocking(std::size_t iterations);
+static bool bench_ringbuffer_spsc_batch(std::size_t iterations);
+static bool bench_pipeline_drain(std::size_t iterations);
+static bool bench_pipeline_overflow(std::size_t iterations);
+static bool bench_iq_convert(std::size_t iterations);
+static bool bench_fm_demod(std::size_t iterations);
+static bool bench_cic_decimator(std::size_t iterations);
+static bool bench_fir_decimator_iq(std::size_t iterations);
+static bool bench_if_front_end(std::size_t iterations);
+static bool bench_fir_decimator_pcm(std::size_t iterations);
+static bool bench_stereo_decoder(std::size_t iterations);
+static bool bench_rational_resampler(std::size_t iterations);
+static bool bench_channelizer(std::size_t iterations);
+static bool bench_complex_multiply(std::size_t iterations);
+
+/*===========================================================================*\
+ * local object definitions
+\*===========================================================================*/
+static const benchmark benchmarks[] = {
+    {"ringbuffer-spsc-nonblocking", "lock-free path, both sides spin (yield) when full/empty", bench_ringbuffer_spsc_nonblocking},
+    {"ringbuffer-spsc-blocking",    "both sides sleep on the semaphores when full/empty",      bench_ringbuffer_spsc_blocking},
+    {"ringbuffer-spsc-batch",       "as above, but up to 16 elements are moved per call",      bench_ringbuffer_spsc_batch},
+    {"pipeline-drain",              "runs of one pipeline, drained, ended or paused, lose nothing queued", bench_pipeline_drain},
+    {"pipeline-overflow",           "full queues drop the newest or the oldest element, or block", bench_pipeline_overflow},
+    {"iq-convert",                  "u8 to iq conversion (with the -fs/4 shift), all isas",    bench_iq_convert},
+    {"fm-demod",                    "all discriminators, all isas, checked at full scale",     bench_fm_demod},
+    {"cic-decimator",               "iq, of the default rate plan and a generic decimation", bench_cic_decimator},
+    {"fir-decimator-iq",            "iq, if filter and a generic decimation",                 bench_fir_decimator_iq},
+    {"if-front-end",                "rtl to if rate by cic + fir (as rtl-sdr-fm) and by a single fir", bench_if_front_end},
+    {"fir-decimator-pcm",           "pcm, audio filter and a generic decimation",             bench_fir_decimator_pcm},
+    {"stereo-decoder",              "pilot pll, difference filter, matrix and de-emphasis",    bench_stereo_decoder},
+    {"rational-resampler",          "pcm, if rate of the default rate plan to 44.1 kHz",       bench_rational_resampler},
+    {"channelizer",                 "filter bank of the default rate plan, 4 channels selected", bench_channelizer},
+    {"complex-multiply",            "fixq15 complex multiplication",                           bench_complex_multiply},
+};
+
+/*===========================================================================*\
+ * inline function definitions
+\*===========================================================================*/
+static inline double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* 0 if there is no time stamp counter */
+static inline uint64_t cycles_now()
+{
+#if defined(CPU_FEATURES_X86)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/* makes the compiler assume that all memory is read (and written), so that results are not optimized out */
+static inline void clobber_memory()
+{
+    asm volatile("" : : : "memory");
+}
+
+/*
+ * Hides the value from the optimizer. Otherwise constant block sizes get propagated into the kernels,
+ * which (besides of not being what is measured) makes gcc warn about their tail loops.
+ */
+template<typename T>
+static inline T opaque(T value)
+{
+    asm volatile("" : "+r"(value));
+    return value;
+}
+
+static void print_rate(const char* unit, std::size_t count, double elapsed, uint64_t cycles)
+{
+    fprintf(stdout, "%zu %s in %.3f s, %.2f M %s/s", count, unit, elapsed, count / elapsed / 1e6, unit);
+    if (cycles > 0)
+        fprintf(stdout, ", %.2f cycles/%.*s", static_cast<double>(cycles) / count,
+            static_cast<int>(strlen(unit) - 1), unit);
+}
+
+/**
+ * Calls 'f', which processes 'block' samples, until at least 'iterations' samples are processed.
+ * First call is not measured (it warms up caches and faults in the pages).
+ */
+template<typename F>
+static void kernel(const char* variant, std::size_t iterations, std::size_t block, F&& f)
+{
+    const std::size_t calls = std::max<std::size_t>(1, (iterations + block - 1) / block);
+
+    f();
+    clobber_memory();
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t cycles = cycles_now();
+
+    for (std::size_t i = 0; i < calls; ++i) {
+        f();
+        clobber_memory();
+    }
+
+    cycles = cycles_now() - cycles;
+    double elapsed = seconds_since(start);
+
+    fprintf(stdout, "  %-18s: ", variant);
+    print_rate("samples", calls * block, elapsed, cycles);
+    fprintf(stdout, "\n");
+}
+
+/* deterministic (so that runs are comparable) noise like u8 samples, as delivered by a dongle */
+static std::vector<uint8_t> make_u8_samples(std::size_t n)
+{
+    std::vector<uint8_t> samples(2 * n);
+    uint32_t state = 12345;
+
+    for (uint8_t& sample : samples) {
+        state = state * 1103515245 + 12345;
+        sample = static_cast<uint8_t>(state >> 24);
+    }
+
+    return samples;
+}
+
+static std::vector<iq_t> make_iq_samples(std::size_t n)
+{
+    std::vector<uint8_t> u8 = make_u8_samples(n);
+    std::vector<iq_t> iq(n);
+    std::size_t phase = 0;
+
+    ymn::iq_convert_lut(iq.data(), u8.data(), opaque(n), phase);
+
+    return iq;
+}
+
+/* every pair of full scale (and around zero) samples, the first sample follows the zero one the kernels start with */
+static std::vector<iq_t> make_iq_corners()
+{
+    static const int16_t values[] = {INT16_MIN, -INT16_MAX, -Q15 / 2, -1, 0, 1, Q15 / 2, INT16_MAX};
+    std::vector<iq_t> samples;
+
+    for (int16_t br : values)
+        for (int16_t bi : values)
+            for (int16_t ar : values)
+                for (int16_t ai : values) {
+                    samples.push_back(iq_t{br, bi});
+                    samples.push_back(iq_t{ar, ai});
+                }
+
+    return samples;
+}
+
+/* plan rtl-sdr-fm runs by default (audio at 'audio_rate'), kernels are measured as configured by it */
+static ymn::rate_plan make_plan(uint32_t audio_rate = AUDIO_SAMPLE_RATE)
+{
+    ymn::rate_plan plan;
+
+    if (!ymn::make_rate_plan(RTL_SDR_SAMPLE_RATE, IF_SAMPLE_RATE, audio_rate, plan))
+        exit(EXIT_FAILURE);
+
+    return plan;
+}
+
+/**
+ * Producer writes consecutive integers, consumer checks that it reads
+ * exactly the same sequence (nothing lost, duplicated, reordered or torn).
+ * Payload is two words (value and its complement) so that a missing
+ * acquire/release pairing shows up as a torn element on weakly ordered cores.
+ * Each read/write call transfers up to 'batch' elements.
+ */
+template<typename RB>
+static bool ringbuffer_spsc(RB& rb, std::size_t iterations, bool spin, std::size_t batch = 1)
+{
+    using element_type = std::pair<std::size_t, std::size_t>;
+
+    std::atomic<std::size_t> errors{0};
+
+    auto start = std::chrono::steady_clock::now();
+    const uint64_t start_cycles = cycles_now();
+
+    std::thread producer([&](){
+        element_type elements[RINGBUFFER_BATCH];
+        for (std::size_t n = 0; n < iterations; ) {
+            std::size_t count = std::min(batch, iterations - n);
+            for (std::size_t i = 0; i < count; ++i)
+                elements[i] = element_type{n + i, ~(n + i)};
+            long status = rb.template write<ymn::ringbuffer_xfer_semantic::COPY>(elements, count);
+            if (status > 0)
+                n += status;
+            else
+            if (spin && (status == static_cast<long>(ymn::ringbuffer_status::WOULD_BLOCK)))
+                std::this_thread::yield();
+            else {
+                errors++;
+                break;
+            }
+        }
+    });
+
+    std::thread consumer([&](){
+        element_type elements[RINGBUFFER_BATCH];
+        for (std::size_t n = 0; n < iterations; ) {
+            long status = rb.template read<ymn::ringbuffer_xfer_semantic::COPY>(elements, batch);
+            if (status > 0) {
+                for (long i = 0; i < status; ++i, ++n) {
+                    const element_type& element = elements[i];
+                    if ((element.first != n) || (element.second != ~n)) {
+                        if (errors++ == 0)
+                            fprintf(stderr, "  expected %zu, got %zu/%zx\n", n, element.first, ~element.second);
+                    }
+                }
+            }
+            else
+            if (spin && (status == static_cast<long>(ymn::ringbuffer_status::WOULD_BLOCK)))
+                std::this_thread::yield();
+            else {
+                errors++;
+                break;
+            }
+        }
+    });
+
+    producer.join();
+    consumer.join();
+
+    double elapsed = seconds_since(start);
+    const uint64_t cycles = cycles_now() - start_cycles;
+
+    fprintf(stdout, "  ");
+    print_rate("elements", iterations, elapsed, cycles);
+    fprintf(stdout, ", errors: %zu\n", errors.load());
+    fprintf(stdout, "  %s\n", rb.to_string().c_str());
+
+    return errors == 0;
+}
+
+/*===========================================================================*\
+ * public function definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    std::size_t iterations = DEFAULT_ITERATIONS;
+    bool status = true;
+
+    static const struct option long_options[] = {
+        {"iterations", required_argument, 0, 'n'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    for (;;) {
+        int c = getopt_long(argc, argv, "n:h", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'n':
+                if (ymn::strtointeger(optarg, iterations) != ymn::strtointeger_conversion_status_e::success) {
+                    fprintf(stderr, "Cannot convert '%s' to integer\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'h':
+                print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+
+            default:
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    for (const benchmark& b : benchmarks) {
+        bool selected = (optind == argc);
+
+        for (int i = optind; i < argc; ++i)
+            if (strcmp(argv[i], b.name) == 0)
+                selected = true;
+
+        if (!selected)
+            continue;
+
+        fprintf(stdout, "%s:\n", b.name);
+        fflush(stdout);
+
+        if (!b.function(iterations)) {
+            fprintf(stdout, "  FAILED\n");
+            status = false;
+        }
+    }
+
+    return status ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*===========================================================================*\
+ * local function definitions
+\*===========================================================================*/
+static void print_usage(const char* progname)
+{
+    fprintf(stderr, "usage: %s [-n <iterations>] [<benchmark> ...]\n", progname);
+    fprintf(stderr, " options:\n");
+    fprintf(stderr, "  -n <iterations> --iterations=<iterations>       : number of iterations (default: %d)\n", DEFAULT_ITERATIONS);
+    fprintf(stderr, " benchmarks (default: all):\n");
+    for (const benchmark& b : benchmarks)
+        fprintf(stderr, "  %-47s : %s\n", b.name, b.description);
+}
+
+static bool bench_ringbuffer_spsc_nonblocking(std::size_t iterations)
+{
+    ymn::ringbuffer<std::pair<std::size_t, std::size_t>, ymn::ringbuffer_index_mask> rb{
+        RINGBUFFER_CAPACITY, RINGBUFFER_RD_NONBLOCKING_WR_NONBLOCKING};
+
+    return ringbuffer_spsc(rb, iterations, true);
+}
+
+static bool bench_ringbuffer_spsc_blocking(std::size_t iterations)
+{
+    ymn::ringbuffer<std::pair<std::size_t, std::size_t>, ymn::ringbuffer_index_mask> rb{
+        RINGBUFFER_CAPACITY, RINGBUFFER_RD_BLOCKING_WR_BLOCKING};
+
+    return ringbuffer_spsc(rb, iterations, false);
+}
+
+static bool bench_ringbuffer_spsc_batch(std::size_t iterations)
+{
+    ymn::ringbuffer<std::pair<std::size_t, std::size_t>, ymn::ringbuffer_index_mask> rb{
+        RINGBUFFER_CAPACITY, RINGBUFFER_RD_BLOCKING_WR_BLOCKING};
+
+    return ringbuffer_spsc(rb, iterations, false, RINGBUFFER_BATCH);
+}
+
+/*
+ * Runs the same pipeline (a producer, an unkeyed and a keyed replicated stage, a consumer)
+ * over and over with blocking queues. A run is either drained while the producer is writing
+ * (as on the first SIGINT), ends with the producer (as the end of a recording), is paused
+ * halfway (the producer shall not be called until it is resumed) or is stopped (as on a second SIGINT).
+ * Every element the producer has queued shall reach the consumer, in order, except in stopped runs,
+ * after which the pipeline shall start again with nothing left behind in its queues.
+ * Runs are of different lengths, in half of them the consumer is slower than the producer
+ * (the queues are full at the end), in the others it is faster (each reader mostly waits
+ * for its queue, which is when the end of the stream may race with the last element).
+ */
+static bool bench_pipeline_drain(std::size_t iterations)
+{
+    using element_type = std::unique_ptr<std::size_t>;
+
+    const std::size_t runs = std::max<std::size_t>(2, iterations / PIPELINE_RUN_ITERATIONS);
+    std::atomic<std::size_t> written{0};
+    std::size_t limit = 0; /* of elements the producer ends the stream after, 0 when the run is drained or stopped */
+    bool slow = false;     /* consumer */
+    std::size_t received = 0;
+    std::size_t elements = 0;
+    std::size_t errors = 0;
+    ymn::static_pipeline_base* paused = nullptr; /* pipeline the producer pauses halfway through a paused run */
+    std::atomic<bool> held{false};
+
+    auto producer = [&](ymn::stage_output<element_type>* orb){
+        const std::size_t n = written.load(std::memory_order_relaxed);
+
+        if ((limit > 0) && (n == limit))
+            return false;
+
+        /* the next call shall not come before resume() */
+        if ((paused != nullptr) && (n == limit / 2)) {
+            paused->pause();
+            paused = nullptr;
+            held.store(true, std::memory_order_release);
+            return true;
+        }
+
+        /* cancelled by drain(), this element has not been queued */
+        if (orb->write(std::make_unique<std::size_t>(n)) != 1)
+            return false;
+
+        written.store(n + 1, std::memory_order_release);
+        return true;
+    };
+
+    auto forward = [](std::size_t, element_type&& element){
+        return std::move(element);
+    };
+
+    auto consumer = [&](ymn::stage_input<element_type>* irb){
+        element_type element;
+
+        if (irb->read(std::move(element)) != 1)
+            return false;
+
+        if ((*element != received) && (errors++ == 0))
+            fprintf(stderr, "  expected %zu, got %zu\n", received, *element);
+
+        received++;
+
+        if (slow)
+            std::this_thread::yield();
+
+        return true;
+    };
+
+    auto pipeline = ymn::make_static_pipeline(PIPELINE_QUEUE_CAPACITY,
+        {ymn::overflow_policy::BLOCK, ymn::overflow_policy::BLOCK, ymn::overflow_policy::BLOCK},
+        producer,
+        ymn::replicate(PIPELINE_WORKERS, forward),
+        ymn::replicate(PIPELINE_WORKERS, forward, [](const element_type& element){ return *element; }),
+        consumer);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t run = 0; run < runs; ++run) {
+        enum {DRAINED, ENDED, PAUSED, STOPPED} kind = static_cast<decltype(kind)>(run % 4);
+        static const char* const kinds[] = {"drained", "ended", "paused", "stopped"};
+        const std::size_t length = 1 + (run * 7919) % PIPELINE_RUN_ELEMENTS;
+
+        written = 0;
+        received = 0;
+        limit = ((kind == ENDED) || (kind == PAUSED)) ? length : 0;
+        slow = (run / 4) % 2;
+        paused = (kind == PAUSED) ? pipeline.get() : nullptr;
+
+        pipeline->start();
+
+        if (kind == PAUSED) {
+            while (!held.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+            if ((written.load(std::memory_order_acquire) != length / 2) && (errors++ == 0))
+                fprintf(stderr, "  run %zu (paused): producer went on to %zu\n", run, written.load());
+
+            held = false;
+            pipeline->resume();
+        }
+
+        if ((kind == DRAINED) || (kind == STOPPED)) {
+            while (written.load(std::memory_order_acquire) < length)
+                std::this_thread::yield();
+            if (kind == DRAINED)
+                pipeline->drain();
+            else
+                pipeline->stop();
+        }
+
+        pipeline->join();
+
+        /* elements still queued when the pipeline is stopped are lost, the next run shall not see them */
+        if ((kind != STOPPED) && (received != written) && (errors++ == 0))
+            fprintf(stderr, "  run %zu (%s): %zu elements queued, %zu received\n",
+                run, kinds[kind], written.load(), received);
+
+        elements += received;
+    }
+
+    double elapsed = seconds_since(start);
+
+    fprintf(stdout, "  %zu runs, ", runs);
+    print_rate("elements", elements, elapsed, 0);
+    fprintf(stdout, ", errors: %zu\n", errors);
+
+    return errors == 0;
+}
+
+/*
+ * Lets the producer write (without waiting) three times as many elements as the queue takes
+ * before the consumer reads any of them: with drop-newest only the first elements shall reach
+ * the consumer, with drop-oldest only the last ones. With block the consumer does not wait
+ * (the producer would wait for it forever) and shall get all of them.
+ */
+static bool bench_pipeline_overflow(std::size_t iterations)
+{
+    static const ymn::overflow_policy policies[] = {
+        ymn::overflow_policy::DROP_NEWEST, ymn::overflow_policy::DROP_OLDEST, ymn::overflow_policy::BLOCK};
+
+    using element_type = std::unique_ptr<std::size_t>;
+
+    const std::size_t runs = std::max<std::size_t>(1, iterations / PIPELINE_RUN_ITERATIONS);
+    const std::size_t length = 3 * PIPELINE_QUEUE_CAPACITY;
+    std::atomic<bool> produced{false};
+    bool gated = false; /* consumer waits until the producer has written all elements */
+    std::size_t written = 0;
+    std::vector<std::size_t> received;
+    std::size_t errors = 0;
+
+    auto producer = [&](ymn::stage_output<element_type>* orb){
+        if (written == length) {
+            produced.store(true, std::memory_order_release);
+            return false;
+        }
+
+        /* element which does not fit is released by a failed write (drop-newest) */
+        orb->write(std::make_unique<std::size_t>(written++));
+        return true;
+    };
+
+    auto consumer = [&](ymn::stage_input<element_type>* irb){
+        element_type element;
+
+        while (gated && !produced.load(std::memory_order_acquire))
+            std::this_thread::yield();
+
+        if (irb->read(std::move(element)) != 1)
+            return false;
+
+        received.push_back(*element);
+        return true;
+    };
+
+    for (ymn::overflow_policy policy : policies) {
+        auto pipeline = ymn::make_static_pipeline(PIPELINE_QUEUE_CAPACITY, {policy}, producer, consumer);
+        const std::size_t capacity = pipeline->queue_capacity();
+
+        /* elements the consumer shall get, in order */
+        const std::size_t first = (policy == ymn::overflow_policy::DROP_OLDEST) ? (length - capacity) : 0;
+        const std::size_t count = (policy == ymn::overflow_policy::BLOCK) ? length : capacity;
+
+        for (std::size_t run = 0; run < runs; ++run) {
+            written = 0;
+            received.clear();
+            produced = false;
+            gated = (policy != ymn::overflow_policy::BLOCK);
+
+            pipeline->start();
+            pipeline->join();
+
+            bool expected = (received.size() == count);
+            for (std::size_t n = 0; expected && (n < count); ++n)
+                expected = (received[n] == first + n);
+
+            if (!expected && (errors++ == 0)) {
+                fprintf(stderr, "  %s: expected elements %zu .. %zu, got", ymn::overflow_policy_to_string(policy), first, first + count - 1);
+                for (std::size_t element : received)
+                    fprintf(stderr, " %zu", element);
+                fprintf(stderr, "\n");
+            }
+        }
+
+        fprintf(stdout, "  %-12s: %zu runs, %zu of %zu elements received (%zu .. %zu)\n",
+            ymn::overflow_policy_to_string(policy), runs, count, length, first, first + count - 1);
+    }
+
+    fprintf(stdout, "  errors: %zu\n", errors);
+
+    return errors == 0;
+}
+
+static bool bench_iq_convert(std::size_t iterations)
+{
+    static const ymn::simd_isa isas[] = {ymn::simd_isa::NONE, ymn::simd_isa::SSE41, ymn::simd_isa::AVX2, ymn::simd_isa::NEON};
+
+    const std::vector<uint8_t> in = make_u8_samples(KERNEL_BLOCK);
+    std::vector<iq_t> reference(KERNEL_BLOCK);
+    std::vector<iq_t> out(KERNEL_BLOCK);
+    std::size_t phase = 0;
+    bool status = true;
+
+    ymn::iq_convert_lut(reference.data(), in.data(), opaque<std::size_t>(KERNEL_BLOCK), phase);
+
+    for (ymn::simd_isa isa : isas) {
+        if (!ymn::cpu_supports(isa))
+            continue;
+
+        ymn::iq_convert_kernel convert = ymn::get_iq_convert_kernel(isa);
+
+        /* all variants must be bit exact */
+        phase = 0;
+        convert(out.data(), in.data(), opaque<std::size_t>(KERNEL_BLOCK), phase);
+        if (!std::equal(out.begin(), out.end(), reference.begin())) {
+            fprintf(stdout, "  %-18s: differs from the lookup table kernel\n", ymn::simd_isa_to_string(isa));
+            status = false;
+        }
+
+        kernel(ymn::simd_isa_to_string(isa), iterations, KERNEL_BLOCK, [&](){
+            convert(out.data(), in.data(), opaque<std::size_t>(KERNEL_BLOCK), phase);
+        });
+    }
+
+    return status;
+}
+
+static bool bench_fm_demod(std::size_t iterations)
+{
+    static const ymn::discriminator_type types[] = {
+        ymn::discriminator_type::ATAN2, ymn::discriminator_type::FAST_ATAN2, ymn::discriminator_type::DERIVATIVE};
+    static const ymn::simd_isa isas[] = {ymn::simd_isa::NONE, ymn::simd_isa::SSE41, ymn::simd_isa::AVX2, ymn::simd_isa::NEON};
+
+    const std::vector<iq_t> in = make_iq_samples(KERNEL_BLOCK);
+    const std::vector<iq_t> corners = make_iq_corners();
+    std::vector<int16_t> reference(corners.size());
+    std::vector<int16_t> out(std::max<std::size_t>(KERNEL_BLOCK, corners.size()));
+    iq_t previous{};
+    bool status = true;
+
+    for (ymn::discriminator_type type : types) {
+        std::vector<ymn::fm_demod_kernel> measured;
+
+        previous = iq_t{};
+        ymn::get_fm_demod_kernel(type, ymn::simd_isa::NONE)(reference.data(), corners.data(), corners.size(), previous);
+
+        for (ymn::simd_isa isa : isas) {
+            if (!ymn::cpu_supports(isa))
+                continue;
+
+            /* isas without a variant of their own fall back to the scalar kernel */
+            ymn::fm_demod_kernel demod = ymn::get_fm_demod_kernel(type, isa);
+            if (std::find(measured.begin(), measured.end(), demod) != measured.end())
+                continue;
+            measured.push_back(demod);
+
+            std::string variant = std::string(ymn::discriminator_type_to_string(type)) + "/" + ymn::simd_isa_to_string(isa);
+
+            /*
+             * Simd variants approximate in float, they may differ from the scalar kernel by 2 lsb
+             * (phase, so -pi and pi are 1 lsb apart), but not more. Phases of 0 and pi must be exact.
+             */
+            previous = iq_t{};
+            demod(out.data(), corners.data(), corners.size(), previous);
+            for (std::size_t i = 0; i < corners.size(); ++i) {
+                const iq_t& a = corners[i];
+                const iq_t& b = (i > 0) ? corners[i - 1] : iq_t{};
+                const int64_t ci = static_cast<int64_t>(a.imag().value()) * b.real().value() - static_cast<int64_t>(a.real().value()) * b.imag().value();
+                const int difference = abs(static_cast<int16_t>(out[i] - reference[i]));
+
+                if ((difference > 2) || ((ci == 0) && (difference != 0))) {
+                    fprintf(stdout, "  %-18s: %d at (%d, %d) after (%d, %d), the scalar kernel gives %d\n", variant.c_str(), out[i],
+                        a.real().value(), a.imag().value(), b.real().value(), b.imag().value(), reference[i]);
+                    status = false;
+                    break;
+                }
+            }
+
+            kernel(variant.c_str(), iterations, KERNEL_BLOCK, [&](){
+                demod(out.data(), in.data(), opaque<std::size_t>(KERNEL_BLOCK), previous);
+            });
+        }
+    }
+
+    return status;
+}
+
+static bool bench_cic_decimator(std::size_t iterations)
+{
+    using cic_type = ymn::cic_decimator<iq_t, CIC_ORDER>;
+
+    const ymn::rate_plan plan = make_plan();
+    const std::vector<iq_t> in = make_iq_samples(KERNEL_BLOCK);
+
+    /* factor of the default rate plan and one taking the generic loop */
+    for (std::size_t decimation : {plan.cic_decimation, std::size_t{CIC_DECIMATION_GENERIC}}) {
+        cic_type cic{decimation};
+        std::vector<iq_t> out(cic.max_output_size(KERNEL_BLOCK));
+
+        std::string variant = "cic/" + std::to_string(decimation);
+        kernel(variant.c_str(), iterations, KERNEL_BLOCK, [&](){
+            cic.decimate(in.data(), opaque<std::size_t>(KERNEL_BLOCK), out.data());
+        });
+    }
+
+    return true;
+}
+
+static bool bench_fir_decimator_iq(std::size_t iterations)
+{
+    using fir_type = ymn::fir_decimator<iq_t, CIC_FIR_TAPS>;
+
+    const ymn::rate_plan plan = make_plan();
+    const std::vector<iq_t> in = make_iq_samples(KERNEL_BLOCK);
+
+    /* at the cic output rate */
+    const double cutoff = IF_FILTER_CUTOFF / (2.0 * plan.if_rate);
+
+    for (std::size_t decimation : {std::size_t{CIC_FIR_DECIMATION}, std::size_t{FIR_DECIMATION_GENERIC}}) {
+        fir_type fir{decimation, cutoff};
+        std::vector<iq_t> out(fir.max_output_size(KERNEL_BLOCK));
+
+        std::string variant = "fir/" + std::to_string(decimation);
+        kernel(variant.c_str(), iterations, KERNEL_BLOCK, [&](){
+            fir.decimate(in.data(), opaque<std::size_t>(KERNEL_BLOCK), out.data());
+        });
+    }
+
+    return true;
+}
+
+/* per input (rtl rate) sample, so both chains are directly comparable */
+static bool bench_if_front_end(std::size_t iterations)
+{
+    using cic_type = ymn::cic_decimator<iq_t, CIC_ORDER>;
+    using compensator_type = ymn::fir_decimator<iq_t, CIC_FIR_TAPS>;
+    using fir_type = ymn::fir_decimator<iq_t, FRONT_END_FIR_TAPS>;
+
+    const ymn::rate_plan plan = make_plan();
+    const std::vector<iq_t> in = make_iq_samples(KERNEL_BLOCK);
+    const std::size_t decimation = plan.cic_decimation * CIC_FIR_DECIMATION;
+
+    cic_type cic{plan.cic_decimation};
+    int16_t compensator_taps[CIC_FIR_TAPS];
+    cic.design_compensator(compensator_taps, IF_FILTER_CUTOFF / (2.0 * plan.if_rate));
+    compensator_type compensator{CIC_FIR_DECIMATION, compensator_taps};
+    std::vector<iq_t> cic_out(cic.max_output_size(KERNEL_BLOCK));
+    std::vector<iq_t> out(compensator.max_output_size(cic_out.size()));
+
+    std::string variant = "cic+fir/" + std::to_string(decimation);
+    kernel(variant.c_str(), iterations, KERNEL_BLOCK, [&](){
+        std::size_t m = cic.decimate(in.data(), opaque<std::size_t>(KERNEL_BLOCK), cic_out.data());
+        compensator.decimate(cic_out.data(), m, out.data());
+    });
+
+    fir_type fir{decimation, static_cast<double>(IF_FILTER_CUTOFF) / plan.rtl_rate};
+
+    variant = "fir/" + std::to_string(decimation);
+    kernel(variant.c_str(), iterations, KERNEL_BLOCK, [&](){
+        fir.decimate(in.data(), opaque<std::size_t>(KERNEL_BLOCK), out.data());
+    });
+
+    return true;
+}
+
+static bool bench_fir_decimator_pcm(std::size_t iterations)
+{
+    using fir_type = ymn::fir_decimator<int16_t, AUDIO_FILTER_TAPS>;
+
+    const ymn::rate_plan plan = make_plan();
+    const std::vector<iq_t> iq = make_iq_samples(KERNEL_BLOCK);
+    std::vector<int16_t> in(KERNEL_BLOCK);
+
+    for (std::size_t i = 0; i < KERNEL_BLOCK; ++i)
+        in[i] = iq[i].real().value();
+
+    for (std::size_t decimation : {plan.audio_decimation, std::size_t{FIR_DECIMATION_GENERIC}}) {
+        fir_type fir{decimation, static_cast<double>(plan.audio_cutoff) / plan.if_rate};
+        std::vector<int16_t> out(fir.max_output_size(KERNEL_BLOCK));
+
+        std::string variant = "fir/" + std::to_string(decimation);
+        kernel(variant.c_str(), iterations, KERNEL_BLOCK, [&](){
+            fir.decimate(in.data(), opaque<std::size_t>(KERNEL_BLOCK), out.data());
+        });
+    }
+
+    return true;
+}
+
+static bool bench_stereo_decoder(std::size_t iterations)
+{
+    using fir_type = ymn::fir_decimator<int16_t, AUDIO_FILTER_TAPS>;
+    using decoder_type = ymn::stereo_decoder<fir_type>;
+
+    const ymn::rate_plan plan = make_plan();
+    const std::vector<iq_t> iq = make_iq_samples(KERNEL_BLOCK);
+    std::vector<int16_t> mpx(KERNEL_BLOCK);
+    const fir_type fir{plan.audio_decimation, static_cast<double>(plan.audio_cutoff) / plan.if_rate};
+    decoder_type decoder{fir, static_cast<double>(plan.if_rate), 50e-6};
+    std::vector<int16_t> sum(fir.max_output_size(KERNEL_BLOCK));
+    std::vector<int16_t> out(decoder.max_output_size(KERNEL_BLOCK));
+
+    /* sum signal comes from the audio filter, see fir-decimator-pcm */
+    for (std::size_t i = 0; i < KERNEL_BLOCK; ++i)
+        mpx[i] = iq[i].real().value();
+
+    /* consecutive blocks of the stream, the sum filter would yield that many outputs out of each */
+    uint64_t position = 0;
+
+    kernel("stereo", iterations, KERNEL_BLOCK, [&](){
+        const std::size_t n = opaque<std::size_t>(KERNEL_BLOCK);
+        const std::size_t m = (position + n) / plan.audio_decimation - position / plan.audio_decimation;
+        decoder.decode(mpx.data(), n, position, sum.data(), m, out.data());
+        position += n;
+    });
+
+    return true;
+}
+
+static bool bench_rational_resampler(std::size_t iterations)
+{
+    using resampler_type = ymn::rational_resampler<RESAMPLER_TAPS>;
+
+    const ymn::rate_plan plan = make_plan(RESAMPLED_AUDIO_RATE);
+    const double filter_rate = static_cast<double>(plan.if_rate) / plan.audio_decimation;
+    const std::vector<iq_t> iq = make_iq_samples(KERNEL_BLOCK);
+    std::vector<int16_t> in(KERNEL_BLOCK);
+    resampler_type resampler{plan.resampler_interpolation, plan.resampler_decimation, 1,
+        std::min<double>(filter_rate, plan.audio_rate) / 2 / filter_rate};
+    std::vector<int16_t> out(resampler.max_output_size(KERNEL_BLOCK));
+
+    for (std::size_t i = 0; i < KERNEL_BLOCK; ++i)
+        in[i] = iq[i].real().value();
+
+    kernel("resampler", iterations, KERNEL_BLOCK, [&](){
+        resampler.resample(in.data(), opaque<std::size_t>(KERNEL_BLOCK), out.data());
+    });
+
+    return true;
+}
+
+static bool bench_channelizer(std::size_t iterations)
+{
+    using channelizer_type = ymn::channelizer<CHANNELIZER_CHANNELS, CHANNELIZER_TAPS>;
+
+    const ymn::rate_plan plan = make_plan();
+    const std::vector<iq_t> in = make_iq_samples(KERNEL_BLOCK);
+    channelizer_type channelizer{std::min<std::size_t>(plan.cic_decimation, CHANNELIZER_CHANNELS),
+        static_cast<double>(plan.channelizer_cutoff) / plan.rtl_rate};
+    std::vector<std::vector<iq_t>> out(CHANNELIZER_SELECTED, std::vector<iq_t>(channelizer.max_output_size(KERNEL_BLOCK)));
+    iq_t* outputs[CHANNELIZER_SELECTED];
+
+    for (std::size_t c = 0; c < CHANNELIZER_SELECTED; ++c) {
+        channelizer.add_channel(0.1 * c - 0.15);
+        outputs[c] = out[c].data();
+    }
+
+    kernel("channelizer", iterations, KERNEL_BLOCK, [&](){
+        channelizer.channelize(in.data(), opaque<std::size_t>(KERNEL_BLOCK), outputs);
+    });
+
+    return true;
+}
+
+static bool bench_complex_multiply(std::size_t iterations)
+{
+    const std::vector<iq_t> a = make_iq_samples(KERNEL_BLOCK);
+    const std::vector<iq_t> b = make_iq_samples(KERNEL_BLOCK + 1);
+    std::vector<iq_t> out(KERNEL_BLOCK);
+
+    kernel("multiply", iterations, KERNEL_BLOCK, [&](){
+        const std::size_t n = opaque<std::size_t>(KERNEL_BLOCK);
+        for (std::size_t i = 0; i < n; ++i)
+            out[i] = a[i] * b[i + 1];
+    });
+
+    return true;
+}
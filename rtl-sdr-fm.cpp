@@ -4,13 +4,16 @@
  * RTL SDR FM receiver heavily based on rtl_fm.c from rtlsdr lib.
  * It uses a little bit of C++ plus complex calculus.
  * In fact it is very customized.
- * It outputs only 1 channel (mono) pcm samples (16 bits wide (LE)) at 48kHz.
+ * It outputs 1 channel (mono) pcm samples (16 bits wide (LE)) at 48kHz (see --audio-rate),
+ * or 2 interleaved ones (left, right) with --stereo.
  * I use
  *    rtl-sdr-fm -f XXX | aplay -r 48000 -f S16_LE -t raw -c 1
  * to listen to my fm stations.
- *
- * TODO:
- * - get rid of floating points operations
+ * When several frequencies are given (all within the dongle bandwidth)
+ * the capture is split by a polyphase channelizer and each station is written
+ * to its own <filename>.<frequency> file.
+ * Several devices (-d, each receiving its own station) can be captured
+ * by one process as well, their blocks share the if and fm workers.
  *
  * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
  *
@@ -31,11 +34,23 @@
 #include <string.h>
 #include <getopt.h>
 #include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 #include <math.h>
 
 #include <vector>
+#include <array>
+#include <memory>
+#include <string>
+#include <algorithm>
 #include <chrono>
 #include <thread>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <numeric>
 
 #include <rtl-sdr.h>
 
@@ -46,58 +61,144 @@
 #include "power_of_two.hpp"
 #include "fixq15.hpp"
 #include "complex.hpp"
-#include "pipeline.hpp"
+#include "discriminator.hpp"
+#include "cpu_features.hpp"
+#include "fm_demod.hpp"
+#include "iq_convert.hpp"
+#include "fir_decimator.hpp"
+#include "cic_decimator.hpp"
+#include "channelizer.hpp"
+#include "stereo_decoder.hpp"
+#include "squelch.hpp"
+#include "rational_resampler.hpp"
+#include "static_pipeline.hpp"
+#include "pipeline_metrics.hpp"
+#include "pcm_sink.hpp"
+#include "net_output.hpp"
+#include "thread_policy.hpp"
+#include "iq_reader.hpp"
+#include "iq_recorder.hpp"
+#include "gain_control.hpp"
+#include "rate_plan.hpp"
 #include "ringbuffer.hpp"
 
 /*===========================================================================*\
  * preprocessor #define constants and macros
 \*===========================================================================*/
-#define kHz                 *1000
-
-#define IQBUF_SIZE           (16 * 1024 * 2)
+#define IQBUF_SIZE           (16 * 1024 * 2)  /* default transfer size */
+#define ASYNC_TRANSFERS      (15)
 #define IDLE_LOOPS_NUM       (1)
-#define AUDIO_SAMPLE_RATE    (48 kHz)
-#define OVERSAMPLING_1       (4)
-#define IF_SAMPLE_RATE       (AUDIO_SAMPLE_RATE * OVERSAMPLING_1)
-#define OVERSAMPLING_2       (6)
-#define RTL_SDR_SAMPLE_RATE  (IF_SAMPLE_RATE * OVERSAMPLING_2)
+#define QUEUE_CAPACITY       (42) /* rounded up to the power of two by the pipeline */
+#define STAGE_BATCH          (8)  /* max number of buffers a stage takes from (and passes to) a queue at once */
+#define FM_WORKERS           (1)  /* threads demodulating consecutive blocks in parallel */
+#define PIPELINE_STAGES      (4)  /* producer, if, fm and consumer */
+#define PIPELINE_QUEUES      (PIPELINE_STAGES - 1) /* each named after the stage reading it */
+
+/* --low-latency */
+#define LOW_LATENCY_BUDGET   (20)         /* ms a block may wait since its capture (default) */
+#define LOW_LATENCY_TRANSFER (4 * 1024)   /* bytes, ~0.85 ms at 2.4 MS/s */
+
+/* --record */
+#define RECORD_SECONDS       (60)  /* default length allocated for the recording */
+#define RECORDER_BUFFERING   (500) /* ms the recording may fall behind the capture before it drops */
+
+/* --net */
+#define NET_MULTICAST_TTL    (1)   /* hops of multicast datagrams (default), 1 keeps them within the local network */
+
+/* --agc */
+#define AGC_INTERVAL         (100)   /* ms between decisions of the control thread */
+#define AGC_INITIAL_GAIN     (297)   /* tenths of dB, the nearest gain of the tuner is taken */
+#define AGC_CLIPPED          (1e-3)  /* fraction of clipped samples the gain is lowered at */
+#define AGC_HEADROOM         (6.0)   /* dB below the full scale the peak shall stay after the gain is raised */
+
+#define CAPTURE_RESTARTS     (3)     /* restarts of a capture failing again within a second of the previous one */
+
+/* rates, the cic and the filters between them are in rate_plan.hpp */
+#define DEEMPHASIS           (50)      /* us, of the stereo output (75 in the Americas) */
+#define SQUELCH_HYSTERESIS   (3)       /* dB below --squelch the squelch closes at */
+
+#if !defined(FM_DISCRIMINATOR)
+#define FM_DISCRIMINATOR     FAST_ATAN2 /* ATAN2, FAST_ATAN2 or DERIVATIVE */
+#endif
 
 /*===========================================================================*\
  * local type definitions
 \*===========================================================================*/
 template<typename T>
-struct buffer : public ymn::pipeline::buffer
+struct buffer : public ymn::pooled_buffer
 {
     explicit buffer() :
-        ymn::pipeline::buffer{},
-        vector()
+        ymn::pooled_buffer{},
+        vector(),
+        timestamp{},
+        stream{0}
     {
     }
 
     explicit buffer(std::size_t size) :
-        ymn::pipeline::buffer{},
-        vector(size)
+        ymn::pooled_buffer{},
+        vector(size),
+        timestamp{},
+        stream{0}
     {
     }
 
     std::vector<T> vector;
+    ymn::metrics_clock::time_point timestamp; /* when the samples (or those they were made of) were captured */
+    std::size_t stream; /* index of the device the samples came from */
 };
 
-using iq_t = ymn::complex<ymn::fixq15>;
-using iq_buffer_uptr = std::unique_ptr<buffer<iq_t>>;
+enum class capture_mode
+{
+    SYNC,   /* rtlsdr_read_sync(), one transfer in flight */
+    ASYNC,  /* rtlsdr_read_async(), several transfers queued by libusb */
+    REPLAY, /* raw u8 recording read from a file or stdin, no device */
+};
 
-iq_buffer_uptr to_iq_buffer_uptr(ymn::pipeline::buffer_uptr&& p)
+/* one vector of samples per received station */
+template<typename T>
+struct channels_buffer : public ymn::pooled_buffer
 {
-    return iq_buffer_uptr{static_cast<buffer<iq_t>*>(p.release())};
-}
+    explicit channels_buffer(std::size_t count, std::size_t size) :
+        ymn::pooled_buffer{},
+        channels(count, std::vector<T>(size)),
+        timestamp{},
+        stream{0}
+    {
+    }
 
-using pcm_t = int16_t;
-using pcm_buffer_uptr = std::unique_ptr<buffer<pcm_t>>;
+    std::vector<std::vector<T>> channels;
+    ymn::metrics_clock::time_point timestamp; /* when the samples they were made of were captured */
+    std::size_t stream; /* index of the device the samples came from */
+};
+
+using iq_t = ymn::complex<ymn::fixq15_16>;
+using iq_buffer_uptr = ymn::buffer_pool::uptr<buffer<iq_t>>;
 
-pcm_buffer_uptr to_pcm_buffer_uptr(ymn::pipeline::buffer_uptr&& p)
+/*
+ * Intermediate frequency block. Samples of each channel are preceded by the last 'overlap'
+ * samples of the previous block, so that it can be demodulated and filtered
+ * on its own (i.e. by any of the fm workers) yielding exactly the same audio.
+ */
+struct if_buffer : public channels_buffer<iq_t>
 {
-    return pcm_buffer_uptr{static_cast<buffer<pcm_t>*>(p.release())};
-}
+    explicit if_buffer(std::size_t count, std::size_t size) :
+        channels_buffer<iq_t>{count, size},
+        overlap{0},
+        position{0},
+        open(count, true)
+    {
+    }
+
+    std::size_t overlap;
+    uint64_t position; /* index of the first (not overlapping) sample within the stream */
+    std::vector<bool> open; /* squelch of each channel, closed ones are not demodulated */
+};
+
+using if_buffer_uptr = ymn::buffer_pool::uptr<if_buffer>;
+
+using pcm_t = int16_t;
+using pcm_buffer_uptr = ymn::buffer_pool::uptr<channels_buffer<pcm_t>>;
 
 /*===========================================================================*\
  * global object definitions
@@ -107,310 +208,1344 @@ pcm_buffer_uptr to_pcm_buffer_uptr(ymn::pipeline::buffer_uptr&& p)
  * local function declarations
 \*===========================================================================*/
 static void print_usage(const char* progname);
-static void signal_handler(int signum);
-static void install_signal_handler(void);
-static void fm_demod(pcm_t *pcmbuf, iq_t* iqbuf, const std::size_t N);
+static void block_signals(sigset_t* set);
+static void handle_signals(const sigset_t* set, const std::atomic<bool>& finished, uint32_t metrics_interval);
+static void control_gain(const std::atomic<bool>& finished, std::vector<std::unique_ptr<ymn::gain_control>>& controls,
+    const std::vector<const char*>& devices);
 static int verbose_device_search(const char *s);
+static bool open_device(const char* device, uint32_t frequency, uint32_t sample_rate, bool manual_gain);
+static bool read_channels(const char* filename, std::vector<uint32_t>& frequencies);
+static bool read_stage_policies(const char* arg, bool affinity, ymn::thread_policy (&policies)[PIPELINE_STAGES]);
+static bool read_overflow_policies(const char* arg, std::array<ymn::overflow_policy, PIPELINE_QUEUES>& policies,
+    bool (&given)[PIPELINE_QUEUES]);
 
 /*===========================================================================*\
  * local object definitions
 \*===========================================================================*/
-static rtlsdr_dev_t *rtlsdr_device = NULL;
-static uint8_t iqbuf_u8[IQBUF_SIZE];
-static std::unique_ptr<ymn::pipeline> pipeline;
+static std::vector<rtlsdr_dev_t*> rtlsdr_devices;
+static std::atomic<bool> capturing{true}; /* cleared once the capture is to be stopped */
+static std::atomic<bool> capture_failed{false}; /* capture of a device has ended on its own */
+static std::atomic<uint32_t> pauses{0}; /* a capture cancelled by a pause has not failed */
+static std::mutex pipeline_mutex; /* the pipeline is not restarted while a signal pauses or stops it */
+static capture_mode capture = capture_mode::ASYNC;
+static ymn::iq_reader reader;
+static ymn::iq_recorder recorder;
+static std::unique_ptr<ymn::static_pipeline_base> pipeline;
+static const char* const stage_names[PIPELINE_STAGES] = {"producer", "if", "fm", "consumer"};
 
 /*===========================================================================*\
  * inline function definitions
 \*===========================================================================*/
-template<std::size_t N>
-static inline void polar_rotate_90(uint8_t (&data)[N])
+template<typename F>
+static void rtlsdr_async_callback(unsigned char* buf, uint32_t len, void* ctx)
 {
-    /* 90 rotation is 1+0j, 0+1j, -1+0j, 0-1j or [0, 1, -3, 2, -4, -5, 7, -6] */
-    static_assert((N % 8) == 0, "N must be multiple of 8");
+    (*static_cast<F*>(ctx))(buf, len);
+}
 
-    uint8_t tmp;
+/*===========================================================================*\
+ * public function definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    uint32_t frequency = 0;
+    std::vector<uint32_t> frequencies;
+    std::vector<const char*> devices;
+    std::vector<int> fds;
+    ymn::pcm_sink_config sink_config{0, {}, false, ymn::pcm_sink_method::WRITEV, 0, 0};
+    const char* net = nullptr;
+    ymn::net_address net_address;
+    int net_ttl = NET_MULTICAST_TTL;
+    const char* input = nullptr;
+    bool fast = false;
+    ymn::discriminator_type discriminator = ymn::discriminator_type::FM_DISCRIMINATOR;
+    ymn::simd_isa simd = ymn::detect_simd_isa();
+    uint32_t transfers = ASYNC_TRANSFERS;
+    uint32_t transfer_size = 0; /* IQBUF_SIZE, LOW_LATENCY_TRANSFER with --low-latency */
+    uint32_t fm_workers = 0; /* FM_WORKERS for one device, one per core for several */
+
+    sigset_t signals;
+    uint32_t metrics_interval = 0;
+    ymn::thread_policy thread_policies[PIPELINE_STAGES];
+    bool lock = false;
+    bool stereo = false;
+    uint32_t deemphasis = DEEMPHASIS;
+    uint32_t rtl_rate = RTL_SDR_SAMPLE_RATE;
+    uint32_t if_rate = IF_SAMPLE_RATE;
+    uint32_t audio_rate = AUDIO_SAMPLE_RATE;
+    ymn::rate_plan plan;
+    uint32_t latency_budget = 0; /* ms, 0 unless --low-latency */
+    const char* record = nullptr;
+    uint32_t record_seconds = RECORD_SECONDS;
+    uint32_t pretrigger = 0; /* seconds */
+    bool squelched = false;
+    int32_t squelch_level = 0; /* dBFS */
+    bool squelch_silence = true;
+    bool agc = false;
+    std::array<ymn::overflow_policy, PIPELINE_QUEUES> overflow{};
+    bool overflow_given[PIPELINE_QUEUES] = {};
+
+    /* before any thread is created, so that all of them inherit the mask */
+    block_signals(&signals);
 
-    for (std::size_t n = 0; n < N; n += 8) {
-        tmp = ~data[n + 3];
-        data[n + 3] = data[n + 2];
-        data[n + 2] = tmp;
+    static const struct option long_options[] = {
+        {"frequency", required_argument, 0, 'f'},
+        {"device", required_argument, 0, 'd'},
+        {"channels", required_argument, 0, 'F'},
+        {"discriminator", required_argument, 0, 'D'},
+        {"simd", required_argument, 0, 'S'},
+        {"capture", required_argument, 0, 'C'},
+        {"transfers", required_argument, 0, 'T'},
+        {"transfer-size", required_argument, 0, 'B'},
+        {"fm-workers", required_argument, 0, 'W'},
+        {"input", required_argument, 0, 'i'},
+        {"fast", no_argument, 0, 'X'},
+        {"metrics", required_argument, 0, 'M'},
+        {"flush-bytes", required_argument, 0, 'Y'},
+        {"flush-ms", required_argument, 0, 'Z'},
+        {"flush-each-block", no_argument, 0, 'E'},
+        {"vmsplice", no_argument, 0, 'V'},
+        {"pin", required_argument, 0, 'P'},
+        {"sched", required_argument, 0, 'R'},
+        {"mlock", no_argument, 0, 'L'},
+        {"stereo", no_argument, 0, 'O'},
+        {"deemphasis", required_argument, 0, 'H'},
+        {"rtl-rate", required_argument, 0, 'r'},
+        {"if-rate", required_argument, 0, 'I'},
+        {"audio-rate", required_argument, 0, 'A'},
+        {"low-latency", optional_argument, 0, 'G'},
+        {"record", required_argument, 0, 'K'},
+        {"record-seconds", required_argument, 0, 'J'},
+        {"pretrigger", required_argument, 0, 'N'},
+        {"squelch", required_argument, 0, 'Q'},
+        {"squelch-mode", required_argument, 0, 'U'},
+        {"net", required_argument, 0, 'u'},
+        {"net-ttl", required_argument, 0, 't'},
+        {"agc", no_argument, 0, 'g'},
+        {"overflow", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
 
-        data[n + 4] = ~data[n + 4];
-        data[n + 5] = ~data[n + 5];
+    for (;;) {
+        int c = getopt_long(argc, argv, "f:d:F:D:i:", long_options, 0);
+        if (c == -1)
+            break;
 
-        tmp = ~data[n + 6];
-        data[n + 6] = data[n + 7];
-        data[n + 7] = tmp;
-    }
-}
+        switch (c) {
+            case 'f':
+                if (ymn::strtointeger(optarg, frequency) != ymn::strtointeger_conversion_status_e::success) {
+                    fprintf(stderr, "Cannot convert '%s' to integer\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                frequencies.push_back(frequency);
+                break;
 
-static inline pcm_t polar_discriminator(iq_t a, iq_t b)
-{
-    iq_t c = a * b.conj();
-    double angle = atan2(c.imag().value(), c.real().value());
-    return static_cast<pcm_t>((angle / M_PI) * Q15);
-}
+            case 'd':
+                devices.push_back(optarg);
+                break;
 
-static inline iq_buffer_uptr get_iq_buffer_uptr(ymn::iringbuffer<ymn::pipeline::buffer_uptr>* irb)
-{
-    ymn::pipeline::buffer_uptr buf_uptr;
+            case 'F':
+                if (!read_channels(optarg, frequencies))
+                    exit(EXIT_FAILURE);
+                break;
 
-    long read_status = irb->read(std::move(buf_uptr));
-    if (read_status != 1)
-        return nullptr;
+            case 'D':
+                if (!ymn::discriminator_type_from_string(optarg, discriminator)) {
+                    fprintf(stderr, "Unknown discriminator '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
 
-    return to_iq_buffer_uptr(std::move(buf_uptr));
-}
+            case 'S':
+                if (!ymn::simd_isa_from_string(optarg, simd) || !ymn::cpu_supports(simd)) {
+                    fprintf(stderr, "Instruction set '%s' is not supported\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
 
-static inline pcm_buffer_uptr get_pcm_buffer_uptr(ymn::iringbuffer<ymn::pipeline::buffer_uptr>* irb)
-{
-    ymn::pipeline::buffer_uptr buf_uptr;
+            case 'C':
+                if (strcmp(optarg, "sync") == 0)
+                    capture = capture_mode::SYNC;
+                else
+                if (strcmp(optarg, "async") == 0)
+                    capture = capture_mode::ASYNC;
+                else {
+                    fprintf(stderr, "Unknown capture mode '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
 
-    long read_status = irb->read(std::move(buf_uptr));
-    if (read_status != 1)
-        return nullptr;
+            case 'T':
+                if ((ymn::strtointeger(optarg, transfers) != ymn::strtointeger_conversion_status_e::success) ||
+                    (transfers == 0)) {
+                    fprintf(stderr, "Invalid number of transfers '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
 
-    return to_pcm_buffer_uptr(std::move(buf_uptr));
-}
+            case 'B':
+                /* librtlsdr requires multiple of 512 bytes */
+                if ((ymn::strtointeger(optarg, transfer_size) != ymn::strtointeger_conversion_status_e::success) ||
+                    (transfer_size == 0) || ((transfer_size % 512) != 0)) {
+                    fprintf(stderr, "Transfer size '%s' must be a non zero multiple of 512\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
 
-static void low_pass_filter(std::vector<iq_t>& samples, const std::size_t decimation)
-{
-    std::size_t n = 0;
-    std::size_t i = 0;
-    iq_t sum{0, 0};
+            case 'W':
+                if ((ymn::strtointeger(optarg, fm_workers) != ymn::strtointeger_conversion_status_e::success) ||
+                    (fm_workers == 0)) {
+                    fprintf(stderr, "Invalid number of fm workers '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
 
-    const std::size_t N = samples.size();
-    iq_t* buf = samples.data();
+            case 'i':
+                input = optarg;
+                capture = capture_mode::REPLAY;
+                break;
 
-    while (n < N) {
-        sum += buf[n];
-        if ((++n % decimation) == 0) {
-            buf[i++] = sum;
-            sum = iq_t{0, 0};
-        }
-    }
+            case 'X':
+                fast = true;
+                break;
 
-    samples.resize(N / decimation);
-}
+            case 'M':
+                if (ymn::strtointeger(optarg, metrics_interval) != ymn::strtointeger_conversion_status_e::success) {
+                    fprintf(stderr, "Invalid metrics interval '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
 
-static void low_pass_filter(std::vector<pcm_t>& samples, const std::size_t decimation)
-{
-    std::size_t n = 0;
-    std::size_t i = 0;
-    long sum = 0;
+            case 'Y':
+                if (ymn::strtointeger(optarg, sink_config.flush_bytes) != ymn::strtointeger_conversion_status_e::success) {
+                    fprintf(stderr, "Invalid number of bytes '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
 
-    const std::size_t N = samples.size();
-    pcm_t* buf = samples.data();
+            case 'Z': {
+                uint32_t ms;
+                if (ymn::strtointeger(optarg, ms) != ymn::strtointeger_conversion_status_e::success) {
+                    fprintf(stderr, "Invalid number of milliseconds '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                sink_config.flush_time = std::chrono::milliseconds{ms};
+                break;
+            }
 
-    while (n < N) {
-        sum += buf[n];
-        if ((++n % decimation) == 0) {
-            buf[i++] = sum / decimation;
-            sum = 0;
-        }
-    }
+            case 'E':
+                sink_config.flush_each_block = true;
+                break;
 
-    samples.resize(N / decimation);
-}
+            case 'V':
+                sink_config.method = ymn::pcm_sink_method::VMSPLICE;
+                break;
 
-/*===========================================================================*\
- * public function definitions
-\*===========================================================================*/
-int main(int argc, char *argv[])
-{
-    int status;
-    uint32_t frequency = 0;
-    FILE* fp;
-    int dev_index;
+            case 'P':
+            case 'R':
+                if (!read_stage_policies(optarg, c == 'P', thread_policies))
+                    exit(EXIT_FAILURE);
+                break;
 
-    install_signal_handler();
+            case 'L':
+                lock = true;
+                break;
 
-    static const struct option long_options[] = {
-        {"frequency", required_argument, 0, 'f'},
-        {0, 0, 0, 0}
-    };
+            case 'O':
+                stereo = true;
+                break;
 
-    for (;;) {
-        int c = getopt_long(argc, argv, "f:", long_options, 0);
-        if (c == -1)
-            break;
+            case 'H':
+                if (ymn::strtointeger(optarg, deemphasis) != ymn::strtointeger_conversion_status_e::success) {
+                    fprintf(stderr, "Invalid de-emphasis '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
 
-        switch (c) {
-            case 'f':
-                if (ymn::strtointeger(optarg, frequency) != ymn::strtointeger_conversion_status_e::success) {
-                    fprintf(stderr, "Cannot convert '%s' to integer\n", optarg);
+            case 'r':
+            case 'I':
+            case 'A': {
+                uint32_t& rate = (c == 'r') ? rtl_rate : ((c == 'I') ? if_rate : audio_rate);
+                if ((ymn::strtointeger(optarg, rate) != ymn::strtointeger_conversion_status_e::success) || (rate == 0)) {
+                    fprintf(stderr, "Invalid sampling rate '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+
+            case 'G':
+                latency_budget = LOW_LATENCY_BUDGET;
+                if ((optarg != nullptr) &&
+                    ((ymn::strtointeger(optarg, latency_budget) != ymn::strtointeger_conversion_status_e::success) ||
+                     (latency_budget == 0))) {
+                    fprintf(stderr, "Invalid latency budget '%s'\n", optarg);
                     exit(EXIT_FAILURE);
                 }
                 break;
 
+            case 'K':
+                record = optarg;
+                break;
+
+            case 'J':
+            case 'N': {
+                uint32_t& seconds = (c == 'J') ? record_seconds : pretrigger;
+                if ((ymn::strtointeger(optarg, seconds) != ymn::strtointeger_conversion_status_e::success) || (seconds == 0)) {
+                    fprintf(stderr, "Invalid number of seconds '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+
+            case 'Q':
+                if (ymn::strtointeger(optarg, squelch_level) != ymn::strtointeger_conversion_status_e::success) {
+                    fprintf(stderr, "Invalid squelch level '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                squelched = true;
+                break;
+
+            case 'U':
+                if (strcmp(optarg, "silence") == 0)
+                    squelch_silence = true;
+                else
+                if (strcmp(optarg, "skip") == 0)
+                    squelch_silence = false;
+                else {
+                    fprintf(stderr, "Unknown squelch mode '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'u':
+                if (!ymn::net_address_from_string(optarg, net_address)) {
+                    fprintf(stderr, "Invalid address '%s' (udp://<host>:<port> or tcp://<host>:<port> expected)\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                net = optarg;
+                break;
+
+            case 't':
+                if ((ymn::strtointeger(optarg, net_ttl) != ymn::strtointeger_conversion_status_e::success) ||
+                    (net_ttl < 0) || (net_ttl > 255)) {
+                    fprintf(stderr, "Invalid ttl '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'g':
+                agc = true;
+                break;
+
+            case 'o':
+                if (!read_overflow_policies(optarg, overflow, overflow_given))
+                    exit(EXIT_FAILURE);
+                break;
+
             default:
                 /* do nothing */
                 break;
         }
     }
 
-    if (argc > optind) {
-        fp = fopen(argv[optind], "wb");
-        if (fp == NULL) {
-            fprintf(stderr, "Cannot create '%s'\n", argv[optind]);
+    if (fast && (capture != capture_mode::REPLAY)) {
+        fprintf(stderr, "--fast needs an --input recording\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if ((record == nullptr) && (pretrigger > 0)) {
+        fprintf(stderr, "--pretrigger needs a --record file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (fast && (latency_budget > 0)) {
+        fprintf(stderr, "--low-latency drops late blocks, it cannot be combined with --fast\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* a live capture cannot wait (low latency keeps the freshest blocks), a replayed recording can */
+    for (std::size_t q = 0; q < PIPELINE_QUEUES; ++q) {
+        if (!overflow_given[q])
+            overflow[q] = (capture == capture_mode::REPLAY) ? ymn::overflow_policy::BLOCK :
+                (latency_budget > 0) ? ymn::overflow_policy::DROP_OLDEST : ymn::overflow_policy::DROP_NEWEST;
+
+        if (fast && (overflow[q] != ymn::overflow_policy::BLOCK)) {
+            fprintf(stderr, "--fast replays without any loss, queue '%s' needs the block policy\n", stage_names[q + 1]);
             exit(EXIT_FAILURE);
         }
     }
-    else
-        fp = stdout;
 
-    if (frequency == 0) {
+    /* live monitoring: small blocks, each written out as soon as it is demodulated */
+    if (transfer_size == 0)
+        transfer_size = (latency_budget > 0) ? LOW_LATENCY_TRANSFER : IQBUF_SIZE;
+
+    if ((latency_budget > 0) && (sink_config.flush_bytes == 0) && (sink_config.flush_time == ymn::metrics_clock::duration::zero()))
+        sink_config.flush_each_block = true;
+
+    if (frequencies.empty() || (std::find(frequencies.begin(), frequencies.end(), 0) != frequencies.end())) {
         print_usage(argv[0]);
         exit(EXIT_FAILURE);
     }
 
-    dev_index = verbose_device_search("0");
-    if (dev_index < 0)
+    if (!ymn::make_rate_plan(rtl_rate, if_rate, audio_rate, plan))
         exit(EXIT_FAILURE);
 
-    fprintf(stderr, "Opening device #%d\n", dev_index);
-    status = rtlsdr_open(&rtlsdr_device, (uint32_t)dev_index);
-    if (status < 0) {
-        fprintf(stderr, "Failed to open rtlsdr device #%d\n", dev_index);
+    if (devices.empty())
+        devices.push_back("0");
+
+    if ((devices.size() > 1) && (capture == capture_mode::REPLAY)) {
+        fprintf(stderr, "--input replays a single recording, it cannot be combined with several devices\n");
         exit(EXIT_FAILURE);
     }
-    fprintf(stderr, " - done\n");
 
-    fprintf(stderr, "Setting tuner gain to automatic\n");
-    status = rtlsdr_set_tuner_gain_mode(rtlsdr_device, 0);
-    if (status) {
-        fprintf(stderr, "rtlsdr_set_tuner_gain_mode(0) failed\n");
+    if ((record != nullptr) && ((devices.size() > 1) || (capture == capture_mode::REPLAY))) {
+        fprintf(stderr, "--record taps the capture of a single device\n");
         exit(EXIT_FAILURE);
     }
-    fprintf(stderr, " - done\n");
 
-    /* Reset endpoint before we start reading from it (mandatory) */
-    fprintf(stderr, "Resseting rtlsdr buffers\n");
-    status = rtlsdr_reset_buffer(rtlsdr_device);
-    if (status) {
-        fprintf(stderr, "rtlsdr_reset_buffer() failed\n");
+    if (agc && (capture == capture_mode::REPLAY)) {
+        fprintf(stderr, "--agc controls the gain of a device, a recording has none\n");
         exit(EXIT_FAILURE);
     }
-    fprintf(stderr, " - done\n");
 
-    frequency += RTL_SDR_SAMPLE_RATE / 4;
+    /* each device is a stream of its own, with one station (i-th device receives i-th frequency) */
+    const std::size_t n_streams = (capture == capture_mode::REPLAY) ? 1 : devices.size();
 
-    fprintf(stderr, "Setting center frequency to %u Hz\n", frequency);
-    status = rtlsdr_set_center_freq(rtlsdr_device, frequency);
-    if (status) {
-        fprintf(stderr, "rtlsdr_set_center_freq(%u) failed\n", frequency);
+    if ((n_streams > 1) && (frequencies.size() != n_streams)) {
+        fprintf(stderr, "Each of %zu devices needs a frequency of its own\n", n_streams);
         exit(EXIT_FAILURE);
     }
-    fprintf(stderr, " - done\n");
 
-    fprintf(stderr, "Setting sample rate to %u Hz\n", RTL_SDR_SAMPLE_RATE);
-    status = rtlsdr_set_sample_rate(rtlsdr_device, RTL_SDR_SAMPLE_RATE);
-    if (status) {
-        fprintf(stderr, "rtlsdr_set_sample_rate(%u) failed\n", RTL_SDR_SAMPLE_RATE);
+    /* stations received by each stream */
+    const std::size_t n_channels = (n_streams > 1) ? 1 : frequencies.size();
+    const std::size_t n_outputs = n_streams * n_channels;
+
+    if (fm_workers == 0)
+        fm_workers = (n_streams > 1) ? std::max(1U, std::thread::hardware_concurrency()) : FM_WORKERS;
+
+    /* if workers keep the state of their streams, so there is no use for more of them than streams */
+    const uint32_t if_workers = std::min<uint32_t>(fm_workers, n_streams);
+
+    if ((net != nullptr) && (argc > optind)) {
+        fprintf(stderr, "Output goes either to a <filename> or to --net, not to both\n");
         exit(EXIT_FAILURE);
     }
-    fprintf(stderr, " - done\n");
 
-    fprintf(stderr, "Intermediate sampling rate: %d Hz\n", IF_SAMPLE_RATE);
-    fprintf(stderr, "Audio sampling rate: %d Hz\n", AUDIO_SAMPLE_RATE);
+    if ((net != nullptr) && ((net_address.port + frequencies.size()) > 65536)) {
+        fprintf(stderr, "Ports from %u on do not suffice for %zu outputs\n", net_address.port, frequencies.size());
+        exit(EXIT_FAILURE);
+    }
+
+    /* i-th output is either <filename>.<frequency> or (with --net) a socket on i-th port from the given one on */
+    auto open_output = [&](const std::string& filename){
+        int fd;
+
+        if (net != nullptr) {
+            fd = ymn::connect_net_output(net_address, static_cast<uint16_t>(fds.size()), net_ttl);
+            if (fd < 0) {
+                fprintf(stderr, "Cannot connect to '%s' (port %zu) (%s)\n", net, net_address.port + fds.size(), strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+        else {
+            fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                fprintf(stderr, "Cannot create '%s'\n", filename.c_str());
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        fds.push_back(fd);
+    };
+
+    const std::string output_name = (argc > optind) ? argv[optind] : "";
+
+    if (n_streams > 1) {
+        if ((argc <= optind) && (net == nullptr)) {
+            fprintf(stderr, "Several devices need a <filename> (each is written to <filename>.<frequency>) or --net\n");
+            exit(EXIT_FAILURE);
+        }
+
+        frequency = frequencies[0];
+
+        for (uint32_t f : frequencies) {
+            if (std::count(frequencies.begin(), frequencies.end(), f) > 1) {
+                fprintf(stderr, "Devices must receive different stations (%u Hz is given more than once)\n", f);
+                exit(EXIT_FAILURE);
+            }
+
+            open_output(output_name + "." + std::to_string(f));
+        }
+    }
+    else
+    if (n_channels == 1) {
+        frequency = frequencies[0];
+
+        if ((argc > optind) || (net != nullptr))
+            open_output(output_name);
+        else
+            fds.push_back(STDOUT_FILENO);
+    }
+    else {
+        const auto [lowest, highest] = std::minmax_element(frequencies.begin(), frequencies.end());
+
+        if (n_channels > CHANNELIZER_CHANNELS) {
+            fprintf(stderr, "At most %d stations can be received at once (%zu are given)\n", CHANNELIZER_CHANNELS, n_channels);
+            exit(EXIT_FAILURE);
+        }
+
+        if ((*highest - *lowest) > plan.channels_bandwidth) {
+            fprintf(stderr, "Stations must be within %u Hz from each other\n", plan.channels_bandwidth);
+            exit(EXIT_FAILURE);
+        }
+
+        /* channels overlap their neighbours, their outputs must still hold the whole passband */
+        if ((plan.cic_decimation > CHANNELIZER_CHANNELS) || (plan.channelizer_cutoff >= plan.if_rate)) {
+            fprintf(stderr, "Channelizer (cutoff %u Hz, decimation %zu) does not fit the if rate %u Hz, lower the rtl rate\n",
+                plan.channelizer_cutoff, plan.cic_decimation, plan.if_rate);
+            exit(EXIT_FAILURE);
+        }
+
+        if ((argc <= optind) && (net == nullptr)) {
+            fprintf(stderr, "Several stations need a <filename> (each is written to <filename>.<frequency>) or --net\n");
+            exit(EXIT_FAILURE);
+        }
+
+        /* tune to the middle of the stations */
+        frequency = *lowest + (*highest - *lowest) / 2;
+
+        /* each station needs a channel of its own, otherwise two outputs would carry the same one */
+        using channelizer_type = ymn::channelizer<CHANNELIZER_CHANNELS, CHANNELIZER_TAPS>;
+        for (std::size_t i = 0; i < n_channels; ++i)
+            for (std::size_t j = 0; j < i; ++j) {
+                const std::size_t bin = channelizer_type::bin((static_cast<double>(frequencies[i]) - frequency) / plan.rtl_rate);
+                if (bin == channelizer_type::bin((static_cast<double>(frequencies[j]) - frequency) / plan.rtl_rate)) {
+                    fprintf(stderr, "Stations %u Hz and %u Hz fall into the same channel (channels are %u Hz apart)\n",
+                        frequencies[j], frequencies[i], plan.rtl_rate / CHANNELIZER_CHANNELS);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+        for (uint32_t f : frequencies)
+            open_output(output_name + "." + std::to_string(f));
+    }
+
+    frequency += plan.rtl_rate / 4;
+
+    if (capture == capture_mode::REPLAY) {
+        if (!reader.open(input)) {
+            fprintf(stderr, "Cannot open '%s' (%s)\n", input, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+    if (n_streams > 1) {
+        for (std::size_t d = 0; d < n_streams; ++d)
+            if (!open_device(devices[d], frequencies[d] + plan.rtl_rate / 4, plan.rtl_rate, agc))
+                exit(EXIT_FAILURE);
+    }
+    else
+    if (!open_device(devices[0], frequency, plan.rtl_rate, agc))
+        exit(EXIT_FAILURE);
+
+    /* one loop per device, its gain is set here and then only by the control thread */
+    std::vector<std::unique_ptr<ymn::gain_control>> gain_controls;
+    if (agc)
+        for (std::size_t d = 0; d < n_streams; ++d) {
+            int count = rtlsdr_get_tuner_gains(rtlsdr_devices[d], nullptr);
+            if (count <= 0) {
+                fprintf(stderr, "rtlsdr_get_tuner_gains() failed\n");
+                exit(EXIT_FAILURE);
+            }
+
+            std::vector<int> gains(count);
+            rtlsdr_get_tuner_gains(rtlsdr_devices[d], gains.data());
+
+            gain_controls.push_back(std::make_unique<ymn::gain_control>(gains, AGC_INITIAL_GAIN, AGC_CLIPPED, AGC_HEADROOM));
+            if (rtlsdr_set_tuner_gain(rtlsdr_devices[d], gain_controls[d]->gain())) {
+                fprintf(stderr, "rtlsdr_set_tuner_gain(%d) failed\n", gain_controls[d]->gain());
+                exit(EXIT_FAILURE);
+            }
+
+            fprintf(stderr, "Device '%s': software agc, %d gains from %.1f to %.1f dB, starting at %.1f dB\n", devices[d],
+                count, *std::min_element(gains.begin(), gains.end()) / 10.0, *std::max_element(gains.begin(), gains.end()) / 10.0,
+                gain_controls[d]->gain() / 10.0);
+        }
+
+    if (n_streams > 1)
+        for (std::size_t d = 0; d < n_streams; ++d)
+            fprintf(stderr, "Device '%s': %u Hz\n", devices[d], frequencies[d]);
+
+    if (n_channels == 1)
+        fprintf(stderr, "CIC decimator: order %d, decimation %zu\n", CIC_ORDER, plan.cic_decimation);
+    else {
+        fprintf(stderr, "Channelizer: %d channels, %d taps, decimation %zu\n",
+            CHANNELIZER_CHANNELS, CHANNELIZER_CHANNELS * CHANNELIZER_TAPS, plan.cic_decimation);
+        for (uint32_t f : frequencies)
+            fprintf(stderr, " - %u Hz (offset %d Hz)\n", f, static_cast<int>(f) - static_cast<int>(frequency - plan.rtl_rate / 4));
+    }
+    fprintf(stderr, "Intermediate sampling rate: %u Hz\n", plan.if_rate);
+    fprintf(stderr, "Audio sampling rate: %u Hz (decimation %zu, cutoff %u Hz)\n",
+        plan.audio_rate, plan.audio_decimation, plan.audio_cutoff);
+    if (plan.resampler_interpolation != plan.resampler_decimation)
+        fprintf(stderr, "Resampler: %zu/%zu, %d taps per phase\n",
+            plan.resampler_interpolation, plan.resampler_decimation, RESAMPLER_TAPS);
+    if (stereo)
+        fprintf(stderr, "Stereo: left and right interleaved, de-emphasis %u us\n", deemphasis);
+    fprintf(stderr, "FM discriminator: %s (simd: %s)\n",
+        ymn::discriminator_type_to_string(discriminator), ymn::simd_isa_to_string(simd));
+    if (capture == capture_mode::ASYNC)
+        fprintf(stderr, "Capture: async, %u transfers of %u bytes\n", transfers, transfer_size);
+    else
+    if (capture == capture_mode::SYNC)
+        fprintf(stderr, "Capture: sync, %u bytes\n", transfer_size);
+    else
+        fprintf(stderr, "Replay: '%s' (%s, %s), recorded at %u Hz, %u S/s\n", input,
+            reader.is_mapped() ? "mapped" : "streamed", fast ? "fast" : "realtime", frequency, plan.rtl_rate);
+    if (n_streams > 1)
+        fprintf(stderr, "IF workers: %u\n", if_workers);
+    fprintf(stderr, "FM workers: %u\n", fm_workers);
+    if (net != nullptr)
+        fprintf(stderr, "Output: %s%s, framed\n", net, (fds.size() > 1) ? " (i-th station to i-th port from it on)" : "");
+    if (squelched)
+        fprintf(stderr, "Squelch: %d dBFS (closes %d dB below), dead air is %s\n",
+            squelch_level, SQUELCH_HYSTERESIS, squelch_silence ? "silence" : "skipped");
+
+    /*
+     * With --low-latency the queues are sized in time rather than in blocks: they hold (a batch more than)
+     * the blocks captured within the budget, and any block found older than that by a stage is dropped,
+     * so it is always the oldest data which goes once the output falls behind.
+     */
+    const double block_ms = 1000.0 * (transfer_size / 2) / plan.rtl_rate;
+    const std::size_t queue_capacity = (latency_budget > 0) ?
+        static_cast<std::size_t>(ceil(latency_budget / block_ms)) + STAGE_BATCH : QUEUE_CAPACITY;
+    const ymn::metrics_clock::duration budget = std::chrono::milliseconds{latency_budget};
+
+    if (latency_budget > 0)
+        fprintf(stderr, "Low latency: budget %u ms, blocks of %.2f ms\n", latency_budget, block_ms);
+
+    /* with --low-latency, whether a block waited (since its capture) longer than the budget */
+    auto late = [&](ymn::metrics_clock::time_point timestamp){
+        return (latency_budget > 0) && ((ymn::metrics_clock::now() - timestamp) > budget);
+    };
+
+    ymn::iq_convert_kernel iq_convert = ymn::get_iq_convert_kernel(simd);
+
+    ymn::fm_demod_kernel fm_demod = ymn::get_fm_demod_kernel(discriminator, simd);
+
+    /* single station goes through the cic, several through the channelizer, both decimate by plan.cic_decimation */
+    using cic_type = ymn::cic_decimator<iq_t, CIC_ORDER>;
+    const cic_type cic{plan.cic_decimation};
+    ymn::channelizer<CHANNELIZER_CHANNELS, CHANNELIZER_TAPS> channelizer{
+        std::min<std::size_t>(plan.cic_decimation, CHANNELIZER_CHANNELS),
+        static_cast<double>(plan.channelizer_cutoff) / plan.rtl_rate};
+
+    /* cic (and channelizer) output rate */
+    const double cic_rate = 2.0 * plan.if_rate;
+
+    using if_filter_type = ymn::fir_decimator<iq_t, CIC_FIR_TAPS>;
+    std::vector<if_filter_type> if_filters;
+
+    if (n_channels == 1) {
+        int16_t if_filter_taps[CIC_FIR_TAPS];
+        cic.design_compensator(if_filter_taps, IF_FILTER_CUTOFF / cic_rate);
+        if_filters.push_back(if_filter_type{CIC_FIR_DECIMATION, if_filter_taps});
+    }
+    else {
+        /* channelizer passband is flat, no compensation needed */
+        const double tuned = frequency - plan.rtl_rate / 4;
+        for (uint32_t f : frequencies) {
+            channelizer.add_channel((f - tuned) / plan.rtl_rate);
+            if_filters.push_back(if_filter_type{CIC_FIR_DECIMATION, IF_FILTER_CUTOFF / cic_rate});
+        }
+    }
+    using audio_filter_type = ymn::fir_decimator<pcm_t, AUDIO_FILTER_TAPS>;
+    const audio_filter_type audio_filter{plan.audio_decimation, static_cast<double>(plan.audio_cutoff) / plan.if_rate};
+
+    /* audio rate the audio filter outputs unless it is exactly the requested one */
+    const bool resampling = plan.resampler_interpolation != plan.resampler_decimation;
+    const double filter_rate = static_cast<double>(plan.if_rate) / plan.audio_decimation;
+
+    using resampler_type = ymn::rational_resampler<RESAMPLER_TAPS>;
+    const resampler_type resampler{plan.resampler_interpolation, plan.resampler_decimation, stereo ? 2U : 1U,
+        std::min<double>(filter_rate, plan.audio_rate) / 2 / filter_rate};
+
+    /*
+     * Mono block is resampled on its own as well, the audio filter yields first its resampler history
+     * out of that many more mpx samples. Stereo ones are resampled in order (see stereo_resamplers).
+     */
+    const std::size_t resampler_lead = (resampling && !stereo) ? (resampler_type::taps - 1) * plan.audio_decimation : 0;
+
+    /* demodulating and filtering block needs that many preceding samples (previous one plus filter history) */
+    const std::size_t if_overlap = audio_filter_type::taps + resampler_lead;
+
+    /* state of each stream, blocks of a stream are always given to the same if worker */
+    struct if_stream
+    {
+        cic_type cic;
+        std::vector<if_filter_type> if_filters;
+        std::vector<std::vector<iq_t>> if_history;
+        uint64_t if_position;
+        std::vector<ymn::squelch> squelches; /* one for each channel */
+    };
+
+    const ymn::squelch squelch = squelched ? ymn::squelch{static_cast<double>(squelch_level), SQUELCH_HYSTERESIS} : ymn::squelch{};
+
+    std::vector<if_stream> if_streams(n_streams,
+        if_stream{cic, if_filters, std::vector<std::vector<iq_t>>(n_channels, std::vector<iq_t>(if_overlap)), 0,
+            std::vector<ymn::squelch>(n_channels, squelch)});
+
+    /* largest blocks each stage can produce */
+    const std::size_t iq_samples_max = transfer_size / 2;
+    const std::size_t if_samples_max = if_filters[0].max_output_size(
+        std::max(cic.max_output_size(iq_samples_max), channelizer.max_output_size(iq_samples_max)));
+
+    /* channelizer outputs (at the cic rate) */
+    std::vector<std::vector<iq_t>> channel_samples(n_channels > 1 ? n_channels : 0,
+        std::vector<iq_t>(channelizer.max_output_size(iq_samples_max)));
+    std::vector<iq_t*> channel_outputs;
+    for (std::vector<iq_t>& samples : channel_samples)
+        channel_outputs.push_back(samples.data());
+
+    /* interleaved left and right with --stereo */
+    const std::size_t audio_channels = stereo ? 2 : 1;
+    const std::size_t audio_samples_max = audio_channels * audio_filter.max_output_size(resampler_lead + if_samples_max);
+    const std::size_t pcm_samples_max = resampling ? resampler.max_output_size(audio_samples_max) : audio_samples_max;
+
+    /*
+     * Pilot pll of each station carries its state from block to block,
+     * so with --stereo blocks of a stream go always to the same fm worker (see fm_stage).
+     * A block carries all stations of its device, thus they are all decoded by that worker,
+     * only several devices spread over the fm workers.
+     */
+    using stereo_decoder_type = ymn::stereo_decoder<audio_filter_type>;
+    std::vector<stereo_decoder_type> stereo_decoders(stereo ? n_outputs : 0,
+        stereo_decoder_type{audio_filter, static_cast<double>(plan.if_rate), deemphasis * 1e-6});
+
+    /* so do the resamplers of the decoded left and right */
+    std::vector<resampler_type> stereo_resamplers((stereo && resampling) ? n_outputs : 0, resampler);
+    const std::vector<pcm_t> stereo_silence((resampler_type::taps - 1) * 2);
+
+    /* each fm worker has its own scratch buffers, filter and resampler */
+    struct fm_worker
+    {
+        std::vector<pcm_t> mpx_samples;
+        std::vector<pcm_t> sum_samples;   /* --stereo only */
+        std::vector<pcm_t> audio_samples; /* before resampling */
+        audio_filter_type audio_filter;
+        resampler_type resampler;
+    };
+
+    std::vector<fm_worker> fm_workers_state(fm_workers, fm_worker{{}, {}, {}, audio_filter, resampler});
+    for (fm_worker& worker : fm_workers_state)
+        worker.mpx_samples.reserve(if_overlap + if_samples_max);
+
+    /* pools, metrics and the sink are created along with the pipeline (see below) */
+    ymn::buffer_pool* iq_pool = nullptr;
+    ymn::buffer_pool* if_pool = nullptr;
+    ymn::buffer_pool* pcm_pool = nullptr;
+    ymn::stage_metrics* producer_metrics = nullptr;
+    ymn::stage_metrics* if_metrics = nullptr;
+    ymn::stage_metrics* fm_metrics = nullptr;
+    ymn::stage_metrics* consumer_metrics = nullptr;
+    std::unique_ptr<ymn::pcm_sink<pcm_buffer_uptr>> sink;
+    std::vector<ymn::signal_metrics*> signal_metrics(n_outputs, nullptr);
 
     std::this_thread::sleep_for(std::chrono::milliseconds(10));
 
-    auto producer = [&](ymn::iringbuffer<ymn::pipeline::buffer_uptr>* irb, ymn::oringbuffer<ymn::pipeline::buffer_uptr>* orb){
+    /* each device has its own first (untrusted) transfers and phase of the rotation */
+    struct capture_stream
+    {
+        std::size_t counter;
+        std::size_t iq_convert_phase;
+    };
+
+    std::vector<capture_stream> capture_streams(n_streams, capture_stream{0, 0});
+
+    /* several devices are captured concurrently, while the queue takes one writer at a time */
+    std::mutex producer_mutex;
+
+    /* converts one block of samples of a stream, then passes it to the next stage */
+    auto push_block = [&](std::size_t stream, const uint8_t* data, std::size_t len, ymn::stage_output<iq_buffer_uptr>* orb){
+
+        capture_stream& state = capture_streams[stream];
+
+        const ymn::metrics_clock::time_point timestamp = ymn::metrics_clock::now();
+
+        /* first transfers of a device are not trusted, a recording is */
+        if ((capture != capture_mode::REPLAY) && (state.counter++ < IDLE_LOOPS_NUM))
+            return;
+
+        /* a copy of the raw block, dropped (and counted) by the recorder rather than delaying the capture */
+        if (recorder.is_open())
+            recorder.push(data, len);
+
+        iq_buffer_uptr iqbuf_uptr = iq_pool->acquire<buffer<iq_t>>();
+        if (!iqbuf_uptr) {
+            producer_metrics->add_dropped();
+            fprintf(stderr, "%s: iq_pool->acquire() failed\n", __PRETTY_FUNCTION__);
+            fprintf(stderr, "%s\n", iq_pool->to_string().c_str());
+            return;
+        }
+
+        {
+            ymn::stage_metrics::scope busy{*producer_metrics};
+
+            /* rotate by 90 degrees (shift by -fs/4) */
+            /* scale [0, 255] -> [-127, 128] */
+            /* scale [-127, 128] -> [-32512, 32767] (saturated) */
+            /* the gain itself is changed by the control thread, far from here */
+            if (!gain_controls.empty())
+                gain_controls[stream]->count(data, len);
+
+            iqbuf_uptr->vector.resize(len / 2);
+            iq_convert(iqbuf_uptr->vector.data(), data, iqbuf_uptr->vector.size(), state.iq_convert_phase);
+            iqbuf_uptr->timestamp = timestamp;
+            iqbuf_uptr->stream = stream;
+            producer_metrics->add_samples(len / 2);
+        }
+
+        std::lock_guard<std::mutex> lock{producer_mutex};
+
+        long write_status = orb->write(std::move(iqbuf_uptr));
+        if (write_status != 1) {
+            producer_metrics->add_dropped();
+            fprintf(stderr, "%s: orb->write() failed\n", __PRETTY_FUNCTION__);
+            fprintf(stderr, "%s\n", orb->to_string().c_str());
+        }
+    };
+
+    std::vector<std::vector<uint8_t>> iqbufs_u8(n_streams, std::vector<uint8_t>(transfer_size));
+
+    /* reads one transfer of a device */
+    auto read_sync = [&](std::size_t stream, ymn::stage_output<iq_buffer_uptr>* orb){
 
-        assert(irb == nullptr);
         assert(orb != nullptr);
 
+        std::vector<uint8_t>& iqbuf_u8 = iqbufs_u8[stream];
         int status;
         int n_read;
-        static std::size_t counter = 0;
 
-        status = rtlsdr_read_sync(rtlsdr_device, iqbuf_u8, sizeof(iqbuf_u8), &n_read);
+        status = rtlsdr_read_sync(rtlsdr_devices[stream], iqbuf_u8.data(), iqbuf_u8.size(), &n_read);
         if (status) {
-            fprintf(stderr, "rtlsdr_read_sync(%zu) failed\n", sizeof(iqbuf_u8));
+            fprintf(stderr, "rtlsdr_read_sync(%zu) failed\n", iqbuf_u8.size());
             return false;
         }
 
-        if (n_read != sizeof(iqbuf_u8)) {
+        if (n_read != static_cast<int>(iqbuf_u8.size())) {
+            producer_metrics->add_dropped();
             fprintf(stderr, "rtlsdr_read_sync(%zu) dropped samples - received %d\n",
-                sizeof(iqbuf_u8), n_read);
+                iqbuf_u8.size(), n_read);
             return true;
         }
 
-        if (counter++ < IDLE_LOOPS_NUM)
-            return true;
+        push_block(stream, iqbuf_u8.data(), n_read, orb);
 
-        polar_rotate_90(iqbuf_u8);
+        return true;
+    };
 
-        iq_buffer_uptr iqbuf_uptr = std::make_unique<buffer<iq_t>>(n_read / 2);
-        iq_t* iqbuf = iqbuf_uptr->vector.data();
+    /* blocks in rtlsdr_read_async() until rtlsdr_cancel_async() is called */
+    auto read_async = [&](std::size_t stream, ymn::stage_output<iq_buffer_uptr>* orb){
+
+        assert(orb != nullptr);
 
-        /* scale [0, 255] -> [-127, 128] */
-        /* scale [-127, 128] -> [-32512, 32768] */
-        for (std::size_t i = 0; i < iqbuf_uptr->vector.size(); ++i) {
-            iqbuf[i].real((iqbuf_u8[2 * i + 0] - 127) * 256);
-            iqbuf[i].imag((iqbuf_u8[2 * i + 1] - 127) * 256);
+        /* samples are read directly out of the libusb transfer buffer while it is lent to us */
+        auto callback = [&](uint8_t* data, uint32_t len){
+            if (len != transfer_size) {
+                producer_metrics->add_dropped();
+                fprintf(stderr, "rtlsdr_read_async(%u) dropped samples - received %u\n", transfer_size, len);
+                return;
+            }
+            push_block(stream, data, len, orb);
+        };
+
+        int status = rtlsdr_read_async(rtlsdr_devices[stream],
+            rtlsdr_async_callback<decltype(callback)>, &callback, transfers, transfer_size);
+        if (status) {
+            fprintf(stderr, "rtlsdr_read_async(%u, %u) failed\n", transfers, transfer_size);
         }
 
-        long write_status = orb->write(std::move(iqbuf_uptr));
-        if (write_status != 1) {
-            fprintf(stderr, "%s: orb->write() failed\n", __PRETTY_FUNCTION__);
-            fprintf(stderr, "%s\n", orb->to_string().c_str());
+        return false;
+    };
+
+    /*
+     * Captures a device until its capture is stopped, paused (true is returned, the pipeline calls
+     * the producer again once it is resumed) or fails on its own (e.g. a usb hiccup). A device which fails
+     * cancels the capture of the others too, main() then restarts the pipeline (see CAPTURE_RESTARTS).
+     */
+    auto capture_device = [&](std::size_t d, ymn::stage_output<iq_buffer_uptr>* orb){
+
+        const uint32_t paused = pauses;
+
+        if (capture == capture_mode::ASYNC)
+            read_async(d, orb);
+        else
+            while (capturing && !capture_failed && (pauses == paused) && read_sync(d, orb));
+
+        if (capturing && !capture_failed && (pauses == paused)) {
+            fprintf(stderr, "Capture of device '%s' failed\n", devices[d]);
+            capture_failed = true;
+            if (capture == capture_mode::ASYNC)
+                for (rtlsdr_dev_t* device : rtlsdr_devices)
+                    rtlsdr_cancel_async(device);
         }
 
+        if (!capturing || capture_failed) {
+            fprintf(stderr, "Device '%s' stopped\n", devices[d]);
+            return false;
+        }
+
+        /* first transfers after the pause are not trusted either */
+        capture_streams[d].counter = 0;
+
         return true;
     };
 
-    auto fm_stage = [&](ymn::iringbuffer<ymn::pipeline::buffer_uptr>* irb, ymn::oringbuffer<ymn::pipeline::buffer_uptr>* orb){
+    /* capture threads of all devices but the first one (captured by the producer thread itself) */
+    std::vector<std::thread> capture_threads;
+    std::unique_ptr<ymn::semaphore[]> capture_start = std::make_unique<ymn::semaphore[]>(n_streams);
+    ymn::semaphore capture_done{0};
+    ymn::stage_output<iq_buffer_uptr>* capture_orb = nullptr;
+    bool capture_exiting = false; /* published to the capture threads by capture_start */
 
-        assert(irb != nullptr);
-        assert(orb != nullptr);
+    /*
+     * Each device is captured by a thread of its own, created by the producer stage on its first call
+     * (so they share its cpus and scheduling) and parked between its calls (after a pause or a restart).
+     */
+    auto producer_devices = [&](ymn::stage_output<iq_buffer_uptr>* orb){
 
-        iq_buffer_uptr iqbuf_uptr = get_iq_buffer_uptr(irb);
-        if (!iqbuf_uptr)
-            return false;
+        capture_orb = orb;
 
-        low_pass_filter(iqbuf_uptr->vector, OVERSAMPLING_2);
+        if (capture_threads.empty())
+            for (std::size_t d = 1; d < n_streams; ++d)
+                capture_threads.emplace_back([&, d](){
+                    for (;;) {
+                        capture_start[d].wait();
+                        if (capture_exiting)
+                            return;
 
-        pcm_buffer_uptr pcmbuf_uptr = std::make_unique<buffer<pcm_t>>(iqbuf_uptr->vector.size());
+                        capture_device(d, capture_orb);
+                        capture_done.post();
+                    }
+                });
 
-        fm_demod(pcmbuf_uptr->vector.data(), iqbuf_uptr->vector.data(), iqbuf_uptr->vector.size());
+        for (std::size_t d = 1; d < n_streams; ++d)
+            capture_start[d].post();
 
-        low_pass_filter(pcmbuf_uptr->vector, OVERSAMPLING_1);
+        const bool status = capture_device(0, orb);
 
-        long write_status = orb->write(std::move(pcmbuf_uptr));
-        if (write_status != 1) {
-            fprintf(stderr, "%s: orb->write() failed\n", __PRETTY_FUNCTION__);
-            fprintf(stderr, "%s\n", orb->to_string().c_str());
+        for (std::size_t d = 1; d < n_streams; ++d)
+            capture_done.wait();
+
+        return status && !capture_failed;
+    };
+
+    /* keeps the state of the stream of the block, see if_stream */
+    auto if_block = [&](std::size_t, iq_buffer_uptr&& iqbuf_uptr){
+
+        if (late(iqbuf_uptr->timestamp)) {
+            if_metrics->add_dropped();
+            return if_buffer_uptr{};
         }
 
-        return true;
+        if_stream& state = if_streams[iqbuf_uptr->stream];
+        ymn::stage_metrics::scope busy{*if_metrics};
+        std::vector<iq_t>& iq = iqbuf_uptr->vector;
+        std::size_t n;
+
+        if_metrics->add_samples(iq.size());
+
+        if (n_channels == 1) {
+            /* cic decimates in place */
+            n = state.cic.decimate(iq.data(), iq.size(), iq.data());
+        }
+        else
+            n = channelizer.channelize(iq.data(), iq.size(), channel_outputs.data());
+
+        if_buffer_uptr ifbuf_uptr = if_pool->acquire<if_buffer>();
+        if (!ifbuf_uptr) {
+            if_metrics->add_dropped();
+            fprintf(stderr, "%s: if_pool->acquire() failed\n", __PRETTY_FUNCTION__);
+            fprintf(stderr, "%s\n", if_pool->to_string().c_str());
+            return ifbuf_uptr;
+        }
+
+        for (std::size_t c = 0; c < n_channels; ++c) {
+            const iq_t* samples = (n_channels == 1) ? iq.data() : channel_outputs[c];
+            std::vector<iq_t>& ifv = ifbuf_uptr->channels[c];
+            std::vector<iq_t>& history = state.if_history[c];
+            if_filter_type& if_filter = state.if_filters[c];
+
+            /* [last if_overlap samples of the stream so far | new samples] */
+            ifv.resize(if_overlap + if_filter.max_output_size(n));
+            std::copy(history.begin(), history.end(), ifv.begin());
+            ifv.resize(if_overlap + if_filter.decimate(samples, n, ifv.data() + if_overlap));
+            std::copy(ifv.end() - if_overlap, ifv.end(), history.begin());
+
+            /* power of the new samples, while they are still in the cache, drives the squelch */
+            const double level = ymn::block_power(ifv.data() + if_overlap, ifv.size() - if_overlap);
+            ifbuf_uptr->open[c] = state.squelches[c].update(level);
+            signal_metrics[iqbuf_uptr->stream * n_channels + c]->record(level, ifbuf_uptr->open[c]);
+        }
+
+        ifbuf_uptr->overlap = if_overlap;
+        ifbuf_uptr->position = state.if_position;
+        ifbuf_uptr->timestamp = iqbuf_uptr->timestamp;
+        ifbuf_uptr->stream = iqbuf_uptr->stream;
+        state.if_position += ifbuf_uptr->channels[0].size() - if_overlap;
+
+        return ifbuf_uptr;
+    };
+
+    auto if_stage = ymn::replicate(if_workers, if_block,
+        [](const iq_buffer_uptr& iqbuf_uptr){ return iqbuf_uptr->stream; });
+
+    /* number of pcm samples (of all audio channels) out of if samples [position, position + n) of a stream */
+    auto pcm_samples = [&](uint64_t position, std::size_t n){
+        /* the audio filter yields outputs of mpx samples D - 1, 2 * D - 1, ..., the resampler of L * k / M */
+        const uint64_t first = position / plan.audio_decimation;
+        const uint64_t last = (position + n) / plan.audio_decimation;
+        const uint64_t L = plan.resampler_interpolation;
+        const uint64_t M = plan.resampler_decimation;
+
+        return static_cast<std::size_t>(((last * L + M - 1) / M - (first * L + M - 1) / M) * audio_channels);
+    };
+
+    /* stateless - everything it needs from the past comes along with the block */
+    auto fm_block = [&](std::size_t worker, if_buffer_uptr&& ifbuf_uptr){
+
+        if (late(ifbuf_uptr->timestamp)) {
+            fm_metrics->add_dropped();
+            return pcm_buffer_uptr{};
+        }
+
+        fm_worker& state = fm_workers_state[worker];
+        ymn::stage_metrics::scope busy{*fm_metrics};
+        const std::size_t overlap = ifbuf_uptr->overlap;
+
+        fm_metrics->add_samples(ifbuf_uptr->channels[0].size() - overlap);
+
+        pcm_buffer_uptr pcmbuf_uptr = pcm_pool->acquire<channels_buffer<pcm_t>>();
+        if (!pcmbuf_uptr) {
+            fm_metrics->add_dropped();
+            fprintf(stderr, "%s: pcm_pool->acquire() failed\n", __PRETTY_FUNCTION__);
+            fprintf(stderr, "%s\n", pcm_pool->to_string().c_str());
+            return pcmbuf_uptr;
+        }
+
+        for (std::size_t c = 0; c < n_channels; ++c) {
+            const std::vector<iq_t>& iq = ifbuf_uptr->channels[c];
+            std::vector<pcm_t>& pcm = pcmbuf_uptr->channels[c];
+
+            /* dead air is not demodulated, it becomes silence (of the length the audio would have) or nothing */
+            if (!ifbuf_uptr->open[c]) {
+                pcm.assign(squelch_silence ? pcm_samples(ifbuf_uptr->position, iq.size() - overlap) : 0, 0);
+                continue;
+            }
+
+            /* first overlapping sample is only needed as the previous one of the second */
+            iq_t previous = iq[0];
+            state.mpx_samples.resize(iq.size() - 1);
+            fm_demod(state.mpx_samples.data(), iq.data() + 1, iq.size() - 1, previous);
+
+            /* remaining overlapping samples become the filter history */
+            const pcm_t* mpx = state.mpx_samples.data() + (overlap - 1);
+            const std::size_t n = state.mpx_samples.size() - (overlap - 1);
+
+            /* starting resampler_lead (a multiple of the decimation) samples earlier keeps the decimation phase */
+            state.audio_filter.resume(state.mpx_samples.data(), ifbuf_uptr->position);
+
+            if (!stereo && !resampling) {
+                pcm.resize(state.audio_filter.max_output_size(n));
+                pcm.resize(state.audio_filter.decimate(mpx, n, pcm.data()));
+                continue;
+            }
+
+            std::vector<pcm_t>& audio = resampling ? state.audio_samples : pcm;
+
+            if (!stereo) {
+                /* first RESAMPLER_TAPS - 1 outputs precede the block, they become the resampler history */
+                audio.resize(state.audio_filter.max_output_size(resampler_lead + n));
+                audio.resize(state.audio_filter.decimate(mpx - resampler_lead, resampler_lead + n, audio.data()));
+
+                const std::size_t history = resampler_type::taps - 1;
+                state.resampler.resume(audio.data(), ifbuf_uptr->position / plan.audio_decimation);
+                pcm.resize(state.resampler.max_output_size(audio.size() - history));
+                pcm.resize(state.resampler.resample(audio.data() + history, audio.size() - history, pcm.data()));
+                continue;
+            }
+
+            /* mono (sum) signal is extended by the difference one, out of the same mpx samples */
+            const std::size_t output = ifbuf_uptr->stream * n_channels + c;
+            stereo_decoder_type& decoder = stereo_decoders[output];
+            const bool locked = decoder.locked();
+            const bool contiguous = (decoder.position() == ifbuf_uptr->position);
+
+            state.sum_samples.resize(state.audio_filter.max_output_size(n));
+            state.sum_samples.resize(state.audio_filter.decimate(mpx, n, state.sum_samples.data()));
+
+            audio.resize(decoder.max_output_size(n));
+            audio.resize(decoder.decode(mpx, n, ifbuf_uptr->position, state.sum_samples.data(), state.sum_samples.size(), audio.data()));
+
+            if (decoder.locked() != locked)
+                fprintf(stderr, "%u Hz: stereo pilot %s\n", frequencies[output], decoder.locked() ? "locked" : "lost");
+
+            if (resampling) {
+                resampler_type& stereo_resampler = stereo_resamplers[output];
+                /* the decoder has started over after blocks missed in between, so does its resampler */
+                if (!contiguous)
+                    stereo_resampler.resume(stereo_silence.data(), ifbuf_uptr->position / plan.audio_decimation);
+                pcm.resize(stereo_resampler.max_output_size(audio.size()));
+                pcm.resize(stereo_resampler.resample(audio.data(), audio.size(), pcm.data()));
+            }
+        }
+
+        pcmbuf_uptr->timestamp = ifbuf_uptr->timestamp;
+        pcmbuf_uptr->stream = ifbuf_uptr->stream;
+
+        return pcmbuf_uptr;
     };
 
-    auto consumer = [&](ymn::iringbuffer<ymn::pipeline::buffer_uptr>* irb, ymn::oringbuffer<ymn::pipeline::buffer_uptr>* orb){
+    /* blocks are dealt in turn, unless the stereo decoder of their stream needs them (see stereo_decoders) */
+    auto fm_stage = ymn::replicate(fm_workers, fm_block,
+        [&, block = std::size_t{0}](const if_buffer_uptr& ifbuf_uptr) mutable { return stereo ? ifbuf_uptr->stream : block++; });
+
+    /* each block carries samples of its stream only, spans of the other outputs stay empty */
+    std::vector<struct iovec> spans(n_outputs);
+
+    auto consumer = [&](ymn::stage_input<pcm_buffer_uptr>* irb){
 
         assert(irb != nullptr);
-        assert(orb == nullptr);
 
-        pcm_buffer_uptr pcmbuf_uptr = get_pcm_buffer_uptr(irb);
-        if (!pcmbuf_uptr)
+        ymn::pipeline_batch<pcm_buffer_uptr, STAGE_BATCH> pcmbufs;
+        bool status = true;
+
+        if (ymn::pipeline_read(irb, pcmbufs) <= 0)
             return false;
 
-        fwrite(pcmbuf_uptr->vector.data(), sizeof(pcm_t), pcmbuf_uptr->vector.size(), fp);
+        for (std::size_t i = 0; i < pcmbufs.size(); ++i) {
+            ymn::stage_metrics::scope busy{*consumer_metrics};
+            pcm_buffer_uptr& pcmbuf_uptr = pcmbufs[i];
+            const ymn::metrics_clock::time_point timestamp = pcmbuf_uptr->timestamp;
+            const std::size_t first = pcmbuf_uptr->stream * n_channels;
+
+            if (late(timestamp))
+                consumer_metrics->add_dropped();
+            else {
+                consumer_metrics->add_samples(pcmbuf_uptr->channels[0].size());
+                std::fill(spans.begin(), spans.end(), iovec{nullptr, 0});
+                for (std::size_t c = 0; c < n_channels; ++c) {
+                    std::vector<pcm_t>& pcm = pcmbuf_uptr->channels[c];
+                    spans[first + c] = {pcm.data(), pcm.size() * sizeof(pcm_t)};
+                }
+
+                status = sink->push(std::move(pcmbuf_uptr), spans.data(), timestamp) && status;
+            }
+
+            /* once per batch, accounted to its last buffer */
+            if (i == (pcmbufs.size() - 1))
+                status = sink->commit(ymn::metrics_clock::now()) && status;
+        }
+
+        if (!status) {
+            /* the very same as if SIGPIPE (it is blocked) was delivered, the signal thread stops everything */
+            fprintf(stderr, "%s: cannot write the output (%s)\n", __PRETTY_FUNCTION__, strerror(errno));
+            kill(getpid(), SIGPIPE);
+            return false;
+        }
+
+        return true;
+    };
+
+    ymn::metrics_clock::time_point replay_start;
+
+    /* hands out the recording block by block, either paced to the dongle rate or as fast as it can */
+    auto producer_replay = [&](ymn::stage_output<iq_buffer_uptr>* orb){
+
+        assert(orb != nullptr);
+
+        const uint8_t* data;
+        std::size_t len = reader.next(transfer_size, data);
+
+        if (len == 0)
+            return false; /* end of the recording */
+
+        push_block(0, data, len, orb);
+
+        if (!fast) {
+            const uint64_t samples = reader.offset() / 2;
+            std::this_thread::sleep_until(replay_start +
+                std::chrono::nanoseconds(samples * 1000000000ULL / plan.rtl_rate));
+        }
 
         return true;
     };
 
-    ymn::pipeline::stage_function functions[] = {producer, fm_stage, consumer};
-    pipeline = std::make_unique<ymn::pipeline>(functions, 42);
+    auto producer = [&](ymn::stage_output<iq_buffer_uptr>* orb){
+        if (n_streams > 1)
+            return producer_devices(orb);
+
+        if (capture == capture_mode::REPLAY)
+            return producer_replay(orb);
+
+        return capture_device(0, orb);
+    };
+
+    const std::size_t if_stage_in_flight = if_stage.max_in_flight();
+    const std::size_t fm_stage_in_flight = fm_stage.max_in_flight();
+
+    pipeline = ymn::make_static_pipeline(queue_capacity, overflow, producer, std::move(if_stage), std::move(fm_stage), consumer);
+    pipeline->latency().set_budget(budget);
+
+    sink_config.sample_rate = plan.audio_rate;
+    sink_config.channels = static_cast<uint16_t>(audio_channels);
+    sink = std::make_unique<ymn::pcm_sink<pcm_buffer_uptr>>(fds, sink_config, &pipeline->latency());
+
+    /* queue plus buffers held by the stages on its both sides (a capture thread holds one at a time) */
+    const std::size_t iq_pool_capacity = pipeline->queue_capacity() + n_streams + if_stage_in_flight;
+    const std::size_t if_pool_capacity = pipeline->queue_capacity() + if_stage_in_flight + fm_stage_in_flight;
+    const std::size_t pcm_pool_capacity = pipeline->queue_capacity() + fm_stage_in_flight + STAGE_BATCH;
+
+    /* what the sink keeps: coalesced blocks (checked once per batch) and, with vmsplice, a pipe full of them */
+    const std::size_t pcm_block_bytes = std::max<std::size_t>(1, pcm_samples_max / 2) * sizeof(pcm_t);
+    const std::size_t sink_bytes = std::max<std::size_t>(sink_config.flush_bytes,
+        std::chrono::duration_cast<std::chrono::milliseconds>(sink_config.flush_time).count() * plan.audio_rate / 1000 * audio_channels * sizeof(pcm_t));
+    const std::size_t sink_capacity = STAGE_BATCH + (sink_bytes + sink->pipe_bytes()) / pcm_block_bytes + 1;
+
+    iq_pool = pipeline->create_pool<buffer<iq_t>>(iq_pool_capacity, iq_samples_max);
+    if_pool = pipeline->create_pool<if_buffer>(if_pool_capacity, n_channels, if_overlap + if_samples_max);
+    pcm_pool = pipeline->create_pool<channels_buffer<pcm_t>>(pcm_pool_capacity + sink_capacity, n_channels, pcm_samples_max);
+
+    producer_metrics = pipeline->create_metrics("producer");
+    if_metrics = pipeline->create_metrics("if");
+    fm_metrics = pipeline->create_metrics("fm");
+    consumer_metrics = pipeline->create_metrics("consumer");
+
+    for (std::size_t output = 0; output < n_outputs; ++output)
+        signal_metrics[output] = pipeline->create_signal_metrics((std::to_string(frequencies[output]) + " Hz").c_str());
+
+    assert(pipeline->stages() == PIPELINE_STAGES);
+
+    for (std::size_t n = 0; n < PIPELINE_STAGES; ++n) {
+        if (thread_policies[n].is_default())
+            continue;
+
+        int status = pipeline->set_thread_policy(n, thread_policies[n]);
+        if (status != 0)
+            fprintf(stderr, "Cannot set %s of stage '%s' (%s)\n",
+                thread_policies[n].to_string().c_str(), stage_names[n], strerror(status));
+        else
+            fprintf(stderr, "Stage '%s': %s\n", stage_names[n], thread_policies[n].to_string().c_str());
+    }
+
+    /* all pools are allocated by now (the recording maps its file afterwards, not to pin all of it) */
+    if (lock) {
+        int status = ymn::lock_memory();
+        if (status != 0)
+            fprintf(stderr, "Cannot lock memory (%s)\n", strerror(status));
+        else
+            fprintf(stderr, "Memory locked\n");
+    }
+
+    if (record != nullptr) {
+        const std::size_t bytes_per_second = 2 * static_cast<std::size_t>(plan.rtl_rate);
+        const std::size_t blocks = bytes_per_second * RECORDER_BUFFERING / 1000 / transfer_size + 1;
+
+        if (!recorder.open(record, record_seconds * bytes_per_second, pretrigger * bytes_per_second, transfer_size, blocks)) {
+            fprintf(stderr, "Cannot create recording '%s' (%s)\n", record, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        if (pretrigger > 0)
+            fprintf(stderr, "Recording: '%s' (up to %u s), last %u s kept in memory, written on SIGUSR2\n", record, record_seconds, pretrigger);
+        else
+            fprintf(stderr, "Recording: '%s' (up to %u s)\n", record, record_seconds);
+    }
+
+    replay_start = ymn::metrics_clock::now();
 
     pipeline->start();
-    pipeline->join();
 
-    rtlsdr_close(rtlsdr_device);
+    std::atomic<bool> finished{false};
+    std::thread signal_thread{handle_signals, &signals, std::cref(finished), metrics_interval};
+
+    std::thread agc_thread;
+    if (agc)
+        agc_thread = std::thread{control_gain, std::cref(finished), std::ref(gain_controls), std::cref(devices)};
+
+    /* a capture which has failed on its own (e.g. a usb hiccup) is restarted on the very same pipeline */
+    ymn::metrics_clock::time_point run_start = ymn::metrics_clock::now();
+    for (uint32_t restarts = 0; ; ) {
+        pipeline->join();
+
+        std::lock_guard<std::mutex> lock{pipeline_mutex};
+
+        if ((ymn::metrics_clock::now() - run_start) > std::chrono::seconds{1})
+            restarts = 0;
+
+        if (!capturing || !capture_failed || (restarts == CAPTURE_RESTARTS))
+            break;
+
+        fprintf(stderr, "Capture failed, restarting it (%u of %d)\n", ++restarts, CAPTURE_RESTARTS);
+
+        capture_failed = false;
+        for (std::size_t d = 0; d < n_streams; ++d) {
+            capture_streams[d].counter = 0;
+            if (rtlsdr_reset_buffer(rtlsdr_devices[d]))
+                fprintf(stderr, "rtlsdr_reset_buffer() failed\n");
+        }
+
+        run_start = ymn::metrics_clock::now();
+        pipeline->start();
+    }
+
+    finished = true;
+    signal_thread.join();
+    if (agc_thread.joinable())
+        agc_thread.join();
+
+    capture_exiting = true;
+    for (std::size_t d = 1; d <= capture_threads.size(); ++d)
+        capture_start[d].post();
+    for (std::thread& thread : capture_threads)
+        thread.join();
+
+    /* whatever is still queued when the pipeline was stopped */
+    sink->flush();
+
+    fprintf(stderr, "%s", pipeline->report().c_str());
+    fprintf(stderr, "%s\n", sink->to_string().c_str());
+
+    for (std::size_t d = 0; d < gain_controls.size(); ++d)
+        fprintf(stderr, "Device '%s': %s\n", devices[d], gain_controls[d]->to_string().c_str());
+
+    if (recorder.is_open()) {
+        recorder.close();
+        fprintf(stderr, "%s\n", recorder.to_string().c_str());
+    }
 
-    if (fp != stdout)
-        fclose(fp);
+    if (capture == capture_mode::REPLAY) {
+        const double elapsed = std::chrono::duration<double>(ymn::metrics_clock::now() - replay_start).count();
+        const double samples = static_cast<double>(reader.offset() / 2);
+        const double duration = samples / plan.rtl_rate;
+
+        fprintf(stderr, "Replayed %.0f samples (%.3f s of signal) in %.3f s: %.2f MS/s, realtime factor %.2f\n",
+            samples, duration, elapsed, samples / elapsed / 1e6, duration / elapsed);
+
+        for (const ymn::stage_metrics* metrics : {producer_metrics, if_metrics, fm_metrics, consumer_metrics}) {
+            const double busy = metrics->processing.sum() / 1e9;
+            fprintf(stderr, " - %-8s stage: busy %.3f s, %.2f MS/s, realtime factor %.2f\n", metrics->name.c_str(), busy,
+                (busy > 0) ? samples / busy / 1e6 : 0.0, (busy > 0) ? duration / busy : 0.0);
+        }
+    }
+    else
+        for (rtlsdr_dev_t* device : rtlsdr_devices)
+            rtlsdr_close(device);
+
+    sink.reset();
+
+    for (int fd : fds)
+        if (fd != STDOUT_FILENO)
+            close(fd);
 
     return 0;
 }
@@ -420,49 +1555,178 @@ int main(int argc, char *argv[])
 \*===========================================================================*/
 static void print_usage(const char* progname)
 {
-    fprintf(stderr, "usage: %s -f <frequency> [<filename>]\n", progname);
+    fprintf(stderr, "usage: %s -f <frequency> [-f <frequency> ...] [-F <file>] [-d <device> ...] [-D <discriminator>] [<filename>]\n", progname);
     fprintf(stderr, " options:\n");
-    fprintf(stderr, "  -f <frequency>  --frequency=<frequency> : center frequency to tune to\n");
-    fprintf(stderr, "  <filename>                              : print output values to this file (default: stdout)\n");
+    fprintf(stderr, "  -f <frequency>  --frequency=<frequency>         : station to receive, may be repeated\n");
+    fprintf(stderr, "  -d <device>     --device=<index|serial>         : device to capture (default: 0), may be repeated\n");
+    fprintf(stderr, "                                                    i-th device receives i-th station\n");
+    fprintf(stderr, "  -F <file>       --channels=<file>               : stations to receive, one frequency per line\n");
+    fprintf(stderr, "  -D <name>       --discriminator=<name>          : atan2, fast-atan2 or derivative (default: %s)\n",
+        ymn::discriminator_type_to_string(ymn::discriminator_type::FM_DISCRIMINATOR));
+    fprintf(stderr, "  --simd=<isa>                                    : none, sse4.1, avx2 or neon (default: best supported)\n");
+    fprintf(stderr, "  --capture=<mode>                                : sync or async (default: async)\n");
+    fprintf(stderr, "  --transfers=<n>                                 : number of async transfers (default: %d)\n", ASYNC_TRANSFERS);
+    fprintf(stderr, "  --transfer-size=<bytes>                         : multiple of 512 (default: %d, %d with --low-latency)\n", IQBUF_SIZE, LOW_LATENCY_TRANSFER);
+    fprintf(stderr, "  --fm-workers=<n>                                : threads demodulating in parallel (default: %d,\n", FM_WORKERS);
+    fprintf(stderr, "                                                    one per core for several devices)\n");
+    fprintf(stderr, "  -i <file>       --input=<file>                  : replay raw u8 IQ recording ('-' for stdin) instead of the device\n");
+    fprintf(stderr, "  --fast                                          : replay as fast as possible and report throughput\n");
+    fprintf(stderr, "  --metrics=<seconds>                             : print metrics that often (default: 0, never)\n");
+    fprintf(stderr, "                                                    SIGUSR1 prints them as json at any time\n");
+    fprintf(stderr, "  --flush-bytes=<bytes>                           : coalesce output until that many bytes are queued\n");
+    fprintf(stderr, "  --flush-ms=<milliseconds>                       : or until the oldest queued block waits that long\n");
+    fprintf(stderr, "                                                    (default: neither, write whatever came at once)\n");
+    fprintf(stderr, "  --flush-each-block                              : write every block on its own (lowest latency)\n");
+    fprintf(stderr, "  --vmsplice                                      : hand the output to a pipe by vmsplice() (no copying)\n");
+    fprintf(stderr, "  --pin=<stage>=<cpus>[,...]                      : run stage on these cpus, e.g. producer=2,fm=3+4 or if=4-5\n");
+    fprintf(stderr, "  --sched=<stage>=<fifo|rr>[:<priority>][,...]    : realtime scheduling of stage (default priority: %d)\n", THREAD_PRIORITY_DEFAULT);
+    fprintf(stderr, "                                                    stages: producer, if, fm, consumer\n");
+    fprintf(stderr, "  --mlock                                         : lock all memory (needs large enough RLIMIT_MEMLOCK)\n");
+    fprintf(stderr, "  --stereo                                        : decode stereo, output is left and right interleaved\n");
+    fprintf(stderr, "                                                    (mono until the pilot is locked)\n");
+    fprintf(stderr, "  --deemphasis=<us>                               : de-emphasis of stereo, 0 disables it (default: %d)\n", DEEMPHASIS);
+    fprintf(stderr, "  --rtl-rate=<Hz>                                 : sampling rate of the dongle (default: %d),\n", RTL_SDR_SAMPLE_RATE);
+    fprintf(stderr, "                                                    a multiple of %d times the if rate\n", CIC_FIR_DECIMATION);
+    fprintf(stderr, "  --if-rate=<Hz>                                  : intermediate (demodulation) rate (default: %d)\n", IF_SAMPLE_RATE);
+    fprintf(stderr, "  --audio-rate=<Hz>                               : output rate (default: %d), e.g. 44100 or 32000\n", AUDIO_SAMPLE_RATE);
+    fprintf(stderr, "                                                    (resampled unless the if rate is its multiple)\n");
+    fprintf(stderr, "  --low-latency[=<ms>]                            : drop blocks waiting longer than that since capture\n");
+    fprintf(stderr, "                                                    (default: %d), small transfers, each block flushed\n", LOW_LATENCY_BUDGET);
+    fprintf(stderr, "  --record=<filename>                             : also write the raw u8 I/Q (as rtl_sdr does) to this file\n");
+    fprintf(stderr, "  --record-seconds=<s>                            : length of the recording, allocated upfront (default: %d)\n", RECORD_SECONDS);
+    fprintf(stderr, "  --pretrigger=<s>                                : keep only the last <s> of the recording in memory,\n");
+    fprintf(stderr, "                                                    each SIGUSR2 appends them to the file\n");
+    fprintf(stderr, "  --squelch=<dBFS>                                : do not demodulate blocks weaker than that (closes %d dB below)\n", SQUELCH_HYSTERESIS);
+    fprintf(stderr, "  --squelch-mode=<mode>                           : squelched blocks become silence or are skipped (default: silence)\n");
+    fprintf(stderr, "  --net=<udp|tcp>://<host>:<port>                 : send framed output to this socket instead of a file,\n");
+    fprintf(stderr, "                                                    i-th station to i-th port from it on (udp may be multicast)\n");
+    fprintf(stderr, "  --net-ttl=<hops>                                : of multicast datagrams (default: %d)\n", NET_MULTICAST_TTL);
+    fprintf(stderr, "  --agc                                           : set the tuner gain by clipping of the samples\n");
+    fprintf(stderr, "                                                    (default: automatic gain of the tuner)\n");
+    fprintf(stderr, "  --overflow=[<queue>:]<policy>[,...]             : block, drop-newest or drop-oldest, when a queue is full\n");
+    fprintf(stderr, "                                                    of all queues or of the one read by stage if, fm or consumer\n");
+    fprintf(stderr, "                                                    (default: drop-newest, drop-oldest with --low-latency,\n");
+    fprintf(stderr, "                                                    block with --input)\n");
+    fprintf(stderr, "  <filename>                                      : print output values to this file (default: stdout)\n");
+    fprintf(stderr, "                                                    several stations (or devices) are written to <filename>.<frequency>\n");
 }
 
-static void signal_handler(int signum)
+static void block_signals(sigset_t* set)
 {
-    fprintf(stderr, "caught signal %d, terminating ...\n", signum);
-    if (pipeline != nullptr)
-        pipeline->stop();
-    fprintf(stderr, "done\n");
+    sigemptyset(set);
+    sigaddset(set, SIGINT);
+    sigaddset(set, SIGTERM);
+    sigaddset(set, SIGQUIT);
+    sigaddset(set, SIGPIPE);
+    sigaddset(set, SIGUSR1);
+    sigaddset(set, SIGUSR2);
+    sigaddset(set, SIGTSTP);
+    sigaddset(set, SIGCONT);
+
+    pthread_sigmask(SIG_BLOCK, set, NULL);
 }
 
-static void install_signal_handler(void)
+/*
+ * Signals are taken synchronously by a thread of their own (so it may do anything,
+ * e.g. print), which also prints the metrics every 'metrics_interval' seconds (if not 0).
+ * SIGUSR1 prints a machine readable snapshot of the metrics, SIGUSR2 writes out the pre-trigger ring
+ * of the recording, SIGTSTP pauses the pipeline (the capture is cancelled) before the process stops
+ * and SIGCONT resumes it, the others stop the capture: the pipeline is drained (whatever is queued
+ * is still written), unless it is SIGPIPE (nowhere to write it) or the second such signal.
+ */
+static void handle_signals(const sigset_t* set, const std::atomic<bool>& finished, uint32_t metrics_interval)
 {
-    struct sigaction sigact;
-
-    sigact.sa_handler = signal_handler;
-    sigemptyset(&sigact.sa_mask);
-    sigact.sa_flags = 0;
+    const struct timespec timeout = {0, 100 * 1000 * 1000};
+    const std::chrono::seconds interval{metrics_interval};
+    ymn::metrics_clock::time_point next_report = ymn::metrics_clock::now() + interval;
+
+    while (!finished) {
+        int signum = sigtimedwait(set, NULL, &timeout);
+
+        if (signum == SIGUSR1)
+            fprintf(stderr, "%s\n", pipeline->snapshot().c_str());
+        else
+        if (signum == SIGUSR2)
+            recorder.trigger();
+        else
+        if (signum == SIGTSTP) {
+            {
+                std::lock_guard<std::mutex> lock{pipeline_mutex};
+
+                fprintf(stderr, "caught signal %d, pausing ...\n", signum);
+                ++pauses;
+                pipeline->pause();
+                if (capture == capture_mode::ASYNC)
+                    for (rtlsdr_dev_t* device : rtlsdr_devices)
+                        rtlsdr_cancel_async(device);
+            }
+
+            /* stops as it would have, had the signal not been caught */
+            raise(SIGSTOP);
+        }
+        else
+        if (signum == SIGCONT) {
+            std::lock_guard<std::mutex> lock{pipeline_mutex};
+
+            if (pipeline->paused()) {
+                fprintf(stderr, "caught signal %d, resuming\n", signum);
+                pipeline->resume();
+            }
+        }
+        else
+        if (signum > 0) {
+            std::lock_guard<std::mutex> lock{pipeline_mutex};
+            const bool drain = capturing && (signum != SIGPIPE);
+
+            fprintf(stderr, "caught signal %d, %s ...\n", signum, drain ? "draining" : "terminating");
+            capturing = false;
+            if (capture == capture_mode::ASYNC)
+                for (rtlsdr_dev_t* device : rtlsdr_devices)
+                    rtlsdr_cancel_async(device);
+            if (drain)
+                pipeline->drain();
+            else
+                pipeline->stop();
+            fprintf(stderr, "done\n");
+        }
+        else
+        if (capture == capture_mode::ASYNC) {
+            std::lock_guard<std::mutex> lock{pipeline_mutex};
+
+            /* a device which was just entering its capture may have missed the cancellation, it is repeated */
+            if (!capturing || capture_failed || pipeline->paused())
+                for (rtlsdr_dev_t* device : rtlsdr_devices)
+                    rtlsdr_cancel_async(device);
+        }
 
-    sigaction(SIGINT, &sigact, NULL);
-    sigaction(SIGTERM, &sigact, NULL);
-    sigaction(SIGQUIT, &sigact, NULL);
-    sigaction(SIGPIPE, &sigact, NULL);
+        if ((metrics_interval > 0) && (ymn::metrics_clock::now() >= next_report)) {
+            fprintf(stderr, "%s", pipeline->report().c_str());
+            next_report += interval;
+        }
+    }
 }
 
-static void fm_demod(pcm_t *pcmbuf, iq_t* iqbuf, const std::size_t N)
+/*
+ * Every AGC_INTERVAL ms takes the counts of clipped samples of each device and changes
+ * its tuner gain if needed, so that the capture threads never make a (blocking) usb control transfer.
+ */
+static void control_gain(const std::atomic<bool>& finished, std::vector<std::unique_ptr<ymn::gain_control>>& controls,
+    const std::vector<const char*>& devices)
 {
-    pcm_t pcm;
-    static iq_t previous{0, 0};
+    while (!finished) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(AGC_INTERVAL));
 
-    if (N > 0) {
-        pcm = polar_discriminator(iqbuf[0], previous);
-        pcmbuf[0] = pcm;
+        for (std::size_t d = 0; d < controls.size(); ++d) {
+            int gain;
 
-        for (std::size_t n = 1; n < N; ++n) {
-            pcm = polar_discriminator(iqbuf[n], iqbuf[n-1]);
-            pcmbuf[n] = pcm;
-        }
+            if (!controls[d]->update(gain))
+                continue;
 
-        previous = iqbuf[N - 1];
+            if (rtlsdr_set_tuner_gain(rtlsdr_devices[d], gain))
+                fprintf(stderr, "rtlsdr_set_tuner_gain(%d) failed\n", gain);
+            else
+                fprintf(stderr, "Device '%s': tuner gain %.1f dB\n", devices[d], gain / 10.0);
+        }
     }
 }
 
@@ -534,3 +1798,189 @@ static int verbose_device_search(const char *s)
     return -1;
 }
 
+/*
+ * Channel list file holds one frequency (in Hz) per line,
+ * empty lines and everything after '#' are ignored.
+ */
+static bool read_channels(const char* filename, std::vector<uint32_t>& frequencies)
+{
+    char line[256];
+    unsigned int line_number = 0;
+    bool status = true;
+
+    FILE* fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open '%s'\n", filename);
+        return false;
+    }
+
+    while (status && (fgets(line, sizeof(line), fp) != NULL)) {
+        char* token;
+        uint32_t frequency;
+
+        ++line_number;
+
+        line[strcspn(line, "#")] = '\0';
+        token = strtok(line, " \t\r\n");
+        if (token == NULL)
+            continue;
+
+        if ((ymn::strtointeger(token, frequency) != ymn::strtointeger_conversion_status_e::success) ||
+            (frequency == 0) || (strtok(NULL, " \t\r\n") != NULL)) {
+            fprintf(stderr, "%s:%u: invalid frequency\n", filename, line_number);
+            status = false;
+        }
+        else
+            frequencies.push_back(frequency);
+    }
+
+    fclose(fp);
+
+    return status;
+}
+
+/*
+ * Parses <stage>=<value>[,<stage>=<value>...], value being either cpus
+ * (see ymn::cpu_set_from_string()) or scheduling (see ymn::scheduler_from_string()) of the stage.
+ */
+static bool read_stage_policies(const char* arg, bool affinity, ymn::thread_policy (&policies)[PIPELINE_STAGES])
+{
+    std::string list{arg};
+
+    for (char* item = strtok(&list[0], ","); item != NULL; item = strtok(NULL, ",")) {
+        char* value = strchr(item, '=');
+        std::size_t stage;
+        bool status;
+
+        if (value == NULL) {
+            fprintf(stderr, "Invalid '%s', expected <stage>=<value>\n", item);
+            return false;
+        }
+
+        *value++ = '\0';
+
+        for (stage = 0; (stage < PIPELINE_STAGES) && (strcmp(item, stage_names[stage]) != 0); ++stage);
+        if (stage == PIPELINE_STAGES) {
+            fprintf(stderr, "Unknown stage '%s'\n", item);
+            return false;
+        }
+
+        if (affinity)
+            status = ymn::cpu_set_from_string(value, policies[stage].cpus);
+        else
+            status = ymn::scheduler_from_string(value, policies[stage].scheduler, policies[stage].priority);
+
+        if (!status) {
+            fprintf(stderr, "Invalid %s '%s' of stage '%s'\n", affinity ? "cpus" : "scheduling", value, item);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Parses [<queue>:]<policy>[,[<queue>:]<policy>...], a queue being named after the stage which reads it
+ * (if, fm or consumer) and a policy without one being that of all queues.
+ */
+static bool read_overflow_policies(const char* arg, std::array<ymn::overflow_policy, PIPELINE_QUEUES>& policies,
+    bool (&given)[PIPELINE_QUEUES])
+{
+    std::string list{arg};
+
+    for (char* item = strtok(&list[0], ","); item != NULL; item = strtok(NULL, ",")) {
+        char* value = strchr(item, ':');
+        ymn::overflow_policy policy;
+        std::size_t queue;
+
+        if (value == NULL) {
+            if (!ymn::overflow_policy_from_string(item, policy)) {
+                fprintf(stderr, "Unknown overflow policy '%s'\n", item);
+                return false;
+            }
+
+            for (queue = 0; queue < PIPELINE_QUEUES; ++queue) {
+                policies[queue] = policy;
+                given[queue] = true;
+            }
+            continue;
+        }
+
+        *value++ = '\0';
+
+        for (queue = 0; (queue < PIPELINE_QUEUES) && (strcmp(item, stage_names[queue + 1]) != 0); ++queue);
+        if (queue == PIPELINE_QUEUES) {
+            fprintf(stderr, "Unknown queue '%s'\n", item);
+            return false;
+        }
+
+        if (!ymn::overflow_policy_from_string(value, policy)) {
+            fprintf(stderr, "Unknown overflow policy '%s' of queue '%s'\n", value, item);
+            return false;
+        }
+
+        policies[queue] = policy;
+        given[queue] = true;
+    }
+
+    return true;
+}
+
+/*
+ * Opens device given by its index or serial (see verbose_device_search()),
+ * which is then appended to rtlsdr_devices.
+ */
+static bool open_device(const char* device, uint32_t frequency, uint32_t sample_rate, bool manual_gain)
+{
+    rtlsdr_dev_t *rtlsdr_device = NULL;
+    int status;
+    int dev_index;
+
+    dev_index = verbose_device_search(device);
+    if (dev_index < 0)
+        return false;
+
+    fprintf(stderr, "Opening device #%d\n", dev_index);
+    status = rtlsdr_open(&rtlsdr_device, (uint32_t)dev_index);
+    if (status < 0) {
+        fprintf(stderr, "Failed to open rtlsdr device #%d\n", dev_index);
+        return false;
+    }
+    rtlsdr_devices.push_back(rtlsdr_device);
+    fprintf(stderr, " - done\n");
+
+    fprintf(stderr, "Setting tuner gain to %s\n", manual_gain ? "manual" : "automatic");
+    status = rtlsdr_set_tuner_gain_mode(rtlsdr_device, manual_gain ? 1 : 0);
+    if (status) {
+        fprintf(stderr, "rtlsdr_set_tuner_gain_mode(%d) failed\n", manual_gain ? 1 : 0);
+        return false;
+    }
+    fprintf(stderr, " - done\n");
+
+    /* Reset endpoint before we start reading from it (mandatory) */
+    fprintf(stderr, "Resseting rtlsdr buffers\n");
+    status = rtlsdr_reset_buffer(rtlsdr_device);
+    if (status) {
+        fprintf(stderr, "rtlsdr_reset_buffer() failed\n");
+        return false;
+    }
+    fprintf(stderr, " - done\n");
+
+    fprintf(stderr, "Setting center frequency to %u Hz\n", frequency);
+    status = rtlsdr_set_center_freq(rtlsdr_device, frequency);
+    if (status) {
+        fprintf(stderr, "rtlsdr_set_center_freq(%u) failed\n", frequency);
+        return false;
+    }
+    fprintf(stderr, " - done\n");
+
+    fprintf(stderr, "Setting sample rate to %u Hz\n", sample_rate);
+    status = rtlsdr_set_sample_rate(rtlsdr_device, sample_rate);
+    if (status) {
+        fprintf(stderr, "rtlsdr_set_sample_rate(%u) failed\n", sample_rate);
+        return false;
+    }
+    fprintf(stderr, " - done\n");
+
+    return true;
+}
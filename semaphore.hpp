@@ -2,6 +2,9 @@
  * @file semaphore.hpp
  *
  * Class representing/implementing a semaphore design pattern.
+ * The counter lives in a single atomic word, waiters spin on it for a while
+ * and then sleep on it as on a futex; post() enters the kernel only
+ * when there is somebody sleeping.
  *
  * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
  *
@@ -21,14 +24,16 @@
 /*===========================================================================*\
  * system header files
 \*===========================================================================*/
-#include <type_traits>
-#include <mutex>
-#include <condition_variable>
+#include <atomic>
 #include <chrono>
 
+#include <cstdint>
+#include <cassert>
+
 /*===========================================================================*\
  * project header files
 \*===========================================================================*/
+#include "futex.hpp"
 
 /*===========================================================================*\
  * preprocessor #define constants and macros
@@ -44,10 +49,10 @@ class semaphore
 {
 public:
     explicit semaphore(std::size_t count = 0) :
-       m_mutex{},
-       m_condvar{},
-       m_count{count}
+       m_count{static_cast<uint32_t>(count)},
+       m_waiters{0}
     {
+        assert(count <= UINT32_MAX);
     }
 
     ~semaphore() = default;
@@ -60,14 +65,7 @@ public:
 
     std::size_t get_value() const
     {
-        std::size_t count;
-
-        do {
-            std::lock_guard<decltype(m_mutex)> lock(m_mutex);
-            count = m_count;
-        } while (0);
-
-        return count;
+        return m_count.load(std::memory_order_acquire);
     }
 
     /**
@@ -80,13 +78,11 @@ public:
      */
     void post()
     {
-        do {
-            std::lock_guard<decltype(m_mutex)> lock(m_mutex);
-            m_count++;
-        } while (0);
+        /* see binary_semaphore::post() for why both have to be sequentially consistent */
+        m_count.fetch_add(1, std::memory_order_seq_cst);
 
-        /* the lock does not need to be held for notification */
-        m_condvar.notify_one();
+        if (m_waiters.load(std::memory_order_seq_cst) > 0)
+            futex_wake(m_count, 1);
     }
 
     /**
@@ -101,12 +97,15 @@ public:
      */
     void wait()
     {
-        std::unique_lock<decltype(m_mutex)> lock(m_mutex);
+        if (spin())
+            return;
+
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
 
-        while (m_count == 0)
-            m_condvar.wait(lock);
+        while (!try_wait())
+            futex_wait(m_count, 0);
 
-        m_count--;
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
     }
 
     /**
@@ -125,31 +124,54 @@ public:
      */
     bool wait_timeout(unsigned int milliseconds)
     {
-        const std::chrono::steady_clock::time_point t1(std::chrono::steady_clock::now());
-        const std::chrono::milliseconds timeout(milliseconds);
-        std::chrono::milliseconds elapsed(0);
+        const std::chrono::steady_clock::time_point deadline(
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds));
+        bool status = true;
 
-        std::unique_lock<decltype(m_mutex)> lock(m_mutex);
+        if (spin())
+            return true;
 
-        while (m_count == 0) {
-            if (elapsed >= timeout)
-                return false;
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
 
-            if (std::cv_status::timeout == m_condvar.wait_for(lock, timeout - elapsed))
-                return false;
-
-            const std::chrono::steady_clock::time_point t2(std::chrono::steady_clock::now());
-            elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+        while (!try_wait()) {
+            const std::chrono::nanoseconds remaining(deadline - std::chrono::steady_clock::now());
+            if ((remaining.count() <= 0) || !futex_wait(m_count, 0, &remaining)) {
+                status = try_wait();
+                break;
+            }
         }
 
-        m_count--;
-        return true;
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+
+        return status;
     }
 
 private:
-    mutable std::mutex m_mutex;
-    std::condition_variable m_condvar;
-    std::size_t m_count;
+    bool try_wait()
+    {
+        /* seq_cst so that it cannot be hoisted above the increment of m_waiters */
+        uint32_t count = m_count.load(std::memory_order_seq_cst);
+
+        while (count > 0)
+            if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+                return true;
+
+        return false;
+    }
+
+    bool spin()
+    {
+        for (unsigned int n = futex_spin_count(); n > 0; --n) {
+            if (try_wait())
+                return true;
+            cpu_relax();
+        }
+
+        return try_wait();
+    }
+
+    futex_word m_count;
+    std::atomic<uint32_t> m_waiters;
 };
 
 } /* end of namespace ymn */
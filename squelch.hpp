@@ -0,0 +1,135 @@
+/**
+ * @file squelch.hpp
+ *
+ * Block power estimate and a squelch (with hysteresis) driven by it.
+ * The power of a block of IQ samples is their mean squared magnitude in dB
+ * relative to the full scale (a complex tone of amplitude Q15 being 0 dBFS),
+ * the squelch opens once it reaches the threshold and closes only when it falls
+ * below the threshold minus the hysteresis, so a signal near the threshold does not chatter.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _SQUELCH_HPP_
+#define _SQUELCH_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "fixq15.hpp"
+#include "complex.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+class squelch
+{
+public:
+    /* always open */
+    explicit squelch() :
+        squelch{-HUGE_VAL, 0.0}
+    {
+    }
+
+    /**
+     * @param[in] threshold Power (dBFS) the squelch opens at.
+     * @param[in] hysteresis dB below the threshold the squelch closes at.
+     */
+    explicit squelch(double threshold, double hysteresis) :
+        m_open_level{threshold},
+        m_close_level{threshold - hysteresis},
+        m_open{false}
+    {
+    }
+
+    /**
+     * @param[in] level Power (dBFS) of the next block.
+     *
+     * @return whether the block shall be passed on.
+     */
+    bool update(double level)
+    {
+        m_open = (level >= (m_open ? m_close_level : m_open_level));
+        return m_open;
+    }
+
+    bool is_open() const
+    {
+        return m_open;
+    }
+
+private:
+    double m_open_level;
+    double m_close_level;
+    bool m_open;
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/**
+ * @return mean power (dBFS) of n samples, a block of zeros gives about -100 dB.
+ */
+template<typename T>
+inline double block_power(const complex<T>* x, std::size_t n)
+{
+    int64_t sum = 0;
+
+    for (std::size_t i = 0; i < n; ++i) {
+        const int64_t re = x[i].real().value();
+        const int64_t im = x[i].imag().value();
+        sum += re * re + im * im;
+    }
+
+    const double power = (n > 0) ? static_cast<double>(sum) / n : 0.0;
+
+    return 10.0 * log10((power + 1e-10 * Q15 * Q15) / (static_cast<double>(Q15) * Q15));
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _SQUELCH_HPP_ */
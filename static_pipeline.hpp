@@ -0,0 +1,1021 @@
+/**
+ * @file static_pipeline.hpp
+ *
+ * Compile time counterpart of the pipeline design pattern (see pipeline.hpp).
+ * Stages are passed as callables of their own types and the element type
+ * of each queue is inferred from signatures of the stages it connects:
+ *    bool first(stage_output<T0>* orb);
+ *    bool stage(stage_input<T0>* irb, stage_output<T1>* orb);
+ *    bool last(stage_input<T1>* irb);
+ * so there is no std::function, no common buffer base and no downcasts,
+ * stage bodies can be inlined into the loop of their threads.
+ * A stage returning false ends the stream, stages following it process
+ * what is still queued and then end as well.
+ * Threads (of the stages and of their workers) are created once and parked
+ * between runs, so a pipeline which has been stopped or drained (see drain())
+ * can be started again (e.g. after a device error) without creating any thread,
+ * queue or pool; queues are emptied on every start(). The first stage of a running
+ * pipeline can also be held between its calls (see pause()).
+ * A stage which does not carry any state from one element to the next
+ * can be replicated across several worker threads (see replicate()),
+ * when its state belongs to a stream of elements (e.g. of one of several devices)
+ * elements of each stream can be kept on a worker of its own.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _STATIC_PIPELINE_HPP_
+#define _STATIC_PIPELINE_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <array>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <string>
+#include <sstream>
+
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "semaphore.hpp"
+#include "binary_semaphore.hpp"
+#include "power_of_two.hpp"
+#include "ringbuffer.hpp"
+#include "buffer_pool.hpp"
+#include "pipeline_batch.hpp"
+#include "pipeline_metrics.hpp"
+#include "thread_policy.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/* queues use power of two capacities and masked indexing */
+template<typename T>
+using stage_input = iringbuffer<T, ringbuffer_index_mask>;
+
+template<typename T>
+using stage_output = oringbuffer<T, ringbuffer_index_mask>;
+
+/* what a stage writing into a full queue does */
+enum class overflow_policy
+{
+    DROP_NEWEST, /* write fails and the element is released (live sources must never stall) */
+    DROP_OLDEST, /* oldest queued elements are released to make room (the freshest data survives) */
+    BLOCK,       /* writer waits for room (nothing is lost, e.g. when replaying a recording) */
+};
+
+inline const char* overflow_policy_to_string(overflow_policy policy)
+{
+    switch (policy) {
+        case overflow_policy::DROP_NEWEST: return "drop-newest";
+        case overflow_policy::DROP_OLDEST: return "drop-oldest";
+        case overflow_policy::BLOCK:       return "block";
+    }
+
+    return "unknown";
+}
+
+inline bool overflow_policy_from_string(const char* s, overflow_policy& policy)
+{
+    static const overflow_policy policies[] = {
+        overflow_policy::DROP_NEWEST,
+        overflow_policy::DROP_OLDEST,
+        overflow_policy::BLOCK,
+    };
+
+    for (overflow_policy p : policies)
+        if (strcmp(s, overflow_policy_to_string(p)) == 0) {
+            policy = p;
+            return true;
+        }
+
+    return false;
+}
+
+/* input_type/output_type is void for the first/last stage respectively */
+template<typename... Args>
+struct stage_signature;
+
+template<typename T>
+struct stage_signature<stage_output<T>*>
+{
+    using input_type = void;
+    using output_type = T;
+};
+
+template<typename T>
+struct stage_signature<stage_input<T>*>
+{
+    using input_type = T;
+    using output_type = void;
+};
+
+template<typename T, typename U>
+struct stage_signature<stage_input<T>*, stage_output<U>*>
+{
+    using input_type = T;
+    using output_type = U;
+};
+
+template<typename F>
+struct stage_traits : stage_traits<decltype(&F::operator())>
+{
+};
+
+template<typename C, typename... Args>
+struct stage_traits<bool (C::*)(Args...) const> : stage_signature<Args...>
+{
+};
+
+template<typename C, typename... Args>
+struct stage_traits<bool (C::*)(Args...)> : stage_signature<Args...>
+{
+};
+
+template<typename... Args>
+struct stage_traits<bool (*)(Args...)> : stage_signature<Args...>
+{
+};
+
+/* Element tagged with its position in the stream (queues of replicated stages) */
+template<typename T>
+struct sequenced
+{
+    uint64_t m_sequence = 0;
+    T m_element{};
+};
+
+template<typename F>
+struct replicated_signature : replicated_signature<decltype(&F::operator())>
+{
+};
+
+template<typename C, typename U, typename T>
+struct replicated_signature<U (C::*)(std::size_t, T) const>
+{
+    using input_type = std::decay_t<T>;
+    using output_type = U;
+};
+
+template<typename C, typename U, typename T>
+struct replicated_signature<U (C::*)(std::size_t, T)>
+{
+    using input_type = std::decay_t<T>;
+    using output_type = U;
+};
+
+/* Elements are dealt to the workers in turn (default key of a replicated stage) */
+struct round_robin
+{
+};
+
+/**
+ * Data parallel stage. Its function
+ *    U function(std::size_t worker, T&& element);
+ * turns one input element into one output element (empty one, e.g. nullptr,
+ * drops it) and is called concurrently by 'workers' threads, each of them
+ * passing its own index (0 .. workers - 1) so that it may use its own scratch state.
+ * Elements are numbered and dealt round robin to per worker queues,
+ * outputs are collected in the same order, so the next stage sees them
+ * in the original order. With a single worker the function is called
+ * directly by the stage thread.
+ * Key (other than round_robin)
+ *    std::size_t key(const T& element);
+ * makes elements of the same key go always to the same worker (key % workers),
+ * so the function may keep state of their stream in the worker.
+ * Outputs are still collected in the original order.
+ * Workers (and the gather) are spawned by the stage thread on its first run
+ * (so they inherit its policy) and then wait for the next one.
+ */
+template<typename F, typename K = round_robin>
+class replicated_stage
+{
+    using signature = replicated_signature<F>;
+
+    static constexpr bool keyed = !std::is_same<K, round_robin>::value;
+
+public:
+    using input_type = typename signature::input_type;
+    using output_type = typename signature::output_type;
+
+    /* max number of elements taken from the input queue at once */
+    static constexpr std::size_t batch = 16;
+
+    /* per worker queues are kept short, the input queue of the stage does the buffering */
+    static constexpr std::size_t worker_queue_capacity = 4;
+
+    replicated_stage(std::size_t workers, F function, K key = K{}) :
+        m_workers{workers},
+        m_function{std::move(function)},
+        m_key{std::move(key)},
+        m_inputs{},
+        m_outputs{},
+        m_route{},
+        m_threads{},
+        m_start{},
+        m_done{},
+        m_orb{nullptr},
+        m_exiting{false}
+    {
+        assert(workers > 0);
+    }
+
+    replicated_stage(replicated_stage&&) = default;
+    replicated_stage& operator = (replicated_stage&&) = default;
+
+    ~replicated_stage()
+    {
+        m_exiting = true;
+        for (std::size_t n = 0; n < m_threads.size(); ++n)
+            m_start[n].post();
+        for (std::thread& thread : m_threads)
+            thread.join();
+    }
+
+    std::size_t workers() const
+    {
+        return m_workers;
+    }
+
+    /* upper bound of elements (inputs and outputs) held by the stage at any time */
+    std::size_t max_in_flight() const
+    {
+        if (m_workers == 1)
+            return 2 * batch;
+
+        /* scatter's batch, then for each worker: both its queues, input and output being processed */
+        return batch + m_workers * (2 * worker_queue_capacity + 2) + 1;
+    }
+
+    /* creates per worker queues, shall be called before run() */
+    void prepare()
+    {
+        if (m_workers == 1)
+            return;
+
+        /* nothing may be dropped between the scatter and the gather, otherwise the order would be lost */
+        for (std::size_t w = 0; w < m_workers; ++w) {
+            m_inputs.push_back(std::make_unique<ringbuffer<sequenced<input_type>, ringbuffer_index_mask>>(
+                worker_queue_capacity, RINGBUFFER_RD_BLOCKING_WR_BLOCKING));
+            m_outputs.push_back(std::make_unique<ringbuffer<sequenced<output_type>, ringbuffer_index_mask>>(
+                worker_queue_capacity, RINGBUFFER_RD_BLOCKING_WR_BLOCKING));
+        }
+
+        /* workers of consecutive elements, for the gather to follow (as many as there may be elements in flight) */
+        if constexpr (keyed)
+            m_route = std::make_unique<ringbuffer<std::size_t, ringbuffer_index_mask>>(
+                round_up_to_power_of_two(max_in_flight()), RINGBUFFER_RD_BLOCKING_WR_BLOCKING);
+
+        /* one for each worker and the gather */
+        m_start = std::make_unique<semaphore[]>(m_workers + 1);
+        m_done = std::make_unique<semaphore>(0);
+    }
+
+    void cancel()
+    {
+        for (std::size_t w = 0; w < m_inputs.size(); ++w) {
+            m_inputs[w]->cancel(ringbuffer_role::PRODUCER);
+            m_inputs[w]->cancel(ringbuffer_role::CONSUMER);
+            m_outputs[w]->cancel(ringbuffer_role::PRODUCER);
+            m_outputs[w]->cancel(ringbuffer_role::CONSUMER);
+        }
+
+        if (m_route) {
+            m_route->cancel(ringbuffer_role::PRODUCER);
+            m_route->cancel(ringbuffer_role::CONSUMER);
+        }
+    }
+
+    /* runs the whole stage (scatter, workers, gather) until its input ends or the pipeline is stopped */
+    void run(stage_input<input_type>* irb, stage_output<output_type>* orb, const std::atomic<bool>& running)
+    {
+        if (m_workers == 1) {
+            while ((running) && (direct(irb, orb) == true));
+            return;
+        }
+
+        /* whatever the previous run (if it was stopped) has left behind */
+        for (std::size_t w = 0; w < m_workers; ++w) {
+            m_inputs[w]->clear();
+            m_outputs[w]->clear();
+        }
+        if (m_route)
+            m_route->clear();
+
+        m_orb = orb;
+
+        if (m_threads.empty())
+            for (std::size_t n = 0; n <= m_workers; ++n)
+                m_threads.emplace_back(&replicated_stage::serve, this, n, std::cref(running));
+
+        for (std::size_t n = 0; n <= m_workers; ++n)
+            m_start[n].post();
+
+        scatter(irb, running);
+
+        /* end of the input (or the pipeline is being stopped), workers and gather finish what they have got */
+        for (std::size_t w = 0; w < m_workers; ++w)
+            m_inputs[w]->cancel(ringbuffer_role::CONSUMER);
+        for (std::size_t w = 0; w < m_workers; ++w)
+            m_done->wait();
+
+        for (std::size_t w = 0; w < m_workers; ++w)
+            m_outputs[w]->cancel(ringbuffer_role::CONSUMER);
+        if (m_route)
+            m_route->cancel(ringbuffer_role::CONSUMER);
+        m_done->wait();
+    }
+
+private:
+    bool direct(stage_input<input_type>* irb, stage_output<output_type>* orb)
+    {
+        pipeline_batch<input_type, batch> inputs;
+        pipeline_batch<output_type, batch> outputs;
+
+        if (pipeline_read(irb, inputs) <= 0)
+            return false;
+
+        for (input_type& element : inputs) {
+            output_type output = m_function(0, std::move(element));
+            if (output)
+                outputs.push_back(std::move(output));
+        }
+
+        pipeline_write(orb, outputs);
+
+        return true;
+    }
+
+    void scatter(stage_input<input_type>* irb, const std::atomic<bool>& running)
+    {
+        pipeline_batch<input_type, batch> inputs;
+        uint64_t sequence = 0;
+
+        while (running) {
+            if (pipeline_read(irb, inputs) <= 0)
+                return;
+
+            for (input_type& element : inputs) {
+                std::size_t w = sequence % m_workers;
+
+                if constexpr (keyed) {
+                    w = m_key(static_cast<const input_type&>(element)) % m_workers;
+                    if (m_route->write(w) != 1)
+                        return;
+                }
+
+                sequenced<input_type> s{sequence, std::move(element)};
+                if (m_inputs[w]->write(std::move(s)) != 1)
+                    return;
+                ++sequence;
+            }
+        }
+    }
+
+    /* thread of worker 'n' (the gather for n == workers), runs once per run() of the stage */
+    void serve(std::size_t n, const std::atomic<bool>& running)
+    {
+        for (;;) {
+            m_start[n].wait();
+            if (m_exiting)
+                return;
+
+            if (n < m_workers)
+                work(n, running);
+            else
+                gather(m_orb, running);
+
+            m_done->post();
+        }
+    }
+
+    void work(std::size_t w, const std::atomic<bool>& running)
+    {
+        while (running) {
+            sequenced<input_type> input;
+            if (m_inputs[w]->read(std::move(input)) != 1)
+                return;
+
+            sequenced<output_type> output{input.m_sequence, m_function(w, std::move(input.m_element))};
+            if (m_outputs[w]->write(std::move(output)) != 1)
+                return;
+        }
+    }
+
+    void gather(stage_output<output_type>* orb, const std::atomic<bool>& running)
+    {
+        for (uint64_t sequence = 0; running; ++sequence) {
+            sequenced<output_type> output;
+            std::size_t w = sequence % m_workers;
+
+            if constexpr (keyed)
+                if (m_route->read(w) != 1)
+                    return;
+
+            if (m_outputs[w]->read(std::move(output)) != 1)
+                return;
+
+            assert(output.m_sequence == sequence);
+
+            if (output.m_element)
+                orb->write(std::move(output.m_element));
+        }
+    }
+
+    std::size_t m_workers;
+    F m_function;
+    K m_key;
+    std::vector<std::unique_ptr<ringbuffer<sequenced<input_type>, ringbuffer_index_mask>>> m_inputs;
+    std::vector<std::unique_ptr<ringbuffer<sequenced<output_type>, ringbuffer_index_mask>>> m_outputs;
+    std::unique_ptr<ringbuffer<std::size_t, ringbuffer_index_mask>> m_route;
+    std::vector<std::thread> m_threads;
+    std::unique_ptr<semaphore[]> m_start; /* of each worker and the gather */
+    std::unique_ptr<semaphore> m_done;    /* posted by each of them at the end of a run */
+    stage_output<output_type>* m_orb;     /* of the gather, for the current run */
+    bool m_exiting;                       /* published to the threads by m_start */
+};
+
+template<typename F, typename K>
+struct stage_traits<replicated_stage<F, K>>
+{
+    using input_type = typename replicated_stage<F, K>::input_type;
+    using output_type = typename replicated_stage<F, K>::output_type;
+};
+
+template<typename S>
+struct is_replicated_stage : std::false_type
+{
+};
+
+template<typename F, typename K>
+struct is_replicated_stage<replicated_stage<F, K>> : std::true_type
+{
+};
+
+/* Type independent part (and handle) of all static pipelines */
+class static_pipeline_base
+{
+public:
+    virtual ~static_pipeline_base() = default;
+
+    static_pipeline_base(const static_pipeline_base&) = delete;
+    static_pipeline_base(static_pipeline_base&&) = delete;
+    static_pipeline_base& operator = (const static_pipeline_base&) = delete;
+    static_pipeline_base& operator = (static_pipeline_base&&) = delete;
+
+    /*
+     * Starts all stages or, once join() has returned, starts them again on the same threads
+     * (queues are emptied first, pools and metrics are kept).
+     */
+    virtual void start() = 0;
+
+    /* stops all stages as soon as possible, elements still queued are lost */
+    virtual void stop() = 0;
+
+    /*
+     * Stops the first stage once its current call returns (the caller shall make it return,
+     * e.g. by cancelling the capture), the others process whatever is queued and then end as well.
+     */
+    virtual void drain() = 0;
+
+    /* waits until all stages have ended, their threads are kept for the next start() */
+    virtual void join() = 0;
+
+    /*
+     * The first stage is not called again until resume() (the caller shall make its current call return,
+     * e.g. by cancelling the capture), the others go on with whatever is queued.
+     */
+    void pause()
+    {
+        m_paused = true;
+    }
+
+    void resume()
+    {
+        m_paused = false;
+        m_resumed.post();
+    }
+
+    bool paused() const
+    {
+        return m_paused;
+    }
+
+    /* requested queue capacity rounded up to the power of two */
+    std::size_t queue_capacity() const
+    {
+        return m_queue_capacity;
+    }
+
+    overflow_policy policy(std::size_t queue) const
+    {
+        return m_policies[queue];
+    }
+
+    virtual std::size_t stages() const = 0;
+
+    /**
+     * Sets cpu affinity and/or scheduling of the thread running stage 'stage'
+     * (worker threads of a replicated stage inherit it). Shall be called before start().
+     *
+     * @return 0 on success, error number otherwise.
+     */
+    int set_thread_policy(std::size_t stage, const thread_policy& policy)
+    {
+        return (stage < stages()) ? apply_thread_policy(native_handle(stage), policy) : EINVAL;
+    }
+
+    /**
+     * Creates a pool of 'capacity' preallocated buffers (each constructed as T(args...)) owned by the pipeline.
+     * Pools outlive the queues, so buffers still sitting in the queues can be returned safely.
+     * Shall be called before start().
+     */
+    template<typename T, typename... Args>
+    buffer_pool* create_pool(std::size_t capacity, Args&&... args)
+    {
+        static_assert(std::is_base_of<pooled_buffer, T>::value, "T must extend pooled_buffer");
+
+        m_pools.push_back(buffer_pool::create<T>(capacity, std::forward<Args>(args)...));
+        return m_pools.back().get();
+    }
+
+    const std::vector<std::unique_ptr<buffer_pool>>& pools() const
+    {
+        return m_pools;
+    }
+
+    /**
+     * Creates metrics of a stage (owned by the pipeline and listed in snapshots in order of creation).
+     * Stages record into them themselves, since only a stage knows which part of its time
+     * is spent processing and which waiting. Shall be called before start().
+     */
+    stage_metrics* create_metrics(const char* name)
+    {
+        m_metrics.push_back(std::make_unique<stage_metrics>(name));
+        return m_metrics.back().get();
+    }
+
+    /* signal quality of a station (listed in snapshots in order of creation), shall be called before start() */
+    signal_metrics* create_signal_metrics(const char* name)
+    {
+        m_signals.push_back(std::make_unique<signal_metrics>(name));
+        return m_signals.back().get();
+    }
+
+    /* end to end latency, recorded by the stage which knows when the data has left the pipeline */
+    latency_histogram& latency()
+    {
+        return m_latency;
+    }
+
+    /* machine readable (single line json) snapshot of stages, signals, queues and pools */
+    std::string snapshot() const
+    {
+        std::ostringstream stream;
+        std::vector<queue_counters> queues;
+
+        get_queue_counters(queues);
+
+        stream << "{\"uptime_s\": " << std::chrono::duration<double>(metrics_clock::now() - m_started).count();
+        stream << ", \"latency\": " << m_latency.to_json();
+        stream << ", \"stages\": [";
+        for (std::size_t n = 0; n < m_metrics.size(); ++n)
+            stream << ((n > 0) ? ", " : "") << m_metrics[n]->to_json();
+        stream << "], \"signals\": [";
+        for (std::size_t n = 0; n < m_signals.size(); ++n)
+            stream << ((n > 0) ? ", " : "") << m_signals[n]->to_json();
+        stream << "], \"queues\": [";
+        for (std::size_t n = 0; n < queues.size(); ++n) {
+            const queue_counters& q = queues[n];
+            stream << ((n > 0) ? ", " : "");
+            stream << "{\"policy\": \"" << overflow_policy_to_string(m_policies[n]) << "\"";
+            stream << ", \"capacity\": " << q.capacity << ", \"depth\": " << (q.produced - q.consumed);
+            stream << ", \"high_watermark\": " << q.high_watermark << ", \"produced\": " << q.produced;
+            stream << ", \"consumed\": " << q.consumed << ", \"dropped\": " << q.dropped << "}";
+        }
+        stream << "], \"pools\": [";
+        for (std::size_t n = 0; n < m_pools.size(); ++n) {
+            const buffer_pool& pool = *m_pools[n];
+            stream << ((n > 0) ? ", " : "");
+            stream << "{\"capacity\": " << pool.capacity() << ", \"in_use\": " << pool.in_use();
+            stream << ", \"high_watermark\": " << pool.high_watermark() << ", \"exhausted\": " << pool.exhausted() << "}";
+        }
+        stream << "]}";
+
+        return stream.str();
+    }
+
+    /* human readable counterpart of snapshot() */
+    std::string report() const
+    {
+        std::ostringstream stream;
+        std::vector<queue_counters> queues;
+
+        get_queue_counters(queues);
+
+        stream << "latency " << m_latency.to_string() << "\n";
+        for (const std::unique_ptr<stage_metrics>& metrics : m_metrics)
+            stream << "stage " << metrics->to_string() << "\n";
+        for (const std::unique_ptr<signal_metrics>& signal : m_signals)
+            stream << "signal " << signal->to_string() << "\n";
+        for (std::size_t n = 0; n < queues.size(); ++n) {
+            const queue_counters& q = queues[n];
+            stream << "queue " << n << " [" << overflow_policy_to_string(m_policies[n]);
+            stream << ", depth: " << (q.produced - q.consumed) << "/" << q.capacity;
+            stream << ", high watermark: " << q.high_watermark << ", dropped: " << q.dropped << "]\n";
+        }
+        for (const std::unique_ptr<buffer_pool>& pool : m_pools)
+            stream << "pool " << pool->to_string() << "\n";
+
+        return stream.str();
+    }
+
+protected:
+    struct queue_counters
+    {
+        std::size_t capacity;
+        std::size_t produced;
+        std::size_t consumed;
+        std::size_t dropped;
+        std::size_t high_watermark;
+    };
+
+    virtual void get_queue_counters(std::vector<queue_counters>& queues) const = 0;
+    virtual pthread_t native_handle(std::size_t stage) = 0;
+
+    explicit static_pipeline_base(std::size_t queue_capacity, std::vector<overflow_policy> policies) :
+        m_queue_capacity{round_up_to_power_of_two(queue_capacity)},
+        m_policies{std::move(policies)},
+        m_pools{},
+        m_metrics{},
+        m_signals{},
+        m_latency{},
+        m_started{metrics_clock::now()},
+        m_runs{0},
+        m_running{false},
+        m_draining{false},
+        m_paused{false},
+        m_resumed{false}
+    {
+    }
+
+    static std::bitset<RINGBUFFER_NONBLOCKING_FLAGS_MAX> queue_flags(overflow_policy policy)
+    {
+        switch (policy) {
+            case overflow_policy::DROP_NEWEST: return RINGBUFFER_RD_BLOCKING_WR_NONBLOCKING;
+            case overflow_policy::DROP_OLDEST: return RINGBUFFER_RD_BLOCKING_WR_OVERWRITE;
+            case overflow_policy::BLOCK:       return RINGBUFFER_RD_BLOCKING_WR_BLOCKING;
+        }
+
+        return RINGBUFFER_RD_BLOCKING_WR_BLOCKING;
+    }
+
+    /* whether the first stage shall be called (again), waits while the pipeline is paused */
+    bool producing()
+    {
+        while (m_paused && m_running && !m_draining)
+            m_resumed.wait();
+
+        return m_running && !m_draining;
+    }
+
+    std::size_t m_queue_capacity;
+    std::vector<overflow_policy> m_policies; /* of each queue */
+    std::vector<std::unique_ptr<buffer_pool>> m_pools; /* base is destroyed after queues of the derived class */
+    std::vector<std::unique_ptr<stage_metrics>> m_metrics;
+    std::vector<std::unique_ptr<signal_metrics>> m_signals;
+    latency_histogram m_latency;
+    metrics_clock::time_point m_started;
+    std::size_t m_runs;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_draining;
+    std::atomic<bool> m_paused;
+    binary_semaphore m_resumed; /* posted by resume(), stop() and drain() */
+};
+
+template<typename... Stages>
+class static_pipeline : public static_pipeline_base
+{
+    static constexpr std::size_t N = sizeof...(Stages);
+    static_assert(N > 1, "pipeline needs at least two stages");
+
+    template<std::size_t K>
+    using stage_type = std::tuple_element_t<K, std::tuple<Stages...>>;
+
+    template<std::size_t K>
+    using traits = stage_traits<stage_type<K>>;
+
+    /* queue K connects stage K with stage K + 1 */
+    template<std::size_t K>
+    using queue_type = ringbuffer<typename traits<K>::output_type, ringbuffer_index_mask>;
+
+    template<std::size_t... K>
+    static std::tuple<std::unique_ptr<queue_type<K>>...> queues_of(std::index_sequence<K...>);
+
+    template<std::size_t... K>
+    static constexpr bool connected(std::index_sequence<K...>)
+    {
+        return (std::is_same<typename traits<K>::output_type, typename traits<K + 1>::input_type>::value && ...);
+    }
+
+    static_assert(!is_replicated_stage<stage_type<0>>::value, "first stage cannot be replicated");
+    static_assert(!is_replicated_stage<stage_type<N - 1>>::value, "last stage cannot be replicated");
+    static_assert(std::is_void<typename traits<0>::input_type>::value, "first stage shall only produce");
+    static_assert(std::is_void<typename traits<N - 1>::output_type>::value, "last stage shall only consume");
+    static_assert(connected(std::make_index_sequence<N - 1>{}), "output of each stage shall be input of the next one");
+
+public:
+    /* policies[K] is the overflow policy of queue K (between stages K and K + 1) */
+    explicit static_pipeline(std::size_t queue_capacity, const std::array<overflow_policy, N - 1>& policies, Stages... stages) :
+        static_pipeline_base{queue_capacity, std::vector<overflow_policy>(policies.begin(), policies.end())},
+        m_stages{std::move(stages)...},
+        m_queues{},
+        m_threads{},
+        m_done{0},
+        m_active{false},
+        m_exiting{false}
+    {
+        create_queues(std::make_index_sequence<N - 1>{});
+        prepare_stages(std::make_index_sequence<N>{});
+        create_threads(std::make_index_sequence<N>{});
+    }
+
+    ~static_pipeline() override
+    {
+        stop();
+        join();
+
+        m_exiting = true;
+        for (std::size_t n = 0; n < N; ++n)
+            m_start[n].post();
+        for (std::size_t n = 0; n < N; ++n)
+            m_threads[n].join();
+    }
+
+    void start() override
+    {
+        if (m_active)
+            return;
+
+        clear_queues(std::make_index_sequence<N - 1>{});
+
+        if (m_runs++ == 0)
+            m_started = metrics_clock::now();
+        m_draining = false;
+        m_paused = false;
+        m_running = true;
+        m_active = true;
+
+        for (std::size_t n = 0; n < N; ++n)
+            m_start[n].post();
+    }
+
+    void stop() override
+    {
+        m_running = false;
+        m_resumed.post();
+        cancel_queues(std::make_index_sequence<N - 1>{});
+        cancel_stages(std::make_index_sequence<N>{});
+    }
+
+    void drain() override
+    {
+        m_draining = true;
+        m_resumed.post();
+
+        /* the first stage waiting for room gives up (its element is lost) */
+        std::get<0>(m_queues)->cancel(ringbuffer_role::PRODUCER);
+    }
+
+    void join() override
+    {
+        if (!m_active)
+            return;
+
+        for (std::size_t n = 0; n < N; ++n)
+            m_done.wait();
+
+        m_active = false;
+    }
+
+    std::size_t stages() const override
+    {
+        return N;
+    }
+
+protected:
+    void get_queue_counters(std::vector<queue_counters>& queues) const override
+    {
+        get_queue_counters(queues, std::make_index_sequence<N - 1>{});
+    }
+
+    pthread_t native_handle(std::size_t stage) override
+    {
+        return m_threads[stage].native_handle();
+    }
+
+private:
+    template<std::size_t... K>
+    void get_queue_counters(std::vector<queue_counters>& queues, std::index_sequence<K...>) const
+    {
+        (queues.push_back(counters_of(*std::get<K>(m_queues))), ...);
+    }
+
+    template<typename Q>
+    static queue_counters counters_of(const Q& queue)
+    {
+        queue_counters q{queue.capacity(), 0, 0, 0, 0};
+        queue.get_counters(&q.produced, &q.consumed, &q.dropped, &q.high_watermark);
+        return q;
+    }
+
+    template<std::size_t... K>
+    void create_queues(std::index_sequence<K...>)
+    {
+        ((std::get<K>(m_queues) = std::make_unique<queue_type<K>>(m_queue_capacity, queue_flags(m_policies[K]))), ...);
+    }
+
+    template<std::size_t... K>
+    void clear_queues(std::index_sequence<K...>)
+    {
+        (std::get<K>(m_queues)->clear(), ...);
+    }
+
+    template<std::size_t K>
+    void prepare_stage()
+    {
+        if constexpr (is_replicated_stage<stage_type<K>>::value)
+            std::get<K>(m_stages).prepare();
+    }
+
+    template<std::size_t... K>
+    void prepare_stages(std::index_sequence<K...>)
+    {
+        (prepare_stage<K>(), ...);
+    }
+
+    template<std::size_t K>
+    void cancel_stage()
+    {
+        if constexpr (is_replicated_stage<stage_type<K>>::value)
+            std::get<K>(m_stages).cancel();
+    }
+
+    template<std::size_t... K>
+    void cancel_stages(std::index_sequence<K...>)
+    {
+        (cancel_stage<K>(), ...);
+    }
+
+    template<std::size_t... K>
+    void create_threads(std::index_sequence<K...>)
+    {
+        ((m_threads[K] = std::thread{&static_pipeline::run<K>, this}), ...);
+    }
+
+    /* wakes up both readers and (blocked) writers */
+    template<std::size_t... K>
+    void cancel_queues(std::index_sequence<K...>)
+    {
+        ((std::get<K>(m_queues)->cancel(ringbuffer_role::CONSUMER),
+          std::get<K>(m_queues)->cancel(ringbuffer_role::PRODUCER)), ...);
+    }
+
+    /* thread of stage K, runs it once per start() */
+    template<std::size_t K>
+    void run()
+    {
+        for (;;) {
+            m_start[K].wait();
+            if (m_exiting)
+                return;
+
+            process<K>();
+
+            m_done.post();
+        }
+    }
+
+    template<std::size_t K>
+    void process()
+    {
+        auto& stage = std::get<K>(m_stages);
+
+        if constexpr (K == 0) {
+            stage_output<typename traits<K>::output_type>* orb = std::get<K>(m_queues).get();
+            while (producing() && (stage(orb) == true));
+        } else
+        if constexpr (K == (N - 1)) {
+            stage_input<typename traits<K>::input_type>* irb = std::get<K - 1>(m_queues).get();
+            while ((m_running) && (stage(irb) == true));
+        } else {
+            stage_input<typename traits<K>::input_type>* irb = std::get<K - 1>(m_queues).get();
+            stage_output<typename traits<K>::output_type>* orb = std::get<K>(m_queues).get();
+            if constexpr (is_replicated_stage<stage_type<K>>::value)
+                stage.run(irb, orb, m_running);
+            else
+                while ((m_running) && (stage(irb, orb) == true));
+        }
+
+        /*
+         * Stage has finished on its own (e.g. end of a recording), the next one
+         * reads what is left in the queue, then its read fails as well, and so on.
+         */
+        if constexpr (K < (N - 1))
+            std::get<K>(m_queues)->cancel(ringbuffer_role::CONSUMER);
+    }
+
+    std::tuple<Stages...> m_stages;
+    decltype(queues_of(std::make_index_sequence<N - 1>{})) m_queues;
+    std::thread m_threads[N];
+    semaphore m_start[N]; /* of each stage thread */
+    semaphore m_done;     /* posted by each stage thread at the end of a run */
+    bool m_active;        /* started and not joined yet */
+    bool m_exiting;       /* published to the threads by m_start */
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/**
+ * Replicates 'function' (see replicated_stage) across 'workers' threads.
+ */
+template<typename F>
+inline replicated_stage<std::decay_t<F>> replicate(std::size_t workers, F&& function)
+{
+    return replicated_stage<std::decay_t<F>>{workers, std::forward<F>(function)};
+}
+
+/**
+ * Replicates 'function' across 'workers' threads, elements of the same 'key' go to the same worker.
+ */
+template<typename F, typename K>
+inline replicated_stage<std::decay_t<F>, std::decay_t<K>> replicate(std::size_t workers, F&& function, K&& key)
+{
+    return replicated_stage<std::decay_t<F>, std::decay_t<K>>{workers, std::forward<F>(function), std::forward<K>(key)};
+}
+
+/**
+ * Creates a pipeline of 'stages', policies[K] being the overflow policy of the queue
+ * between stages K and K + 1.
+ */
+template<typename... Stages>
+inline std::unique_ptr<static_pipeline<std::decay_t<Stages>...>>
+make_static_pipeline(std::size_t queue_capacity, const std::array<overflow_policy, sizeof...(Stages) - 1>& policies, Stages&&... stages)
+{
+    return std::make_unique<static_pipeline<std::decay_t<Stages>...>>(
+        queue_capacity, policies, std::forward<Stages>(stages)...);
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _STATIC_PIPELINE_HPP_ */
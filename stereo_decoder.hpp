@@ -0,0 +1,304 @@
+/**
+ * @file stereo_decoder.hpp
+ *
+ * FM stereo (multiplex) decoder working on the discriminator output.
+ * A pll locks onto the 19 kHz pilot, the difference (L-R) signal is brought down
+ * from the 38 kHz subcarrier and filtered by the same filter (and decimation) as the sum (L+R) one,
+ * both are then matrixed into left and right, which are de-emphasized.
+ * Everything is done in fixed point, block by block: the pll updates its loop once per
+ * STEREO_PLL_BLOCK samples (so the samples within are independent of each other),
+ * the mixing and the filtering are plain loops over the whole block.
+ * Blocks missed in between (dropped or squelched) make the decoder start over
+ * at the position of the next one, so that the difference signal keeps aligned with the sum one.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _STEREO_DECODER_HPP_
+#define _STEREO_DECODER_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <vector>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cassert>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "fixq15.hpp"
+#include "utilities.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define STEREO_PILOT_FREQUENCY  (19000.0)
+#define STEREO_PILOT_DEVIATION  (7500.0) /* nominal (10% of 75 kHz), sets the gain of the phase detector */
+#define STEREO_PLL_BLOCK        (16)     /* samples the loop is updated after */
+#define STEREO_PLL_BANDWIDTH    (20.0)   /* natural frequency (Hz) of the loop */
+#define STEREO_PLL_DAMPING      (0.707)
+#define STEREO_PLL_MAX_OFFSET   (100.0)  /* Hz the loop may pull away from the nominal pilot */
+#define STEREO_SINE_BITS        (12)     /* of the sine table index */
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/**
+ * @param F Filter of the sum signal e.g. fir_decimator<int16_t, N>,
+ *          it shall pass the audio (up to 15 kHz) and stop the pilot.
+ */
+template<typename F>
+class stereo_decoder
+{
+public:
+    /**
+     * @param[in] filter Filter (and decimator) the sum signal is passed through, its copy filters the difference one.
+     * @param[in] sample_rate Of the discriminator output (Hz).
+     * @param[in] deemphasis Time constant (seconds) e.g. 50e-6 (or 75e-6 in the Americas), 0 disables it.
+     */
+    explicit stereo_decoder(const F& filter, double sample_rate, double deemphasis) :
+        m_filter{filter},
+        m_carrier{},
+        m_difference{},
+        m_decimated{},
+        m_position{0},
+        m_phase{0},
+        m_nominal{static_cast<uint32_t>(lround(STEREO_PILOT_FREQUENCY / sample_rate * 4294967296.0))},
+        m_step{m_nominal},
+        m_integrator{0},
+        m_max_integrator{llround(STEREO_PLL_MAX_OFFSET / sample_rate * 4294967296.0 * 65536.0)},
+        m_kp{0},
+        m_ki{0},
+        m_level{0},
+        m_lock_on{0},
+        m_lock_off{0},
+        m_locked{false},
+        m_alpha{Q15},
+        m_left{0},
+        m_right{0}
+    {
+        /* detector output (sum over a loop block) per radian of phase error at the nominal pilot */
+        const double amplitude = Q15 * STEREO_PILOT_DEVIATION / (sample_rate / 2);
+        const double kd = STEREO_PLL_BLOCK * amplitude / 2;
+        const double wt = 2.0 * M_PI * STEREO_PLL_BANDWIDTH * STEREO_PLL_BLOCK / sample_rate;
+        const double nco = 4294967296.0 / (2.0 * M_PI) * 65536.0; /* radians -> Q16 phase steps */
+
+        m_kp = llround(2.0 * STEREO_PLL_DAMPING * wt / kd * nco);
+        m_ki = llround(wt * wt / kd * nco);
+
+        /* pilot at a quarter of the nominal level locks the loop, at an eighth it is lost */
+        m_lock_on = static_cast<int32_t>(kd / 4);
+        m_lock_off = static_cast<int32_t>(kd / 8);
+
+        if (deemphasis > 0.0)
+            m_alpha = static_cast<int32_t>(lround((1.0 - exp(-static_cast<double>(filter.decimation()) / (sample_rate * deemphasis))) * Q15));
+    }
+
+    /**
+     * @return upper bound of samples (left and right together) produced out of n mpx samples.
+     */
+    std::size_t max_output_size(std::size_t n) const
+    {
+        return 2 * m_filter.max_output_size(n);
+    }
+
+    /* of the next block expected, i.e. the one following the last decoded one */
+    uint64_t position() const
+    {
+        return m_position;
+    }
+
+    /* the pilot is tracked, otherwise the difference signal is muted (output is mono) */
+    bool locked() const
+    {
+        return m_locked;
+    }
+
+    /**
+     * Decodes the next block of the stream.
+     *
+     * @param[in] mpx n consecutive discriminator output samples.
+     * @param[in] position Index of the first of them within the whole stream.
+     * @param[in] sum m samples of the sum signal i.e. 'mpx' passed through a filter like the one
+     *                given to the constructor, resumed at 'position' (whichever thread it was done on).
+     * @param[out] out Room for max_output_size(n) samples, interleaved left and right.
+     *
+     * @return number of samples written to 'out'.
+     */
+    std::size_t decode(const int16_t* mpx, std::size_t n, uint64_t position, const int16_t* sum, std::size_t m, int16_t* out)
+    {
+        if (position != m_position)
+            restart(position);
+
+        m_position = position + n;
+
+        m_carrier.resize(n);
+        m_difference.resize(n);
+        m_decimated.resize(m_filter.max_output_size(n));
+
+        track(mpx, n);
+
+        /* L-R was sent on sin(2 * pilot) */
+        for (std::size_t i = 0; i < n; ++i)
+            m_difference[i] = static_cast<int16_t>((static_cast<int32_t>(mpx[i]) * m_carrier[i]) >> 15);
+
+        /* both filters are at the same decimation phase, they yield the same number of outputs */
+        const std::size_t decimated = m_filter.decimate(m_difference.data(), n, m_decimated.data());
+        assert(decimated == m);
+        UNUSED(decimated);
+
+        /* mixing halved the difference: L = sum + 2 * difference, R = sum - 2 * difference */
+        for (std::size_t j = 0; j < m; ++j) {
+            const int32_t s = sum[j];
+            const int32_t d = 2 * static_cast<int32_t>(m_decimated[j]);
+
+            out[2 * j + 0] = deemphasize(m_left, fixq15_16::saturate(s + d));
+            out[2 * j + 1] = deemphasize(m_right, fixq15_16::saturate(s - d));
+        }
+
+        return 2 * m;
+    }
+
+private:
+    /* Q15 sine of a full period of 2^STEREO_SINE_BITS entries */
+    static const int16_t* sine_table()
+    {
+        static const std::vector<int16_t> table = [](){
+            std::vector<int16_t> t(std::size_t{1} << STEREO_SINE_BITS);
+            for (std::size_t k = 0; k < t.size(); ++k)
+                t[k] = static_cast<int16_t>(lround(sin(2.0 * M_PI * k / t.size()) * (Q15 - 1)));
+            return t;
+        }();
+
+        return table.data();
+    }
+
+    /*
+     * Samples in between were not seen, so the difference filter starts over at the decimation
+     * phase of 'position' and the loop at the pilot phase extrapolated to it. It may be off by now,
+     * so the pilot has to be locked again (the carrier is muted until then, which is
+     * also what the silent history of the filter stands for).
+     */
+    void restart(uint64_t position)
+    {
+        static const int16_t silence[F::taps - 1] = {};
+
+        m_filter.resume(silence, position);
+        m_phase += static_cast<uint32_t>((position - m_position) * m_step);
+        m_level = 0;
+        m_locked = false;
+    }
+
+    /* phase (full period being 2^32) to the sine table index */
+    static uint32_t index(uint32_t phase)
+    {
+        return phase >> (32 - STEREO_SINE_BITS);
+    }
+
+    /*
+     * Locked loop follows pilot = sin(phase). The phase detector correlates the mpx
+     * with cos(phase) (a sin of the phase error), with sin(phase) it measures the pilot level.
+     */
+    void track(const int16_t* mpx, std::size_t n)
+    {
+        const int16_t* sine = sine_table();
+
+        for (std::size_t i = 0; i < n; i += STEREO_PLL_BLOCK) {
+            const std::size_t count = std::min<std::size_t>(STEREO_PLL_BLOCK, n - i);
+            const uint32_t phase = m_phase;
+            const uint32_t step = m_step;
+            const bool locked = m_locked;
+            int32_t error = 0;
+            int32_t level = 0;
+
+            for (std::size_t k = 0; k < count; ++k) {
+                const uint32_t theta = phase + static_cast<uint32_t>(k) * step;
+                const int32_t x = mpx[i + k];
+
+                error += (x * sine[index(theta + UINT32_C(0x40000000))]) >> 15;
+                level += (x * sine[index(theta)]) >> 15;
+                m_carrier[i + k] = locked ? sine[index(2 * theta)] : 0;
+            }
+
+            /* proportional part corrects the phase, integral one the frequency */
+            m_integrator = std::clamp(m_integrator + m_ki * error, -m_max_integrator, m_max_integrator);
+            m_phase = phase + static_cast<uint32_t>(count) * step + static_cast<uint32_t>((m_kp * error) >> 16);
+            m_step = m_nominal + static_cast<uint32_t>(m_integrator >> 16);
+
+            m_level += (level - m_level) >> 6;
+            m_locked = m_locked ? (m_level > m_lock_off) : (m_level > m_lock_on);
+        }
+    }
+
+    /* single pole low pass, state keeps 15 more fractional bits than the samples */
+    int16_t deemphasize(int32_t& state, int16_t x) const
+    {
+        state += static_cast<int32_t>((static_cast<int64_t>(m_alpha) * (static_cast<int64_t>(x) * Q15 - state)) >> 15);
+        return fixq15_16::saturate((state + (Q15 >> 1)) >> 15);
+    }
+
+    F m_filter; /* of the difference signal */
+    std::vector<int16_t> m_carrier;
+    std::vector<int16_t> m_difference;
+    std::vector<int16_t> m_decimated;
+    uint64_t m_position; /* of the next block expected */
+    uint32_t m_phase;   /* of the pilot, full period being 2^32 */
+    uint32_t m_nominal; /* phase step of the nominal pilot */
+    uint32_t m_step;
+    int64_t m_integrator; /* frequency offset, Q16 phase steps */
+    int64_t m_max_integrator;
+    int64_t m_kp;
+    int64_t m_ki;
+    int32_t m_level;
+    int32_t m_lock_on;
+    int32_t m_lock_off;
+    bool m_locked;
+    int32_t m_alpha; /* of the de-emphasis, Q15 */
+    int32_t m_left;
+    int32_t m_right;
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _STEREO_DECODER_HPP_ */
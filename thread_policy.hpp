@@ -0,0 +1,231 @@
+/**
+ * @file thread_policy.hpp
+ *
+ * Cpu affinity and scheduling policy of a thread (e.g. of a pipeline stage),
+ * so that latency critical ones (like the usb producer) can be kept on cores of their own
+ * and/or run with realtime priority, and locking of the process memory.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+
+#ifndef _THREAD_POLICY_HPP_
+#define _THREAD_POLICY_HPP_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <string>
+#include <sstream>
+
+#include <cstring>
+#include <cerrno>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "strtointeger.hpp"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define THREAD_PRIORITY_DEFAULT (10) /* below threaded irq handlers (50), so that usb keeps being serviced */
+
+/*===========================================================================*\
+ * global type definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+struct thread_policy
+{
+    cpu_set_t cpus; /* none means any (affinity is left as it is) */
+    int scheduler;  /* SCHED_OTHER leaves the scheduling as it is, SCHED_FIFO or SCHED_RR otherwise */
+    int priority;   /* of SCHED_FIFO/SCHED_RR */
+
+    explicit thread_policy() :
+        cpus{},
+        scheduler{SCHED_OTHER},
+        priority{0}
+    {
+        CPU_ZERO(&cpus);
+    }
+
+    bool is_default() const
+    {
+        return (CPU_COUNT(&cpus) == 0) && (scheduler == SCHED_OTHER);
+    }
+
+    std::string to_string() const
+    {
+        std::ostringstream stream;
+
+        stream << "cpus: ";
+        if (CPU_COUNT(&cpus) == 0)
+            stream << "any";
+        else
+            for (int cpu = 0, n = 0; cpu < CPU_SETSIZE; ++cpu)
+                if (CPU_ISSET(cpu, &cpus))
+                    stream << ((n++ > 0) ? "+" : "") << cpu;
+
+        stream << ", scheduler: ";
+        switch (scheduler) {
+            case SCHED_FIFO: stream << "fifo:" << priority; break;
+            case SCHED_RR:   stream << "rr:" << priority; break;
+            default:         stream << "other"; break;
+        }
+
+        return stream.str();
+    }
+};
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * inline function/variable definitions
+\*===========================================================================*/
+namespace ymn
+{
+
+/**
+ * Threads created afterwards by the thread inherit both its affinity and scheduling.
+ *
+ * @return 0 on success, error number otherwise (e.g. EPERM if realtime scheduling is not allowed).
+ */
+inline int apply_thread_policy(pthread_t thread, const thread_policy& policy)
+{
+    if (CPU_COUNT(&policy.cpus) > 0) {
+        int status = pthread_setaffinity_np(thread, sizeof(policy.cpus), &policy.cpus);
+        if (status != 0)
+            return status;
+    }
+
+    if (policy.scheduler != SCHED_OTHER) {
+        struct sched_param param{};
+        param.sched_priority = policy.priority;
+        return pthread_setschedparam(thread, policy.scheduler, &param);
+    }
+
+    return 0;
+}
+
+/**
+ * @param[in] s Cpus or ranges of them separated by '+', e.g. "2", "2-3" or "0+2-3".
+ */
+inline bool cpu_set_from_string(const char* s, cpu_set_t& cpus)
+{
+    std::string list{s};
+    std::size_t begin = 0;
+
+    CPU_ZERO(&cpus);
+
+    while (begin <= list.size()) {
+        std::size_t end = list.find('+', begin);
+        std::string item = list.substr(begin, (end == std::string::npos) ? std::string::npos : (end - begin));
+        std::size_t dash = item.find('-');
+        unsigned first, last;
+
+        if (dash == std::string::npos) {
+            if (strtointeger(item.c_str(), first) != strtointeger_conversion_status_e::success)
+                return false;
+            last = first;
+        }
+        else
+        if ((strtointeger(item.substr(0, dash).c_str(), first) != strtointeger_conversion_status_e::success) ||
+            (strtointeger(item.substr(dash + 1).c_str(), last) != strtointeger_conversion_status_e::success))
+            return false;
+
+        if ((first > last) || (last >= CPU_SETSIZE))
+            return false;
+
+        for (unsigned cpu = first; cpu <= last; ++cpu)
+            CPU_SET(cpu, &cpus);
+
+        if (end == std::string::npos)
+            break;
+        begin = end + 1;
+    }
+
+    return true;
+}
+
+/**
+ * @param[in] s "fifo", "rr" (optionally followed by ":<priority>") or "other".
+ */
+inline bool scheduler_from_string(const char* s, int& scheduler, int& priority)
+{
+    std::string name{s};
+    std::size_t colon = name.find(':');
+    int value = THREAD_PRIORITY_DEFAULT;
+
+    if (colon != std::string::npos) {
+        if (strtointeger(name.substr(colon + 1).c_str(), value) != strtointeger_conversion_status_e::success)
+            return false;
+        name.resize(colon);
+    }
+
+    if (name == "fifo")
+        scheduler = SCHED_FIFO;
+    else
+    if (name == "rr")
+        scheduler = SCHED_RR;
+    else
+    if ((name == "other") && (colon == std::string::npos)) {
+        scheduler = SCHED_OTHER;
+        value = 0;
+    }
+    else
+        return false;
+
+    if ((scheduler != SCHED_OTHER) &&
+        ((value < sched_get_priority_min(scheduler)) || (value > sched_get_priority_max(scheduler))))
+        return false;
+
+    priority = value;
+
+    return true;
+}
+
+/**
+ * Locks all current and future pages of the process in memory, so that the stages never fault
+ * on a page which was swapped out (or not mapped yet). Future allocations beyond RLIMIT_MEMLOCK
+ * (e.g. stacks of threads created later) fail then, so it needs a large enough limit (or CAP_IPC_LOCK).
+ *
+ * @return 0 on success, error number otherwise.
+ */
+inline int lock_memory()
+{
+    return (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) ? 0 : errno;
+}
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * global object declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+/*===========================================================================*\
+ * function forward declarations
+\*===========================================================================*/
+namespace ymn
+{
+
+} /* end of namespace ymn */
+
+#endif /* _THREAD_POLICY_HPP_ */